@@ -25,6 +25,15 @@ struct bit_vector_builder {
 
     void reserve(uint64_t num_bits) { m_bits.reserve(util::num_64bit_words_for(num_bits)); }
 
+    /* drop the bits from position num_bits on, so that other bits can be appended */
+    void truncate(uint64_t num_bits) {
+        assert(num_bits <= m_num_bits);
+        m_num_bits = num_bits;
+        m_bits.resize(util::num_64bit_words_for(num_bits));
+        if (num_bits % 64 != 0) m_bits.back() &= (uint64_t(1) << (num_bits % 64)) - 1;
+        m_cur_word = m_bits.empty() ? nullptr : &m_bits.back();
+    }
+
     inline void set(uint64_t pos, bool b = true) {
         assert(pos < num_bits());
         uint64_t word = pos >> 6;
@@ -143,6 +152,23 @@ struct bit_vector_iterator {
         return zeros + l;
     }
 
+    /* return the buffered bits from the current position, without advancing:
+       the low available() >= 32 bits are valid (the bits past the end are zeros) */
+    inline uint64_t peek() {
+        if (m_avail < 32) fill_buf();
+        return m_buf;
+    }
+
+    inline uint64_t available() const { return m_avail; }
+
+    /* advance by l <= available() bits */
+    inline void skip(uint64_t l) {
+        assert(l <= m_avail);
+        m_buf = l < 64 ? m_buf >> l : 0;
+        m_avail -= l;
+        m_pos += l;
+    }
+
     inline uint64_t position() const { return m_pos; }
 
     inline void fill_buf() {
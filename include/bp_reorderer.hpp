@@ -0,0 +1,342 @@
+#pragma once
+
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+#include "index.hpp"
+
+namespace fulgor {
+
+/*
+    Compute an order of the references that makes the color sets more compressible,
+    by recursive graph bisection [1] on a sample of the color sets.
+
+    The hybrid color sets code the gaps between consecutive doc ids with Elias' delta,
+    so their cost depends on the order of the references, except for the bitmaps.
+    The references are split in two halves that are refined by swapping references
+    so as to minimize the (approximate) log-gap cost of the sampled color sets,
+    and then each half is split recursively. The very dense color sets are coded
+    as their complement, so their complement is used in place of the color set.
+
+    [1] L. Dhulipala, I. Kabiljo, B. Karrer, G. Ottaviano, S. Pupyrev, A. Shalita.
+    Compressing Graphs and Indexes with Recursive Graph Bisection. KDD 2016.
+*/
+struct bp_reorderer {
+    bp_reorderer(build_configuration const& build_config)
+        : m_build_config(build_config), m_num_docs(0) {}
+
+    void permute(index_type const& index) {
+        essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+
+        m_num_docs = index.num_docs();
+
+        {
+            essentials::logger("step 2. sampling color sets");
+            timer.start();
+            sample(index);
+            timer.stop();
+            std::cout << "sampled " << num_lists() << " color sets with " << m_list_docs.size()
+                      << " integers" << std::endl;
+            std::cout << "** sampling color sets took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        {
+            essentials::logger("step 3. recursive graph bisection");
+            timer.start();
+
+            /* from doc to the sampled lists containing it */
+            m_doc_offsets.assign(m_num_docs + 1, 0);
+            for (uint32_t doc : m_list_docs) m_doc_offsets[doc + 1] += 1;
+            std::partial_sum(m_doc_offsets.begin(), m_doc_offsets.end(), m_doc_offsets.begin());
+            m_doc_lists.resize(m_list_docs.size());
+            {
+                auto pos = m_doc_offsets;  // copy
+                for (uint64_t list_id = 0; list_id != num_lists(); ++list_id) {
+                    for (uint64_t i = m_list_offsets[list_id]; i != m_list_offsets[list_id + 1];
+                         ++i) {
+                        m_doc_lists[pos[m_list_docs[i]]++] = list_id;
+                    }
+                }
+            }
+
+            m_log2.resize(m_num_docs + 2);
+            for (uint64_t i = 0; i != m_log2.size(); ++i) m_log2[i] = i ? std::log2(i) : 0;
+
+            m_order.resize(m_num_docs);
+            std::iota(m_order.begin(), m_order.end(), 0);
+            const uint64_t max_depth = m_num_docs > 1 ? util::msbll(m_num_docs - 1) + 1 : 0;
+            const uint64_t num_threads = m_build_config.num_threads;
+            const uint64_t parallel_depth = num_threads > 1 ? util::msbll(num_threads - 1) + 1 : 0;
+            bisect(0, m_num_docs, 0, max_depth, parallel_depth);
+
+            m_permutation.resize(m_num_docs);
+            for (uint64_t i = 0; i != m_num_docs; ++i) m_permutation[m_order[i]] = i;
+
+            timer.stop();
+            std::cout << "** recursive graph bisection took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        std::vector<uint32_t> identity(m_num_docs);
+        std::iota(identity.begin(), identity.end(), 0);
+        const uint64_t num_ints = std::max<uint64_t>(m_list_docs.size(), 1);
+        std::cout << "predicted cost of the sampled lists: "
+                  << static_cast<double>(cost(identity)) / num_ints << " bits/int before, "
+                  << static_cast<double>(cost(m_permutation)) / num_ints << " bits/int after"
+                  << std::endl;
+
+        m_filenames.resize(m_num_docs);
+        for (uint64_t i = 0; i != m_num_docs; ++i) {
+            m_filenames[m_permutation[i]] = index.filename(i);
+        }
+    }
+
+    /* doc i becomes doc permutation()[i] */
+    std::vector<uint32_t> permutation() const { return m_permutation; }
+    std::vector<std::string> filenames() const { return m_filenames; }
+
+    /* cost, in bits, of coding the gaps of the sampled lists with delta,
+       with doc i renamed as permutation[i] */
+    uint64_t cost(std::vector<uint32_t> const& permutation) const {
+        uint64_t bits = 0;
+        std::vector<uint32_t> list;
+        for (uint64_t list_id = 0; list_id != num_lists(); ++list_id) {
+            list.clear();
+            for (uint64_t i = m_list_offsets[list_id]; i != m_list_offsets[list_id + 1]; ++i) {
+                list.push_back(permutation[m_list_docs[i]]);
+            }
+            std::sort(list.begin(), list.end());
+            bits += util::delta_length(list.front());
+            for (uint64_t i = 1; i != list.size(); ++i) {
+                bits += util::delta_length(list[i] - (list[i - 1] + 1));
+            }
+        }
+        return bits;
+    }
+
+private:
+    build_configuration m_build_config;
+    uint64_t m_num_docs;
+
+    /* the sampled lists */
+    std::vector<uint64_t> m_list_offsets;
+    std::vector<uint32_t> m_list_docs;
+
+    /* the sampled lists containing each doc */
+    std::vector<uint64_t> m_doc_offsets;
+    std::vector<uint32_t> m_doc_lists;
+
+    std::vector<float> m_log2;
+    std::vector<uint32_t> m_order;  // the docs, in their new order
+    std::vector<uint32_t> m_permutation;
+    std::vector<std::string> m_filenames;
+
+    static constexpr uint64_t max_num_sampled_ints = 1ULL << 26;
+    static constexpr uint64_t max_num_iterations = 20;
+    static constexpr uint64_t min_bisection_size = 16;
+
+    uint64_t num_lists() const { return m_list_offsets.size() - 1; }
+
+    /*
+        Keep the color sets that are coded with gaps (the complement, for the very dense
+        ones), so that they hold at most max_num_sampled_ints integers in total.
+        The sample is deterministic.
+    */
+    void sample(index_type const& index) {
+        const uint64_t num_color_sets = index.num_color_sets();
+        /* the thresholds the color sets of the index were coded with */
+        const uint32_t sparse_set_threshold_size =
+            index.get_color_sets().sparse_set_threshold_size();
+        const uint32_t very_dense_set_threshold_size =
+            index.get_color_sets().very_dense_set_threshold_size();
+        auto num_gaps = [&](uint64_t size) -> uint64_t {
+            if (size < sparse_set_threshold_size) return size;
+            if (size < very_dense_set_threshold_size) return 0;  // bitmap
+            return m_num_docs - size;
+        };
+
+        uint64_t num_ints = 0;
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+            uint64_t n = num_gaps(index.get_color_sets().color_set_size(color_set_id));
+            if (n > 1) num_ints += n;
+        }
+        const double sampling_rate =
+            num_ints > max_num_sampled_ints
+                ? static_cast<double>(max_num_sampled_ints) / num_ints
+                : 1.0;
+        const uint64_t sampling_threshold =
+            static_cast<uint64_t>(sampling_rate * static_cast<double>(uint64_t(-1)));
+
+        m_list_offsets.assign(1, 0);
+        m_list_docs.clear();
+        std::vector<uint32_t> list;
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+            auto it = index.color_set(color_set_id);
+            const uint64_t size = it.size();
+            if (num_gaps(size) <= 1) continue;
+            if (sampling_rate < 1.0 and
+                static_cast<uint64_t>(util::hash128(reinterpret_cast<char const*>(&color_set_id),
+                                                    sizeof(uint64_t))) > sampling_threshold) {
+                continue;
+            }
+            list.resize(size);
+            it.decode(list.data());
+            if (size < sparse_set_threshold_size) {
+                m_list_docs.insert(m_list_docs.end(), list.begin(), list.end());
+            } else {
+                uint64_t i = 0;
+                for (uint32_t doc = 0; doc != m_num_docs; ++doc) {
+                    if (i != size and list[i] == doc) {
+                        ++i;
+                    } else {
+                        m_list_docs.push_back(doc);
+                    }
+                }
+            }
+            m_list_offsets.push_back(m_list_docs.size());
+        }
+    }
+
+    struct bisection_state {
+        bisection_state(uint64_t num_lists) : degrees(num_lists, {0, 0}) {}
+        std::vector<std::pair<uint32_t, uint32_t>> degrees;  // in the left and right half
+        std::vector<uint32_t> touched_lists;
+        std::vector<std::pair<float, uint32_t>> left_gains, right_gains;
+    };
+
+    /* cost of a list with d docs in a half of n docs */
+    float log_gap_cost(uint64_t d, uint64_t n) const { return d * (m_log2[n] - m_log2[d + 1]); }
+
+    void bisect(uint64_t begin, uint64_t end, uint64_t depth, uint64_t max_depth,
+                uint64_t parallel_depth) {
+        bisection_state state(num_lists());
+        bisect(begin, end, depth, max_depth, parallel_depth, state);
+    }
+
+    void bisect(uint64_t begin, uint64_t end, uint64_t depth, uint64_t max_depth,
+                uint64_t parallel_depth, bisection_state& state) {
+        if (end - begin < min_bisection_size or depth >= max_depth) return;
+        const uint64_t mid = begin + (end - begin) / 2;
+        const uint64_t left_size = mid - begin;
+        const uint64_t right_size = end - mid;
+        auto& degrees = state.degrees;
+
+        for (uint64_t iteration = 0; iteration != max_num_iterations; ++iteration) {
+            for (uint64_t i = begin; i != end; ++i) {
+                const uint32_t doc = m_order[i];
+                for (uint64_t j = m_doc_offsets[doc]; j != m_doc_offsets[doc + 1]; ++j) {
+                    auto& d = degrees[m_doc_lists[j]];
+                    if (d.first == 0 and d.second == 0) {
+                        state.touched_lists.push_back(m_doc_lists[j]);
+                    }
+                    if (i < mid) {
+                        d.first += 1;
+                    } else {
+                        d.second += 1;
+                    }
+                }
+            }
+
+            /* gain of moving each doc to the other half */
+            auto gains = [&](uint64_t b, uint64_t e, bool left,
+                             std::vector<std::pair<float, uint32_t>>& out) {
+                out.clear();
+                for (uint64_t i = b; i != e; ++i) {
+                    const uint32_t doc = m_order[i];
+                    float gain = 0;
+                    for (uint64_t j = m_doc_offsets[doc]; j != m_doc_offsets[doc + 1]; ++j) {
+                        auto [from, to] = degrees[m_doc_lists[j]];
+                        uint64_t from_size = left_size, to_size = right_size;
+                        if (!left) {
+                            std::swap(from, to);
+                            std::swap(from_size, to_size);
+                        }
+                        gain += log_gap_cost(from, from_size) + log_gap_cost(to, to_size) -
+                                log_gap_cost(from - 1, from_size) - log_gap_cost(to + 1, to_size);
+                    }
+                    out.emplace_back(gain, i);
+                }
+                std::sort(out.begin(), out.end(), [&](auto const& x, auto const& y) {
+                    return x.first > y.first or
+                           (x.first == y.first and m_order[x.second] < m_order[y.second]);
+                });
+            };
+            gains(begin, mid, true, state.left_gains);
+            gains(mid, end, false, state.right_gains);
+
+            for (uint32_t list_id : state.touched_lists) degrees[list_id] = {0, 0};
+            state.touched_lists.clear();
+
+            uint64_t num_swaps = 0;
+            for (uint64_t i = 0; i != std::min(left_size, right_size); ++i) {
+                if (state.left_gains[i].first + state.right_gains[i].first <= 0) break;
+                std::swap(m_order[state.left_gains[i].second],
+                          m_order[state.right_gains[i].second]);
+                ++num_swaps;
+            }
+            if (num_swaps == 0) break;
+        }
+
+        if (depth < parallel_depth) {
+            std::thread left_thread(
+                [&]() { bisect(begin, mid, depth + 1, max_depth, parallel_depth); });
+            bisect(mid, end, depth + 1, max_depth, parallel_depth, state);
+            left_thread.join();
+        } else {
+            bisect(begin, mid, depth + 1, max_depth, parallel_depth, state);
+            bisect(mid, end, depth + 1, max_depth, parallel_depth, state);
+        }
+    }
+};
+
+/*
+    Rebuild a hybrid index renaming doc i as permutation[i]. The unitigs are not
+    changed: the k2u and u2c maps are moved from the source index.
+*/
+template <typename ColorClasses>
+struct index<ColorClasses>::permuted_references_builder {
+    static_assert(std::is_same_v<ColorClasses, hybrid>,
+                  "only hybrid indexes can be rebuilt with permuted references");
+
+    permuted_references_builder() {}
+
+    void build(index& from, std::vector<uint32_t> const& permutation, index& idx) {
+        if (idx.m_k2u.size() != 0) throw std::runtime_error("index already built");
+
+        const uint64_t num_docs = from.num_docs();
+        const uint64_t num_color_sets = from.num_color_sets();
+        if (permutation.size() != num_docs) throw std::runtime_error("wrong permutation size");
+
+        /* the sizes of the color sets do not change: keep the thresholds of the index */
+        typename ColorClasses::builder colors_builder(num_docs,
+                                                      from.m_ccs.sparse_set_threshold_size(),
+                                                      from.m_ccs.very_dense_set_threshold_size());
+        std::vector<uint32_t> list;
+        list.reserve(num_docs);
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+            auto it = from.color_set(color_set_id);
+            const uint64_t size = it.size();
+            list.resize(size);
+            it.decode(list.data());
+            for (auto& doc : list) doc = permutation[doc];
+            std::sort(list.begin(), list.end());
+            colors_builder.process(list.data(), list.size());
+        }
+        colors_builder.build(idx.m_ccs);
+        if (!from.m_ccs.sizes().empty()) idx.m_ccs.build_color_set_sizes();
+
+        std::vector<std::string> filenames(num_docs);
+        for (uint64_t i = 0; i != num_docs; ++i) filenames[permutation[i]] = from.filename(i);
+        idx.m_filenames.build(filenames);
+
+        /* the unitigs are not permuted: u2c and k2u stay the same */
+        idx.m_u2c = std::move(from.m_u2c);
+        idx.m_k2u = std::move(from.m_k2u);
+    }
+};
+
+}  // namespace fulgor
@@ -1,147 +1,116 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "external/sketch/include/sketch/hll.h"
-#include "external/kmeans/include/kmeans.hpp"
 #include "color_classes/meta.hpp"
+#include "sketches.hpp"
 
 namespace fulgor {
 
+/* reg = max(reg, x), atomically */
+static inline void atomic_max(uint8_t* reg, uint8_t x) {
+    uint8_t old = __atomic_load_n(reg, __ATOMIC_RELAXED);
+    while (old < x and
+           !__atomic_compare_exchange_n(reg, &old, x, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/*
+    Build a HLL sketch of 2^p registers for each reference, over the hashes of the ids of
+    the unitigs whose color set contains the reference.
+    All the unitigs of a color set are added to the same references: the registers of the
+    color set are computed once, keeping the max per register, and then merged into the
+    sketch of each reference of the color set. So each reference costs at most 2^p register
+    updates per color set instead of one per unitig. Color sets are processed in chunks,
+    taken dynamically by the threads, that update a single array of sketches with atomic max.
+    If sampling_rate < 1, only a (pseudo-random) fraction sampling_rate of the unitigs is
+    sketched.
+*/
 void build_reference_sketches(index_type const& index,
-                              uint64_t p,                  // use 2^p bytes per HLL sketch
-                              uint64_t num_threads,        // num. threads for construction
-                              std::string output_filename  // where the sketches will be serialized
+                              uint64_t p,                   // use 2^p bytes per HLL sketch
+                              uint64_t num_threads,         // num. threads for construction
+                              std::string output_filename,  // where the sketches will be serialized
+                              double sampling_rate = 1.0    // fraction of the unitigs to sketch
 ) {
     assert(num_threads > 0);
+    assert(p > 0 and p < 32);
+    assert(sampling_rate > 0.0 and sampling_rate <= 1.0);
 
     const uint64_t num_docs = index.num_docs();
+    const uint64_t num_registers = 1ULL << p;
     typename sketch::hll_t::HashType hasher;
     auto const& u2c = index.get_u2c();
     auto const& ccs = index.get_color_sets();
     const uint64_t num_color_sets = ccs.num_color_sets();
-    const uint64_t num_ones = u2c.num_ones();
-    assert(num_color_sets == num_ones);
-
-    if (num_ones < num_threads) {
-        throw std::runtime_error("there are only " + std::to_string(num_color_sets) +
-                                 ": reduce the number of threads.");
-    }
-
-    std::vector<std::vector<sketch::hll_t>> thread_sketches(
-        num_threads, std::vector<sketch::hll_t>(num_docs, sketch::hll_t(p)));
-
-    struct slice {
-        uint64_t begin;                         // start position in u2c
-        uint64_t color_id_begin, color_id_end;  // [..)
-    };
-    std::vector<slice> thread_slices;
-
-    /* compute load */
-    uint64_t load = 0;
-    {
-        uint64_t pop_count = 0;
-        uint64_t prev_pos = 0;
-        pthash::bit_vector::unary_iterator unary_it(u2c);
-        for (uint64_t color_id = 0; color_id != num_color_sets; ++color_id) {
-            uint64_t curr_pos = pop_count != num_ones ? unary_it.next() : (u2c.size() - 1);
-            uint64_t num_unitigs = curr_pos - prev_pos + 1;
-            auto it = ccs.color_set(color_id);
-            uint64_t size = it.size();
-            load += size * num_unitigs;
-            pop_count += 1;
-            prev_pos = curr_pos + 1;
-        }
-    }
-
-    const uint64_t load_per_thread = load / num_threads;
-    if (load_per_thread == 0) {
-        throw std::runtime_error("load is too small: reduce the number of threads");
-    }
-
-    {
-        uint64_t prev_pos = 0;
-        pthash::bit_vector::unary_iterator unary_it(u2c);
-        slice s;
-        s.begin = 0;
-        s.color_id_begin = 0;
-        uint64_t cur_load = 0;
-
-        for (uint64_t color_id = 0; color_id != num_color_sets; ++color_id) {
-            uint64_t curr_pos =
-                color_id != num_color_sets - 1 ? unary_it.next() : (u2c.size() - 1);
-
-            uint64_t num_unitigs = curr_pos - prev_pos + 1;
-            auto it = ccs.color_set(color_id);
-            uint64_t size = it.size();
-            cur_load += size * num_unitigs;
-            prev_pos = curr_pos + 1;
-
-            if (cur_load >= load_per_thread or color_id == num_color_sets - 1) {
-                s.color_id_end = color_id + 1;
-                thread_slices.push_back(s);
-                s.begin = prev_pos;
-                s.color_id_begin = color_id + 1;
-                cur_load = 0;
+    assert(num_color_sets == u2c.num_ones());
+
+    /* a unitig is sketched if the hash of its id, with a different seed, is below threshold */
+    const bool sampling = sampling_rate < 1.0;
+    const uint64_t sampling_threshold =
+        static_cast<uint64_t>(sampling_rate * static_cast<double>(uint64_t(-1)));
+    constexpr uint64_t sampling_seed = 0x9e3779b97f4a7c15;
+
+    /* the registers of all sketches, one sketch after the other */
+    std::vector<uint8_t> registers(num_docs * num_registers, 0);
+
+    /* chunks of color sets, taken dynamically by the threads */
+    constexpr uint64_t chunk_size = 1024;
+    const uint64_t num_chunks = (num_color_sets + chunk_size - 1) / chunk_size;
+
+    std::atomic<uint64_t> next_chunk = 0;
+    auto exe = [&]() {
+        std::vector<uint8_t> color_set_registers(num_registers, 0);
+        std::vector<uint32_t> non_empty_registers;
+        std::vector<uint32_t> color_set(num_docs);
+        while (true) {
+            const uint64_t chunk = next_chunk++;
+            if (chunk >= num_chunks) break;
+            const uint64_t color_id_end = std::min(num_color_sets, (chunk + 1) * chunk_size);
+            for (uint64_t color_id = chunk * chunk_size; color_id != color_id_end; ++color_id) {
+                auto [unitig_id_begin, unitig_id_end] = u2c.unitigs(color_id);
+                for (uint64_t unitig_id = unitig_id_begin; unitig_id != unitig_id_end;
+                     ++unitig_id) {
+                    assert(unitig_id < u2c.size());
+                    assert(index.u2c(unitig_id) == color_id);
+                    if (sampling and hasher.hash(unitig_id ^ sampling_seed) > sampling_threshold) {
+                        continue;
+                    }
+                    uint64_t hash = hasher.hash(unitig_id);
+                    uint64_t reg = hash >> (64 - p);
+                    uint8_t rank = __builtin_clzll((hash << p) | (uint64_t(1) << (p - 1))) + 1;
+                    if (color_set_registers[reg] == 0) non_empty_registers.push_back(reg);
+                    if (rank > color_set_registers[reg]) color_set_registers[reg] = rank;
+                }
+                if (non_empty_registers.empty()) continue;
+
+                std::sort(non_empty_registers.begin(), non_empty_registers.end());
+                const uint64_t size = ccs.color_set(color_id).decode(color_set.data());
+                for (uint64_t i = 0; i != size; ++i) {
+                    uint32_t ref_id = color_set[i];
+                    assert(ref_id < num_docs);
+                    uint8_t* sketch = registers.data() + ref_id * num_registers;
+                    for (auto reg : non_empty_registers) {
+                        atomic_max(sketch + reg, color_set_registers[reg]);
+                    }
+                }
+
+                for (auto reg : non_empty_registers) color_set_registers[reg] = 0;
+                non_empty_registers.clear();
             }
         }
-
-        num_threads = thread_slices.size();
-    }
-
-    auto exe = [&](uint64_t thread_id) {
-        assert(thread_id < thread_slices.size());
-        auto& sketches = thread_sketches[thread_id];
-        auto s = thread_slices[thread_id];
-        uint64_t prev_pos = s.begin;
-        std::vector<uint64_t> hashes;
-        pthash::bit_vector::unary_iterator unary_it(u2c, s.begin);
-        for (uint64_t color_id = s.color_id_begin; color_id != s.color_id_end; ++color_id) {
-            uint64_t curr_pos =
-                color_id != num_color_sets - 1 ? unary_it.next() : (u2c.size() - 1);
-            auto it = ccs.color_set(color_id);
-            const uint64_t size = it.size();
-            hashes.reserve(curr_pos - prev_pos + 1);
-            for (uint64_t unitig_id = prev_pos; unitig_id <= curr_pos; ++unitig_id) {
-                assert(unitig_id < u2c.size());
-                assert(index.u2c(unitig_id) == color_id);
-                hashes.push_back(hasher.hash(unitig_id));
-            }
-            for (uint64_t i = 0; i != size; ++i, ++it) {
-                uint32_t ref_id = *it;
-                assert(ref_id < num_docs);
-                for (auto hash : hashes) sketches[ref_id].add(hash);
-            }
-            prev_pos = curr_pos + 1;
-            hashes.clear();
-        }
     };
 
+    num_threads = std::min(num_threads, num_chunks);
     std::vector<std::thread> threads(num_threads);
-    for (uint64_t thread_id = 0; thread_id != num_threads; ++thread_id) {
-        threads[thread_id] = std::thread(exe, thread_id);
-    }
+    for (auto& t : threads) t = std::thread(exe);
     for (auto& t : threads) {
         if (t.joinable()) t.join();
     }
 
-    /* merge sketches into thread_sketches[0] */
-    for (uint64_t i = 0; i != num_docs; ++i) {
-        auto& sketch = thread_sketches[0][i];
-        for (uint64_t thread_id = 1; thread_id != num_threads; ++thread_id) {
-            sketch += thread_sketches[thread_id][i];
-        }
-    }
-
-    std::ofstream out(output_filename, std::ios::binary);
-    if (!out.is_open()) throw std::runtime_error("cannot open file");
-    const uint64_t num_bytes = 1ULL << p;
-    out.write(reinterpret_cast<char const*>(&num_bytes), 8);
-    out.write(reinterpret_cast<char const*>(&num_docs), 8);
-    for (auto const& x : thread_sketches[0]) {
-        assert(x.m() == num_bytes);
-        assert(x.m() == x.core().size());
-        uint8_t const* data = x.data();
-        out.write(reinterpret_cast<char const*>(data), num_bytes);
-    }
+    sketch_matrix_writer out(output_filename, num_registers, num_docs);
+    for (uint64_t i = 0; i != num_docs; ++i) out.write(registers.data() + i * num_registers);
     out.close();
 }
 
@@ -210,13 +179,13 @@ void build_colors_sketches_sliced(
         auto& sketches = thread_sketches[thread_id];
         auto s = thread_slices[thread_id];
         sketches = std::vector<sketch::hll_t>(s.end - s.begin, sketch::hll_t(p));
+        std::vector<uint32_t> color_set(num_docs);
 
         for (uint64_t color_id = s.begin; color_id != s.end; ++color_id) {
-            auto it = filtered_colors[color_id];
-            const uint64_t size = it.size();
+            const uint64_t size = filtered_colors[color_id].decode(color_set.data());
             assert(size > 0);
-            for (uint64_t i = 0; i < size; ++i, ++it) {
-                uint64_t ref_id = *it;
+            for (uint64_t i = 0; i < size; ++i) {
+                uint64_t ref_id = color_set[i];
                 assert(ref_id < num_docs);
                 sketches[color_id - s.begin].addh(ref_id);
             }
@@ -231,21 +200,14 @@ void build_colors_sketches_sliced(
         if (t.joinable()) t.join();
     }
 
-    std::ofstream out(output_filename, std::ios::binary);
-    if (!out.is_open()) throw std::runtime_error("cannot open file");
+    /* the ids of the sketched color sets are stored along with the sketches */
     const uint64_t num_bytes = 1ULL << p;
-    out.write(reinterpret_cast<char const*>(&num_bytes), 8);
-    out.write(reinterpret_cast<char const*>(&num_docs), 8);
-    out.write(reinterpret_cast<char const*>(&partition_size), 8);
-    for (auto const color_id : filtered_colors_ids) {
-        out.write(reinterpret_cast<char const*>(&color_id), 8);
-    }
+    sketch_matrix_writer out(output_filename, num_bytes, partition_size, filtered_colors_ids);
     for (auto const& sketch : thread_sketches) {
         for (auto const& x : sketch) {
             assert(x.m() == num_bytes);
             assert(x.m() == x.core().size());
-            uint8_t const* data = x.data();
-            out.write(reinterpret_cast<char const*>(data), num_bytes);
+            out.write(x.data());
         }
     }
     out.close();
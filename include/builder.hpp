@@ -2,6 +2,7 @@
 
 #include "index.hpp"
 #include "GGCAT.hpp"
+#include "hybrid_calibration.hpp"
 
 namespace fulgor {
 
@@ -40,7 +41,17 @@ struct index<ColorClasses>::builder {
             std::ofstream out((m_build_config.file_base_name + ".fa").c_str());
             if (!out.is_open()) throw std::runtime_error("cannot open output file");
 
-            typename ColorClasses::builder colors_builder(m_build_config.num_docs);
+            typename ColorClasses::builder colors_builder;
+            if constexpr (std::is_same_v<ColorClasses, hybrid>) {
+                if (m_build_config.optimize != optimize_target::none) {
+                    auto [sparse, very_dense] = calibrate_hybrid_thresholds();
+                    colors_builder.init(m_build_config.num_docs, sparse, very_dense);
+                } else {
+                    colors_builder.init(m_build_config.num_docs);
+                }
+            } else {
+                colors_builder.init(m_build_config.num_docs);
+            }
 
             m_ccdbg.loop_through_unitigs([&](ggcat::Slice<char> const unitig,
                                              ggcat::Slice<uint32_t> const colors, bool same_color) {
@@ -82,6 +93,9 @@ struct index<ColorClasses>::builder {
             std::cout << "m_u2c.size() " << idx.m_u2c.size() << std::endl;
             std::cout << "m_u2c.num_ones() " << idx.m_u2c.num_ones() << std::endl;
             std::cout << "m_u2c.num_zeros() " << idx.m_u2c.num_zeros() << std::endl;
+            std::cout << "m_u2c is encoded as "
+                      << (idx.m_u2c.type() == u2c_map::elias_fano ? "Elias-Fano" : "a bit vector")
+                      << " (" << idx.m_u2c.bytes() << " bytes)" << std::endl;
 
             colors_builder.build(idx.m_ccs);
 
@@ -141,15 +155,16 @@ struct index<ColorClasses>::builder {
                             return;
                         }
                     }
-                    auto fwd_it = idx.m_ccs.color_set(color_id);
-                    const uint64_t size = fwd_it.size();
+                    thread_local std::vector<uint32_t> color_set;
+                    color_set.resize(idx.num_docs());
+                    const uint64_t size = idx.m_ccs.color_set(color_id).decode(color_set.data());
                     if (size != colors.size) {
                         std::cout << "got colors list of size " << size << " but expected "
                                   << colors.size << std::endl;
                         return;
                     }
-                    for (uint64_t i = 0; i != size; ++i, ++fwd_it) {
-                        uint32_t ref = *fwd_it;
+                    for (uint64_t i = 0; i != size; ++i) {
+                        uint32_t ref = color_set[i];
                         if (ref != colors.data[i]) {
                             std::cout << "got ref " << ref << " but expected " << colors.data[i]
                                       << std::endl;
@@ -166,6 +181,17 @@ struct index<ColorClasses>::builder {
 private:
     build_configuration m_build_config;
     GGCAT m_ccdbg;
+
+    /* sample the distinct color sets of the ccdBG and calibrate the thresholds of hybrid */
+    std::pair<uint32_t, uint32_t> calibrate_hybrid_thresholds() const {
+        essentials::logger("calibrating the thresholds of hybrid...");
+        hybrid_thresholds_calibrator calibrator(m_build_config.num_docs);
+        m_ccdbg.loop_through_unitigs([&](ggcat::Slice<char> const /* unitig */,
+                                         ggcat::Slice<uint32_t> const colors, bool same_color) {
+            if (!same_color) calibrator.add(colors.data, colors.size);
+        });
+        return calibrator.calibrate(m_build_config.optimize);
+    }
 };
 
 }  // namespace fulgor
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+namespace fulgor {
+
+/* num_points points of num_bytes_per_point bytes each, stored stride bytes apart */
+struct points_view {
+    points_view() : m_data(nullptr), m_num_points(0), m_num_bytes_per_point(0), m_stride(0) {}
+
+    points_view(uint8_t const* data, uint64_t num_points, uint64_t num_bytes_per_point,
+                uint64_t stride)
+        : m_data(data)
+        , m_num_points(num_points)
+        , m_num_bytes_per_point(num_bytes_per_point)
+        , m_stride(stride) {
+        assert(stride >= num_bytes_per_point);
+    }
+
+    uint8_t const* operator[](uint64_t i) const {
+        assert(i < m_num_points);
+        return m_data + i * m_stride;
+    }
+
+    uint64_t num_points() const { return m_num_points; }
+    uint64_t num_bytes_per_point() const { return m_num_bytes_per_point; }
+    uint64_t stride() const { return m_stride; }
+
+private:
+    uint8_t const* m_data;
+    uint64_t m_num_points, m_num_bytes_per_point, m_stride;
+};
+
+struct clustering_parameters {
+    clustering_parameters()
+        : min_delta(0.0001)
+        , max_iteration(10)
+        , min_cluster_size(0)
+        , min_split_gain(0.0)
+        , seed(0)
+        , num_threads(1) {}
+
+    /* stop the 2-means iterations when less than a fraction min_delta of the points moves */
+    float min_delta;
+    uint64_t max_iteration;
+    /* a cluster is not split if one of the two halves would be smaller than this */
+    uint64_t min_cluster_size;
+    /* a split is accepted if it reduces the SSE of the cluster by at least this fraction:
+       the default 0 accepts any split that does not increase it, as kmeans_divisive did;
+       a positive value stops splitting earlier and gives fewer (coarser) clusters */
+    float min_split_gain;
+    uint64_t seed;
+    uint64_t num_threads;
+};
+
+struct clustering_data {
+    uint64_t num_clusters;
+    std::vector<uint32_t> clusters;  // the cluster id of each point
+};
+
+namespace clustering {
+
+/* sum_i x[i] * w[i] */
+static inline float dot(uint8_t const* x, float const* w, uint64_t n) {
+    uint64_t i = 0;
+    float sum = 0;
+#if defined(__AVX2__) && defined(__FMA__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(x + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+        acc0 = _mm256_fmadd_ps(lo, _mm256_loadu_ps(w + i), acc0);
+        acc1 = _mm256_fmadd_ps(hi, _mm256_loadu_ps(w + i + 8), acc1);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    sum = _mm_cvtss_f32(s);
+#endif
+    for (; i != n; ++i) sum += static_cast<float>(x[i]) * w[i];
+    return sum;
+}
+
+/* run f(begin, end, thread_id) over chunks of [0, n), taken dynamically by the threads */
+template <typename Func>
+void parallel_for(uint64_t n, uint64_t num_threads, Func f, uint64_t chunk_size = 1024) {
+    const uint64_t num_chunks = (n + chunk_size - 1) / chunk_size;
+    num_threads = std::max<uint64_t>(1, std::min(num_threads, num_chunks));
+    if (num_threads == 1) {
+        if (n != 0) f(0, n, 0);
+        return;
+    }
+    std::atomic<uint64_t> next_chunk = 0;
+    std::vector<std::thread> threads(num_threads);
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads[t] = std::thread([&, t]() {
+            while (true) {
+                const uint64_t chunk = next_chunk++;
+                if (chunk >= num_chunks) break;
+                const uint64_t begin = chunk * chunk_size;
+                f(begin, std::min(begin + chunk_size, n), t);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+/*
+    The points are only ever summed as integers, so the sums, the centroids and
+    the SSEs do not depend on the order of the reductions: the clustering is the
+    same for any number of threads.
+*/
+struct bisecting_kmeans {
+    bisecting_kmeans(points_view const& points, clustering_parameters const& params)
+        : m_points(points)
+        , m_params(params)
+        , m_d(points.num_bytes_per_point())
+        , m_norms(points.num_points()) {
+        parallel_for(points.num_points(), params.num_threads,
+                     [&](uint64_t begin, uint64_t end, uint64_t) {
+                         for (uint64_t i = begin; i != end; ++i) {
+                             uint8_t const* x = m_points[i];
+                             uint64_t norm = 0;
+                             for (uint64_t j = 0; j != m_d; ++j) norm += x[j] * x[j];
+                             m_norms[i] = norm;
+                         }
+                     });
+    }
+
+    struct range {
+        uint64_t begin, end;
+        uint64_t size() const { return end - begin; }
+    };
+
+    clustering_data run() {
+        const uint64_t num_points = m_points.num_points();
+        m_ids.resize(num_points);
+        for (uint64_t i = 0; i != num_points; ++i) m_ids[i] = i;
+
+        /*
+            Split the clusters level by level. Large clusters are split one at a time
+            with all threads; the others are split concurrently, one per thread.
+        */
+        const uint64_t large_cluster_size =
+            std::max<uint64_t>(1 << 16, num_points / std::max<uint64_t>(m_params.num_threads, 1));
+        std::vector<range> leaves;
+        std::vector<range> to_split;
+        if (num_points != 0) to_split.push_back({0, num_points});
+        while (!to_split.empty()) {
+            std::vector<uint64_t> split_pos(to_split.size(), 0);
+            std::vector<uint64_t> small;
+            for (uint64_t i = 0; i != to_split.size(); ++i) {
+                if (to_split[i].size() >= large_cluster_size) {
+                    split_pos[i] = bisect(to_split[i], m_params.num_threads);
+                } else {
+                    small.push_back(i);
+                }
+            }
+            parallel_for(small.size(), m_params.num_threads,
+                         [&](uint64_t begin, uint64_t end, uint64_t) {
+                             for (uint64_t i = begin; i != end; ++i) {
+                                 split_pos[small[i]] = bisect(to_split[small[i]], 1);
+                             }
+                         },
+                         1);
+            std::vector<range> next;
+            for (uint64_t i = 0; i != to_split.size(); ++i) {
+                range r = to_split[i];
+                if (split_pos[i] == 0) {
+                    leaves.push_back(r);
+                } else {
+                    next.push_back({r.begin, split_pos[i]});
+                    next.push_back({split_pos[i], r.end});
+                }
+            }
+            to_split.swap(next);
+        }
+
+        std::sort(leaves.begin(), leaves.end(),
+                  [](range const& x, range const& y) { return x.begin < y.begin; });
+        clustering_data data;
+        data.num_clusters = leaves.size();
+        data.clusters.resize(num_points);
+        for (uint64_t c = 0; c != leaves.size(); ++c) {
+            for (uint64_t i = leaves[c].begin; i != leaves[c].end; ++i) data.clusters[m_ids[i]] = c;
+        }
+        return data;
+    }
+
+private:
+    points_view m_points;
+    clustering_parameters m_params;
+    uint64_t m_d;
+    std::vector<uint64_t> m_norms;  // squared norm of each point
+    std::vector<uint32_t> m_ids;    // the points, grouped by cluster
+
+    /* sum of the points with positions in [begin, end) and mask[i - begin] == value */
+    void sum(range r, std::vector<uint8_t> const& mask, uint8_t value, uint64_t num_threads,
+             std::vector<uint64_t>& s, uint64_t& q, uint64_t& n) const {
+        num_threads = std::max<uint64_t>(1, std::min(num_threads, r.size() / 1024 + 1));
+        std::vector<std::vector<uint64_t>> thread_s(num_threads, std::vector<uint64_t>(m_d, 0));
+        std::vector<uint64_t> thread_q(num_threads, 0), thread_n(num_threads, 0);
+        parallel_for(r.size(), num_threads, [&](uint64_t begin, uint64_t end, uint64_t t) {
+            uint64_t* ts = thread_s[t].data();
+            for (uint64_t i = begin; i != end; ++i) {
+                if (mask[i] != value) continue;
+                const uint32_t id = m_ids[r.begin + i];
+                uint8_t const* x = m_points[id];
+                for (uint64_t j = 0; j != m_d; ++j) ts[j] += x[j];
+                thread_q[t] += m_norms[id];
+                thread_n[t] += 1;
+            }
+        });
+        s.assign(m_d, 0);
+        q = 0;
+        n = 0;
+        for (uint64_t t = 0; t != num_threads; ++t) {
+            for (uint64_t j = 0; j != m_d; ++j) s[j] += thread_s[t][j];
+            q += thread_q[t];
+            n += thread_n[t];
+        }
+    }
+
+    /* SSE of n points with sum s and sum of squared norms q */
+    double sse(std::vector<uint64_t> const& s, uint64_t q, uint64_t n) const {
+        if (n == 0) return 0;
+        double ss = 0;
+        for (uint64_t j = 0; j != m_d; ++j) ss += static_cast<double>(s[j]) * s[j];
+        return std::max(0.0, static_cast<double>(q) - ss / n);
+    }
+
+    void centroid(std::vector<uint64_t> const& s, uint64_t n, std::vector<float>& c) const {
+        c.resize(m_d);
+        for (uint64_t j = 0; j != m_d; ++j) c[j] = static_cast<double>(s[j]) / n;
+    }
+
+    /*
+        Split the cluster in two with 2-means, seeded as in k-means++.
+        Return the position of the first point of the second half, or 0 if the
+        cluster is not split. The points of each half keep their relative order.
+    */
+    uint64_t bisect(range r, uint64_t num_threads) {
+        const uint64_t n = r.size();
+        const uint64_t min_size = std::max<uint64_t>(m_params.min_cluster_size, 1);
+        if (n < 2 * min_size or m_params.max_iteration == 0) return 0;
+
+        std::vector<uint8_t> mask(n, 0);
+        std::vector<uint64_t> s, s0, s1;
+        uint64_t q = 0, n_all = 0, q1 = 0, n1 = 0;
+        sum(r, mask, 0, num_threads, s, q, n_all);
+        assert(n_all == n);
+        const double parent_sse = sse(s, q, n);
+        if (parent_sse == 0) return 0;
+
+        /* seeding: the first centroid is a random point, the second is drawn with
+           probability proportional to the squared distance from the first */
+        std::mt19937_64 rng(m_params.seed ^ (r.begin * 0x9e3779b97f4a7c15ULL));
+        std::vector<float> c0(m_d), c1(m_d);
+        {
+            const uint32_t id0 = m_ids[r.begin + rng() % n];
+            uint8_t const* x0 = m_points[id0];
+            for (uint64_t j = 0; j != m_d; ++j) c0[j] = x0[j];
+            std::vector<double> dist(n);
+            parallel_for(n, num_threads, [&](uint64_t begin, uint64_t end, uint64_t) {
+                for (uint64_t i = begin; i != end; ++i) {
+                    const uint32_t id = m_ids[r.begin + i];
+                    double d = static_cast<double>(m_norms[id]) + m_norms[id0] -
+                               2.0 * dot(m_points[id], c0.data(), m_d);
+                    dist[i] = std::max(0.0, d);
+                }
+            });
+            double total = 0;
+            for (auto d : dist) total += d;
+            if (total == 0) return 0;
+            double target = std::uniform_real_distribution<double>(0, total)(rng);
+            uint64_t i = 0;
+            for (; i != n - 1; ++i) {
+                target -= dist[i];
+                if (target < 0) break;
+            }
+            uint8_t const* x1 = m_points[m_ids[r.begin + i]];
+            for (uint64_t j = 0; j != m_d; ++j) c1[j] = x1[j];
+        }
+
+        /* Lloyd iterations: a point goes to the second half if it is closer to c1,
+           that is, if x * (c0 - c1) < (|c0|^2 - |c1|^2) / 2 */
+        std::vector<float> w(m_d);
+        for (uint64_t iteration = 0; iteration != m_params.max_iteration; ++iteration) {
+            double t = 0;
+            for (uint64_t j = 0; j != m_d; ++j) {
+                w[j] = c0[j] - c1[j];
+                t += (static_cast<double>(c0[j]) * c0[j] - static_cast<double>(c1[j]) * c1[j]);
+            }
+            t /= 2;
+            std::atomic<uint64_t> num_moved = 0;
+            parallel_for(n, num_threads, [&](uint64_t begin, uint64_t end, uint64_t) {
+                uint64_t moved = 0;
+                for (uint64_t i = begin; i != end; ++i) {
+                    uint8_t a = dot(m_points[m_ids[r.begin + i]], w.data(), m_d) < t;
+                    moved += a != mask[i];
+                    mask[i] = a;
+                }
+                num_moved += moved;
+            });
+            sum(r, mask, 1, num_threads, s1, q1, n1);
+            if (n1 == 0 or n1 == n) return 0;
+            s0.resize(m_d);
+            for (uint64_t j = 0; j != m_d; ++j) s0[j] = s[j] - s1[j];
+            centroid(s0, n - n1, c0);
+            centroid(s1, n1, c1);
+            if (num_moved <= m_params.min_delta * n) break;
+        }
+
+        const uint64_t n0 = n - n1;
+        if (n0 < min_size or n1 < min_size) return 0;
+        const double children_sse = sse(s0, q - q1, n0) + sse(s1, q1, n1);
+        if (parent_sse - children_sse < m_params.min_split_gain * parent_sse) return 0;
+
+        /* stable partition of the points: first half, then second half */
+        std::vector<uint32_t> ids(n);
+        uint64_t pos0 = 0, pos1 = n0;
+        for (uint64_t i = 0; i != n; ++i) {
+            ids[mask[i] ? pos1++ : pos0++] = m_ids[r.begin + i];
+        }
+        std::copy(ids.begin(), ids.end(), m_ids.begin() + r.begin);
+        return r.begin + n0;
+    }
+};
+
+}  // namespace clustering
+
+/*
+    Divisive clustering: starting from a single cluster, split the clusters in two
+    with 2-means until the splits stop reducing the SSE significantly.
+    The distances are computed on the uint8 coordinates of the points with SIMD
+    dot products, and every step is parallelized over params.num_threads threads.
+*/
+static clustering_data kmeans_divisive(points_view const& points,
+                                       clustering_parameters const& params) {
+    clustering::bisecting_kmeans kmeans(points, params);
+    return kmeans.run();
+}
+
+}  // namespace fulgor
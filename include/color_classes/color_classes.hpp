@@ -2,4 +2,8 @@
 
 #include "include/bit_vector.hpp"
 #include "include/integer_codes.hpp"
+#include "include/ranked_bit_vector.hpp"
+#include "include/color_classes/color_set_sizes.hpp"
+#include "include/color_classes/partition_bitmaps.hpp"
 #include "include/color_classes/hybrid.hpp"
+#include "include/color_classes/roaring.hpp"
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "include/util.hpp"
+
+namespace fulgor {
+
+/*
+    The sizes of the color sets of a color class, stored apart from the color sets in
+    a compact vector of msb(num_docs) + 1 bits per color set, so that the size of a color
+    set is read without touching its encoding (e.g., to order the color sets of an
+    intersection). It is optional: empty unless built.
+*/
+struct color_set_sizes {
+    template <typename ColorClasses>
+    void build(ColorClasses const& ccs) {
+        const uint64_t num_color_sets = ccs.num_color_sets();
+        assert(ccs.num_docs() > 0);
+        pthash::compact_vector::builder sizes(num_color_sets, util::msbll(ccs.num_docs()) + 1);
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+            sizes.set(color_set_id, ccs.color_set(color_set_id).size());
+        }
+        sizes.build(m_sizes);
+    }
+
+    bool empty() const { return m_sizes.size() == 0; }
+
+    uint32_t operator[](uint64_t color_set_id) const {
+        assert(color_set_id < m_sizes.size());
+        return m_sizes.access(color_set_id);
+    }
+
+    uint64_t num_bits() const { return m_sizes.bytes() * 8; }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_sizes);
+    }
+
+private:
+    pthash::compact_vector m_sizes;
+};
+
+/*
+    Base of the color classes (CRTP), giving them optional color_set_sizes: store the sizes
+    of the color sets apart from them, so that color_set_size does not access the color set.
+*/
+template <typename ColorClasses>
+struct with_color_set_sizes {
+    uint32_t color_set_size(uint64_t color_set_id) const {
+        assert(color_set_id < self().num_color_sets());
+        return m_sizes.empty() ? self().color_set(color_set_id).size() : m_sizes[color_set_id];
+    }
+
+    void build_color_set_sizes() { m_sizes.build(self()); }
+    color_set_sizes const& sizes() const { return m_sizes; }
+
+protected:
+    color_set_sizes m_sizes;  // optional
+
+private:
+    ColorClasses const& self() const { return static_cast<ColorClasses const&>(*this); }
+};
+
+}  // namespace fulgor
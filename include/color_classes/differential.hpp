@@ -2,7 +2,7 @@
 
 namespace fulgor {
 
-struct differential {
+struct differential : with_color_set_sizes<differential> {
     static const bool meta_colored = false;
     static const bool differential_colored = true;
 
@@ -178,6 +178,29 @@ struct differential {
             assert(value() >= lower_bound);
         }
 
+        uint64_t decode(uint32_t* out) const { return decode_range(0, num_docs(), out); }
+
+        /* the symmetric difference of the representative and the differential list */
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= num_docs());
+            std::vector<uint32_t> representative, differential_list;
+            auto representative_it = bit_vector_iterator((m_ptr->m_colors).data(),
+                                                         (m_ptr->m_colors).size(), m_representative_begin);
+            util::read_delta(representative_it);  // skip size
+            decode_list(representative_it, m_representative_size, representative);
+            auto differential_list_it = bit_vector_iterator((m_ptr->m_colors).data(),
+                                                            (m_ptr->m_colors).size(), m_differential_list_begin);
+            util::read_delta(differential_list_it);  // skip size
+            util::read_delta(differential_list_it);  // skip color set size
+            decode_list(differential_list_it, m_differential_list_size, differential_list);
+
+            auto r_begin = std::lower_bound(representative.begin(), representative.end(), lo);
+            auto r_end = std::lower_bound(r_begin, representative.end(), hi);
+            auto d_begin = std::lower_bound(differential_list.begin(), differential_list.end(), lo);
+            auto d_end = std::lower_bound(d_begin, differential_list.end(), hi);
+            return std::set_symmetric_difference(r_begin, r_end, d_begin, d_end, out) - out;
+        }
+
         uint32_t num_docs() const { return m_ptr->m_num_docs; }
         uint64_t differential_list_size() const { return m_differential_list_size; }
 
@@ -191,7 +214,7 @@ struct differential {
             m_pos_in_differential_list += 1;
             m_prev_differential_val = m_curr_differential_val;
             if (m_pos_in_differential_list < m_differential_list_size) {
-                m_curr_differential_val = m_prev_differential_val + util::read_delta(m_differential_list_it) + 1;
+                m_curr_differential_val = m_prev_differential_val + m_differential_gaps.next(m_differential_list_it) + 1;
             } else {
                 m_curr_differential_val = num_docs();
             }
@@ -204,7 +227,7 @@ struct differential {
             m_pos_in_representative += 1;
             m_prev_representative_val = m_curr_representative_val;
             if (m_pos_in_representative < m_representative_size) {
-                m_curr_representative_val = m_prev_representative_val + util::read_delta(m_representative_it) + 1;
+                m_curr_representative_val = m_prev_representative_val + m_representative_gaps.next(m_representative_it) + 1;
             } else {
                 m_curr_representative_val = num_docs();
             }
@@ -223,6 +246,14 @@ struct differential {
         uint32_t m_curr_val;
         uint32_t m_size;
         bit_vector_iterator m_representative_it, m_differential_list_it;
+        util::delta_buffer m_representative_gaps, m_differential_gaps;
+
+        /* decode the size delta-coded gaps after it */
+        static void decode_list(bit_vector_iterator& it, uint64_t size, std::vector<uint32_t>& list) {
+            list.resize(size);
+            util::read_delta_n(it, list.data(), size);
+            for (uint64_t i = 1; i < size; ++i) list[i] += list[i - 1] + 1;
+        }
 
 	void init(){
             m_differential_list_it = bit_vector_iterator((m_ptr->m_colors).data(), (m_ptr->m_colors).size(),
@@ -232,11 +263,13 @@ struct differential {
             m_differential_list_size = util::read_delta(m_differential_list_it);
             m_representative_size = util::read_delta(m_representative_it);
             m_size = util::read_delta(m_differential_list_it);
+            m_differential_gaps.reset(m_differential_list_size);
+            m_representative_gaps.reset(m_representative_size);
 
-            m_curr_differential_val = m_differential_list_size == 0 ? num_docs() : util::read_delta(m_differential_list_it);
+            m_curr_differential_val = m_differential_list_size == 0 ? num_docs() : m_differential_gaps.next(m_differential_list_it);
             m_prev_differential_val = 0;
             m_curr_representative_val =
-                m_representative_size == 0 ? num_docs() : util::read_delta(m_representative_it);
+                m_representative_size == 0 ? num_docs() : m_representative_gaps.next(m_representative_it);
             m_prev_representative_val = 0;
 
             m_pos_in_differential_list = 0;
@@ -270,7 +303,7 @@ struct differential {
 
     uint64_t num_bits() const {
         return sizeof(m_num_docs) * 8 + m_representative_offsets.num_bits() + m_list_offsets.num_bits() +
-               essentials::vec_bytes(m_colors) * 8 + m_clusters.bytes() * 8;
+               essentials::vec_bytes(m_colors) * 8 + m_clusters.bytes() * 8 + m_sizes.num_bits();
     }
 
     void print_stats() const {
@@ -405,6 +438,7 @@ struct differential {
         visitor.visit(m_list_offsets);
         visitor.visit(m_colors);
         visitor.visit(m_clusters);
+        visitor.visit(m_sizes);
     }
 
 private:
@@ -422,9 +456,9 @@ private:
         if (size == 0) return {};
 
         std::vector<uint64_t> set(size);
-        set[0] = util::read_delta(it);
+        util::read_delta_n(it, set.data(), size);
         for(uint64_t i = 1; i != size; ++i){
-            set[i] = set[i-1] + util::read_delta(it) + 1;
+            set[i] += set[i-1] + 1;
         }
         return set;
     }
@@ -437,9 +471,9 @@ private:
         if (size == 0) return {};
 
         std::vector<uint64_t> set(size);
-        set[0] = util::read_delta(it);
+        util::read_delta_n(it, set.data(), size);
         for(uint64_t i = 1; i != size; ++i){
-            set[i] = set[i-1] + util::read_delta(it) + 1;
+            set[i] += set[i-1] + 1;
         }
         return set;
     }
@@ -2,40 +2,69 @@
 
 namespace fulgor {
 
-struct hybrid {
+struct hybrid : with_color_set_sizes<hybrid> {
     static const bool meta_colored = false;
     static const bool differential_colored = false;
 
+    /* the thresholds chosen for space, used unless build calibrates them (see
+       hybrid_thresholds_calibrator) */
+    static uint32_t default_sparse_set_threshold(uint64_t num_docs) { return 0.25 * num_docs; }
+    static uint32_t default_very_dense_set_threshold(uint64_t num_docs) { return 0.75 * num_docs; }
+
     struct builder {
         builder() {}
         builder(uint64_t num_docs) { init(num_docs); }
+        builder(uint64_t num_docs, uint32_t sparse_set_threshold_size,
+                uint32_t very_dense_set_threshold_size, bool verbose = true) {
+            init(num_docs, sparse_set_threshold_size, very_dense_set_threshold_size, verbose);
+        }
 
         void init(uint64_t num_docs) {
+            init(num_docs, default_sparse_set_threshold(num_docs),
+                 default_very_dense_set_threshold(num_docs));
+        }
+
+        /* if not verbose, the builder prints nothing (e.g., for trial builds) */
+        void init(uint64_t num_docs, uint32_t sparse_set_threshold_size,
+                  uint32_t very_dense_set_threshold_size, bool verbose = true) {
+            assert(sparse_set_threshold_size <= very_dense_set_threshold_size);
             m_num_docs = num_docs;
+            m_verbose = verbose;
 
             /* if list contains < sparse_set_threshold_size ints, code it with gaps+delta */
-            m_sparse_set_threshold_size = 0.25 * m_num_docs;
+            m_sparse_set_threshold_size = sparse_set_threshold_size;
 
-            /* if list contains > very_dense_set_threshold_size ints, code it as a complementary set
-               with gaps+delta */
-            m_very_dense_set_threshold_size = 0.75 * m_num_docs;
+            /* if list contains >= very_dense_set_threshold_size ints, code it as a complementary
+               set with gaps+delta */
+            m_very_dense_set_threshold_size = very_dense_set_threshold_size;
             /* otherwise: code it as a bitmap of m_num_docs bits */
 
-            std::cout << "m_num_docs: " << m_num_docs << std::endl;
-            std::cout << "m_sparse_set_threshold_size " << m_sparse_set_threshold_size << std::endl;
-            std::cout << "m_very_dense_set_threshold_size " << m_very_dense_set_threshold_size
-                      << std::endl;
+            if (m_verbose) {
+                std::cout << "m_num_docs: " << m_num_docs << std::endl;
+                std::cout << "m_sparse_set_threshold_size " << m_sparse_set_threshold_size
+                          << std::endl;
+                std::cout << "m_very_dense_set_threshold_size " << m_very_dense_set_threshold_size
+                          << std::endl;
+            }
 
             m_bvb.reserve(8 * essentials::GB);
             m_offsets.push_back(0);
 
             m_num_lists = 0;
             m_num_total_integers = 0;
+            m_num_run_length_lists = 0;
+            m_run_length_coding = true;
+            m_hot_ids.clear();
+            m_hot_sizes.clear();
+            m_hot_offsets.clear();
+            m_hot_ints.clear();
+            m_hot_bitmaps.clear();
         }
 
         void process(uint32_t const* colors, uint64_t list_size) {
-            /* encode list_size */
-            util::write_delta(m_bvb, list_size);
+            const uint64_t begin = m_bvb.num_bits();
+            /* encode list_size, with the flag of run-length coding as lowest bit */
+            util::write_delta(m_bvb, list_size << 1);
             if (list_size < m_sparse_set_threshold_size) {
                 uint32_t prev_val = colors[0];
                 util::write_delta(m_bvb, prev_val);
@@ -85,26 +114,91 @@ struct hybrid {
                 assert(m_num_docs - list_size <= m_num_docs);
                 assert(written == m_num_docs - list_size);
             }
+
+            /* code the list as runs instead, if smaller (an empty list has no runs) */
+            if (m_run_length_coding and list_size != 0) {
+                uint64_t run_lengths_bits = util::delta_length((list_size << 1) | 1);
+                const uint64_t num_runs =
+                    for_each_run(colors, list_size, [&](uint64_t gap, uint64_t length) {
+                        run_lengths_bits +=
+                            util::delta_length(gap) + util::delta_length(length - 1);
+                    });
+                run_lengths_bits += util::delta_length(num_runs - 1);
+                if (run_lengths_bits < m_bvb.num_bits() - begin) {
+                    m_bvb.truncate(begin);
+                    util::write_delta(m_bvb, (list_size << 1) | 1);
+                    util::write_delta(m_bvb, num_runs - 1);
+                    for_each_run(colors, list_size, [&](uint64_t gap, uint64_t length) {
+                        util::write_delta(m_bvb, gap);
+                        util::write_delta(m_bvb, length - 1);
+                    });
+                    m_num_run_length_lists += 1;
+                }
+            }
+
             m_offsets.push_back(m_bvb.num_bits());
             m_num_total_integers += list_size;
             m_num_lists += 1;
-            if (m_num_lists % 500000 == 0) {
+            if (m_verbose and m_num_lists % 500000 == 0) {
                 std::cout << "  processed " << m_num_lists << " lists" << std::endl;
             }
         }
 
+        /* whether process() may code a list as runs (on by default): off, every list gets
+           the representation chosen by the thresholds */
+        void set_run_length_coding(bool run_length_coding) {
+            m_run_length_coding = run_length_coding;
+        }
+
+        /* Store the list uncompressed, in the hot section instead of m_bvb: as an array of
+           ints if smaller than a bitmap of m_num_docs bits, as a word-aligned bitmap
+           otherwise. Its range in m_bvb is empty. */
+        void process_hot(uint32_t const* colors, uint64_t list_size) {
+            m_hot_ids.push_back(m_num_lists);
+            m_hot_sizes.push_back(list_size);
+            if (is_hot_array(list_size, m_num_docs)) {
+                m_hot_offsets.push_back(m_hot_ints.size());
+                m_hot_ints.insert(m_hot_ints.end(), colors, colors + list_size);
+            } else {
+                m_hot_offsets.push_back(m_hot_bitmaps.size());
+                const uint64_t begin = m_hot_bitmaps.size();
+                m_hot_bitmaps.resize(begin + util::num_64bit_words_for(m_num_docs), 0);
+                for (uint64_t i = 0; i != list_size; ++i) {
+                    m_hot_bitmaps[begin + colors[i] / 64] |= uint64_t(1) << (colors[i] % 64);
+                }
+            }
+
+            m_offsets.push_back(m_bvb.num_bits());
+            m_num_total_integers += list_size;
+            m_num_lists += 1;
+        }
+
         void build(hybrid& h) {
             h.m_num_docs = m_num_docs;
             h.m_sparse_set_threshold_size = m_sparse_set_threshold_size;
             h.m_very_dense_set_threshold_size = m_very_dense_set_threshold_size;
 
-            std::cout << "processed " << m_num_lists << " lists" << std::endl;
-            std::cout << "m_num_total_integers " << m_num_total_integers << std::endl;
             assert(m_num_lists == m_offsets.size() - 1);
 
             h.m_offsets.encode(m_offsets.begin(), m_offsets.size(), m_offsets.back());
             h.m_colors.swap(m_bvb.bits());
 
+            if (!m_hot_ids.empty()) {
+                pthash::bit_vector_builder hot(m_num_lists, 0);
+                for (auto id : m_hot_ids) hot.set(id, 1);
+                h.m_hot.build(&hot);
+            }
+            h.m_hot_sizes.swap(m_hot_sizes);
+            h.m_hot_offsets.swap(m_hot_offsets);
+            h.m_hot_ints.swap(m_hot_ints);
+            h.m_hot_bitmaps.swap(m_hot_bitmaps);
+
+            if (!m_verbose) return;
+            std::cout << "processed " << m_num_lists << " lists" << std::endl;
+            std::cout << "m_num_total_integers " << m_num_total_integers << std::endl;
+            std::cout << "  run-length coded lists: " << m_num_run_length_lists << std::endl;
+            std::cout << "  hot lists: " << h.m_hot_sizes.size() << " ("
+                      << h.num_hot_bits() << " bits)" << std::endl;
             std::cout << "  total bits for ints = " << h.m_colors.size() * 64 << std::endl;
             std::cout << "  total bits per offsets = " << h.m_offsets.num_bits() << std::endl;
             std::cout << "  total bits = " << h.m_offsets.num_bits() + h.m_colors.size() * 64
@@ -123,23 +217,245 @@ struct hybrid {
         uint32_t m_very_dense_set_threshold_size;
         uint64_t m_num_lists;
         uint64_t m_num_total_integers;
+        uint64_t m_num_run_length_lists;
+        bool m_run_length_coding;
+        bool m_verbose;
 
         bit_vector_builder m_bvb;
         std::vector<uint64_t> m_offsets;
+
+        std::vector<uint32_t> m_hot_ids;
+        std::vector<uint32_t> m_hot_sizes;
+        std::vector<uint64_t> m_hot_offsets;
+        std::vector<uint32_t> m_hot_ints;
+        std::vector<uint64_t> m_hot_bitmaps;
+
+        /* Call f(gap, length) for each maximal run of consecutive ints of the list, where gap
+           is the start of the first run and, for the others, the number of ints between the
+           run and the previous one minus 1 (at least 1 int is missing between two runs).
+           Return the number of runs. */
+        template <typename F>
+        static uint64_t for_each_run(uint32_t const* colors, uint64_t list_size, F f) {
+            uint64_t num_runs = 0;
+            uint64_t prev_last = 0;
+            for (uint64_t i = 0; i != list_size;) {
+                uint64_t j = i + 1;
+                while (j != list_size and colors[j] == colors[j - 1] + 1) ++j;
+                f(num_runs == 0 ? colors[i] : colors[i] - (prev_last + 2), j - i);
+                prev_last = colors[j - 1];
+                num_runs += 1;
+                i = j;
+            }
+            return num_runs;
+        }
+    };
+
+    /*
+        Iterators over a single list type, without the type dispatch of
+        forward_iterator: they are obtained from a forward_iterator of that type
+        and used by the intersection kernels.
+    */
+
+    struct delta_gaps_iterator {
+        delta_gaps_iterator(bit_vector_iterator it, uint32_t size, uint32_t num_docs)
+            : m_it(it), m_size(size), m_num_docs(num_docs), m_pos_in_list(0) {
+            m_gaps.reset(m_size);
+            m_curr_val = m_size != 0 ? m_gaps.next(m_it) : m_num_docs;
+        }
+
+        uint32_t value() const { return m_curr_val; }
+        uint32_t size() const { return m_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+
+        void next() {
+            m_pos_in_list += 1;
+            if (m_pos_in_list >= m_size) {  // saturate
+                m_curr_val = m_num_docs;
+                return;
+            }
+            m_curr_val += m_gaps.next(m_it) + 1;
+        }
+
+        void next_geq(const uint32_t lower_bound) {
+            while (m_curr_val < lower_bound) next();
+        }
+
+        /* decode the rest of the list into out, returning the number of elements */
+        uint64_t decode(uint32_t* out) {
+            uint64_t n = 0;
+            for (; m_curr_val < m_num_docs; next()) out[n++] = m_curr_val;
+            return n;
+        }
+
+    private:
+        bit_vector_iterator m_it;
+        util::delta_buffer m_gaps;
+        uint32_t m_size, m_num_docs;
+        uint32_t m_pos_in_list;
+        uint32_t m_curr_val;
+    };
+
+    struct bitmap_iterator {
+        bitmap_iterator(uint64_t const* data, uint64_t num_words, uint64_t begin, uint32_t size,
+                        uint32_t num_docs)
+            : m_data(data)
+            , m_num_words(num_words)
+            , m_begin(begin)
+            , m_size(size)
+            , m_num_docs(num_docs) {}
+
+        uint32_t size() const { return m_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+
+        /* whether doc belongs to the list: a single bit test */
+        bool contains(uint64_t doc) const {
+            assert(doc < m_num_docs);
+            const uint64_t pos = m_begin + doc;
+            return (m_data[pos / 64] >> (pos % 64)) & 1;
+        }
+
+        /* the 64 bits of the bitmap for the docs [base, base + 64) */
+        uint64_t word(uint64_t base) const {
+            assert(base < m_num_docs);
+            const uint64_t pos = m_begin + base;
+            const uint64_t block = pos / 64;
+            const uint64_t shift = pos % 64;
+            uint64_t w = m_data[block] >> shift;
+            if (shift and block + 1 < m_num_words) w |= m_data[block + 1] << (64 - shift);
+            if (m_num_docs - base < 64) w &= (uint64_t(1) << (m_num_docs - base)) - 1;
+            return w;
+        }
+
+    private:
+        uint64_t const* m_data;
+        uint64_t m_num_words;
+        uint64_t m_begin;
+        uint32_t m_size, m_num_docs;
+    };
+
+    struct complement_delta_gaps_iterator {
+        complement_delta_gaps_iterator(bit_vector_iterator it, uint32_t size, uint32_t num_docs)
+            : m_it(it)
+            , m_comp_list_size(num_docs - size)
+            , m_num_docs(num_docs)
+            , m_pos_in_comp_list(0) {
+            m_gaps.reset(m_comp_list_size);
+            m_comp_val = m_comp_list_size != 0 ? m_gaps.next(m_it) : m_num_docs;
+        }
+
+        uint32_t size() const { return m_num_docs - m_comp_list_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+        uint32_t comp_value() const { return m_comp_val; }
+
+        void next_comp() {
+            m_pos_in_comp_list += 1;
+            if (m_pos_in_comp_list >= m_comp_list_size) {  // saturate
+                m_comp_val = m_num_docs;
+                return;
+            }
+            m_comp_val += m_gaps.next(m_it) + 1;
+        }
+
+        /* whether doc belongs to the list: doc must not decrease across calls */
+        bool contains(const uint32_t doc) {
+            while (m_comp_val < doc) next_comp();
+            return m_comp_val != doc;
+        }
+
+    private:
+        bit_vector_iterator m_it;
+        util::delta_buffer m_gaps;
+        uint32_t m_comp_list_size, m_num_docs;
+        uint32_t m_pos_in_comp_list;
+        uint32_t m_comp_val;
+    };
+
+    struct run_lengths_iterator {
+        run_lengths_iterator(bit_vector_iterator it, uint32_t size, uint32_t num_docs)
+            : m_it(it), m_size(size), m_num_docs(num_docs), m_run(0) {
+            m_num_runs = util::read_delta(m_it) + 1;
+            m_gaps.reset(2 * m_num_runs);
+            m_start = m_gaps.next(m_it);
+            m_last = m_start + m_gaps.next(m_it);
+        }
+
+        uint32_t size() const { return m_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+        uint32_t num_runs() const { return m_num_runs; }
+
+        /* the current run is [start(), last()]; start() is num_docs() past the last run */
+        uint32_t start() const { return m_start; }
+        uint32_t last() const { return m_last; }
+
+        void next_run() {
+            m_run += 1;
+            if (m_run >= m_num_runs) {  // saturate
+                m_start = m_last = m_num_docs;
+                return;
+            }
+            m_start = m_last + 2 + m_gaps.next(m_it);
+            m_last = m_start + m_gaps.next(m_it);
+        }
+
+        /* whether doc belongs to the list: doc must not decrease across calls */
+        bool contains(const uint32_t doc) {
+            while (m_last < doc and m_start < m_num_docs) next_run();
+            return m_start <= doc and doc <= m_last and m_start < m_num_docs;
+        }
+
+    private:
+        bit_vector_iterator m_it;
+        util::delta_buffer m_gaps;
+        uint32_t m_size, m_num_docs;
+        uint32_t m_num_runs, m_run;
+        uint32_t m_start, m_last;
+    };
+
+    struct uncompressed_iterator {
+        uncompressed_iterator(uint32_t const* data, uint32_t size, uint32_t num_docs)
+            : m_data(data), m_size(size), m_num_docs(num_docs), m_pos_in_list(0) {}
+
+        uint32_t value() const {
+            return m_pos_in_list < m_size ? m_data[m_pos_in_list] : m_num_docs;
+        }
+        uint32_t size() const { return m_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+
+        void next_geq(const uint32_t lower_bound) {
+            m_pos_in_list =
+                std::lower_bound(m_data + m_pos_in_list, m_data + m_size, lower_bound) - m_data;
+        }
+
+        /* decode the rest of the list into out, returning the number of elements */
+        uint64_t decode(uint32_t* out) const {
+            std::copy(m_data + m_pos_in_list, m_data + m_size, out);
+            return m_size - m_pos_in_list;
+        }
+
+    private:
+        uint32_t const* m_data;
+        uint32_t m_size, m_num_docs;
+        uint32_t m_pos_in_list;
     };
 
     struct forward_iterator {
         forward_iterator() {}
 
-        forward_iterator(hybrid const* ptr, uint64_t begin)
+        /* begin is the position of the list in m_colors, or the rank of a hot list */
+        forward_iterator(hybrid const* ptr, uint64_t begin, bool hot = false)
             : m_ptr(ptr)
             , m_bitmap_begin(begin)
             , m_colors_begin(begin)
-            , m_num_docs(ptr->m_num_docs) {
+            , m_num_docs(ptr->m_num_docs)
+            , m_hot(hot) {
             rewind();
         }
 
         void rewind() {
+            if (m_hot) {
+                rewind_hot();
+                return;
+            }
             m_pos_in_list = 0;
             m_pos_in_comp_list = 0;
             m_comp_list_size = 0;
@@ -148,11 +464,20 @@ struct hybrid {
             m_curr_val = 0;
             m_it = bit_vector_iterator((m_ptr->m_colors).data(), (m_ptr->m_colors).size(),
                                        m_colors_begin);
-            m_size = util::read_delta(m_it);
+            const uint64_t header = util::read_delta(m_it);
+            m_size = header >> 1;
             /* set m_type and read the first value */
-            if (m_size < m_ptr->m_sparse_set_threshold_size) {
+            if (header & 1) {
+                m_type = list_type::run_lengths;
+                m_num_runs = util::read_delta(m_it) + 1;
+                m_run = 0;
+                m_gaps.reset(2 * m_num_runs);
+                m_curr_val = m_gaps.next(m_it);
+                m_run_last = m_curr_val + m_gaps.next(m_it);
+            } else if (m_size < m_ptr->m_sparse_set_threshold_size) {
                 m_type = list_type::delta_gaps;
-                m_curr_val = util::read_delta(m_it);
+                m_gaps.reset(m_size);
+                m_curr_val = m_size != 0 ? m_gaps.next(m_it) : m_num_docs;
             } else if (m_size < m_ptr->m_very_dense_set_threshold_size) {
                 m_type = list_type::bitmap;
                 m_bitmap_begin = m_it.position();  // after m_size
@@ -163,7 +488,8 @@ struct hybrid {
             } else {
                 m_type = list_type::complement_delta_gaps;
                 m_comp_list_size = m_num_docs - m_size;
-                if (m_comp_list_size > 0) m_comp_val = util::read_delta(m_it);
+                m_gaps.reset(m_comp_list_size);
+                if (m_comp_list_size > 0) m_comp_val = m_gaps.next(m_it);
                 next_comp_val();
             }
         }
@@ -178,8 +504,9 @@ struct hybrid {
             m_it = bit_vector_iterator((m_ptr->m_colors).data(), (m_ptr->m_colors).size(),
                                        m_colors_begin);
             util::read_delta(m_it); /* skip m_size */
+            m_gaps.reset(m_comp_list_size);
             if (m_comp_list_size > 0) {
-                m_comp_val = util::read_delta(m_it);
+                m_comp_val = m_gaps.next(m_it);
             } else {
                 m_comp_val = m_num_docs;
             }
@@ -190,6 +517,19 @@ struct hybrid {
         uint64_t operator*() const { return value(); }
 
         void next() {
+            if (m_type == list_type::uncompressed) {
+                m_pos_in_list += 1;
+                m_curr_val = m_pos_in_list < m_size ? m_ints[m_pos_in_list] : m_num_docs;
+                return;
+            }
+            if (m_type == list_type::run_lengths) {
+                if (m_curr_val < m_run_last) {
+                    ++m_curr_val;
+                } else {
+                    next_run();
+                }
+                return;
+            }
             if (m_type == list_type::complement_delta_gaps) {
                 ++m_curr_val;
                 if (m_curr_val >= m_num_docs) {  // saturate
@@ -204,7 +544,7 @@ struct hybrid {
                     return;
                 }
                 m_prev_val = m_curr_val;
-                m_curr_val = util::read_delta(m_it) + (m_prev_val + 1);
+                m_curr_val = m_gaps.next(m_it) + (m_prev_val + 1);
             } else {
                 assert(m_type == list_type::bitmap);
                 m_pos_in_list += 1;
@@ -225,7 +565,7 @@ struct hybrid {
                 return;
             }
             m_prev_val = m_comp_val;
-            m_comp_val = util::read_delta(m_it) + (m_prev_val + 1);
+            m_comp_val = m_gaps.next(m_it) + (m_prev_val + 1);
         }
 
         void operator++() { next(); }
@@ -237,25 +577,135 @@ struct hybrid {
             if (m_type == list_type::complement_delta_gaps) {
                 if (value() > lower_bound) return;
                 next_geq_comp_val(lower_bound);
-                m_curr_val = lower_bound + (m_comp_val == lower_bound);
+                m_curr_val = lower_bound;
+                next_comp_val();  // skip consecutive ints of the complement
+            } else if (m_type == list_type::run_lengths) {
+                /* skip whole runs, decoding two ints per run */
+                while (m_run_last < lower_bound and m_curr_val < m_num_docs) next_run();
+                if (m_curr_val < lower_bound) m_curr_val = lower_bound;
+            } else if (m_type == list_type::uncompressed) {
+                if (value() >= lower_bound) return;
+                m_pos_in_list =
+                    std::lower_bound(m_ints + m_pos_in_list, m_ints + m_size, lower_bound) -
+                    m_ints;
+                m_curr_val = m_pos_in_list < m_size ? m_ints[m_pos_in_list] : m_num_docs;
             } else {
                 while (value() < lower_bound) next();
             }
             assert(value() >= lower_bound);
         }
 
+        /* delta_gaps lists are decoded in one pass, the others with decode_range */
+        uint64_t decode(uint32_t* out) const {
+            if (m_type != list_type::delta_gaps) return decode_range(0, m_num_docs, out);
+            bit_vector_iterator it = list_iterator();
+            util::read_delta_n(it, out, m_size);
+            for (uint64_t i = 1; i < m_size; ++i) out[i] += out[i - 1] + 1;
+            return m_size;
+        }
+
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= num_docs());
+            uint64_t n = 0;
+            if (lo == hi) return n;
+            if (m_type == list_type::uncompressed) {
+                uint32_t const* begin = std::lower_bound(m_ints, m_ints + m_size, lo);
+                uint32_t const* end = std::lower_bound(begin, m_ints + m_size, hi);
+                std::copy(begin, end, out);
+                return end - begin;
+            }
+            if (m_type == list_type::bitmap) {
+                bit_vector_iterator it(bitmap_words().data(), bitmap_words().size(),
+                                       m_bitmap_begin + lo);
+                for (uint64_t base = lo; base < hi; base += 64) {
+                    uint64_t word = it.take(hi - base < 64 ? hi - base : 64);
+                    while (word) {
+                        out[n++] = base + util::lsbll(word);
+                        word &= word - 1;
+                    }
+                }
+                return n;
+            }
+
+            bit_vector_iterator it = list_iterator();
+            util::delta_buffer gaps;
+            if (m_type == list_type::run_lengths) {
+                const uint64_t num_runs = util::read_delta(it) + 1;
+                gaps.reset(2 * num_runs);
+                uint64_t last = -2;  // so that the first start is last + 2 + gap = gap
+                for (uint64_t i = 0; i != num_runs; ++i) {
+                    const uint64_t start = last + 2 + gaps.next(it);
+                    last = start + gaps.next(it);
+                    if (start >= hi) break;
+                    for (uint64_t x = std::max(start, lo); x <= last and x < hi; ++x) out[n++] = x;
+                }
+                return n;
+            }
+            if (m_type == list_type::delta_gaps) {
+                gaps.reset(m_size);
+                uint64_t val = -1;
+                for (uint64_t i = 0; i != m_size; ++i) {
+                    val += gaps.next(it) + 1;
+                    if (val >= hi) break;
+                    if (val >= lo) out[n++] = val;
+                }
+                return n;
+            }
+
+            assert(m_type == list_type::complement_delta_gaps);
+            gaps.reset(m_comp_list_size);
+            uint64_t val = lo;      // next candidate
+            uint64_t comp_val = -1;  // last element of the complement
+            for (uint64_t i = 0; i != m_comp_list_size; ++i) {
+                comp_val += gaps.next(it) + 1;
+                if (comp_val < lo) continue;
+                const uint64_t end = comp_val < hi ? comp_val : hi;
+                for (; val < end; ++val) out[n++] = val;
+                val = comp_val + 1;
+                if (val >= hi) return n;
+            }
+            for (; val < hi; ++val) out[n++] = val;
+            return n;
+        }
+
         uint32_t size() const { return m_size; }
         uint32_t num_docs() const { return m_num_docs; }
         int type() const { return m_type; }
 
+        /* the iterator specialized for the type of the list, from its beginning */
+        delta_gaps_iterator as_delta_gaps() const {
+            assert(m_type == list_type::delta_gaps);
+            return delta_gaps_iterator(list_iterator(), m_size, m_num_docs);
+        }
+        bitmap_iterator as_bitmap() const {
+            assert(m_type == list_type::bitmap);
+            return bitmap_iterator(bitmap_words().data(), bitmap_words().size(),
+                                   m_bitmap_begin, m_size, m_num_docs);
+        }
+        complement_delta_gaps_iterator as_complement_delta_gaps() const {
+            assert(m_type == list_type::complement_delta_gaps);
+            return complement_delta_gaps_iterator(list_iterator(), m_size, m_num_docs);
+        }
+        run_lengths_iterator as_run_lengths() const {
+            assert(m_type == list_type::run_lengths);
+            return run_lengths_iterator(list_iterator(), m_size, m_num_docs);
+        }
+        uncompressed_iterator as_uncompressed() const {
+            assert(m_type == list_type::uncompressed);
+            return uncompressed_iterator(m_ints, m_size, m_num_docs);
+        }
+
     private:
         hybrid const* m_ptr;
         uint64_t m_bitmap_begin;
-        uint64_t m_colors_begin;
+        uint64_t m_colors_begin;  // the rank of the list among the hot ones, if m_hot
         uint32_t m_num_docs;
         int m_type;
+        bool m_hot;
+        uint32_t const* m_ints;  // the ints of an uncompressed list
 
         bit_vector_iterator m_it;
+        util::delta_buffer m_gaps;  // the gaps of delta_gaps and complement_delta_gaps lists
         uint32_t m_pos_in_list;
         uint32_t m_size;
 
@@ -266,13 +716,61 @@ struct hybrid {
         uint32_t m_prev_val;
         uint32_t m_curr_val;
 
+        uint32_t m_num_runs, m_run;
+        uint32_t m_run_last;  // the last int of the current run
+
+        /* a hot list is an array of ints (uncompressed) or a word-aligned bitmap */
+        void rewind_hot() {
+            const uint64_t hot_id = m_colors_begin;
+            const uint64_t offset = m_ptr->m_hot_offsets[hot_id];
+            m_size = m_ptr->m_hot_sizes[hot_id];
+            m_pos_in_list = 0;
+            if (is_hot_array(m_size, m_num_docs)) {
+                m_type = list_type::uncompressed;
+                m_ints = m_ptr->m_hot_ints.data() + offset;
+                m_curr_val = m_size != 0 ? m_ints[0] : m_num_docs;
+            } else {
+                m_type = list_type::bitmap;
+                m_bitmap_begin = offset * 64;
+                m_it = bit_vector_iterator((m_ptr->m_hot_bitmaps).data(),
+                                           (m_ptr->m_hot_bitmaps).size(), m_bitmap_begin);
+                m_it.at_and_clear_low_bits(m_bitmap_begin);
+                uint64_t pos = m_it.next();
+                assert(pos >= m_bitmap_begin);
+                m_curr_val = pos - m_bitmap_begin;
+            }
+        }
+
+        /* the words that hold the bitmap of a bitmap list */
+        std::vector<uint64_t> const& bitmap_words() const {
+            return m_hot ? m_ptr->m_hot_bitmaps : m_ptr->m_colors;
+        }
+
+        /* an iterator to the first element (or gap) of the list, after its size */
+        bit_vector_iterator list_iterator() const {
+            bit_vector_iterator it((m_ptr->m_colors).data(), (m_ptr->m_colors).size(),
+                                   m_colors_begin);
+            util::read_delta(it); /* skip m_size */
+            return it;
+        }
+
+        void next_run() {
+            ++m_run;
+            if (m_run >= m_num_runs) {  // saturate
+                m_curr_val = m_num_docs;
+                return;
+            }
+            m_curr_val = m_run_last + 2 + m_gaps.next(m_it);
+            m_run_last = m_curr_val + m_gaps.next(m_it);
+        }
+
         void next_comp_val() {
             while (m_curr_val == m_comp_val) {
                 ++m_curr_val;
                 ++m_pos_in_comp_list;
                 if (m_pos_in_comp_list >= m_comp_list_size) break;
                 m_prev_val = m_comp_val;
-                m_comp_val = util::read_delta(m_it) + (m_prev_val + 1);
+                m_comp_val = m_gaps.next(m_it) + (m_prev_val + 1);
             }
         }
 
@@ -281,7 +779,7 @@ struct hybrid {
                 ++m_pos_in_comp_list;
                 if (m_pos_in_comp_list >= m_comp_list_size) break;
                 m_prev_val = m_comp_val;
-                m_comp_val = util::read_delta(m_it) + (m_prev_val + 1);
+                m_comp_val = m_gaps.next(m_it) + (m_prev_val + 1);
             }
         }
     };
@@ -290,18 +788,50 @@ struct hybrid {
 
     forward_iterator color_set(uint64_t color_set_id) const {
         assert(color_set_id < num_color_sets());
+        if (!m_hot_sizes.empty() and m_hot[color_set_id]) {
+            return forward_iterator(this, m_hot.rank(color_set_id), true);
+        }
         uint64_t begin = m_offsets.access(color_set_id);
         return forward_iterator(this, begin);
     }
 
+    /* whether a list of list_size ints is hot as an array of ints, rather than a bitmap */
+    static bool is_hot_array(uint64_t list_size, uint64_t num_docs) {
+        return list_size * 32 < util::num_64bit_words_for(num_docs) * 64;
+    }
+
+    uint64_t num_hot_color_sets() const { return m_hot_sizes.size(); }
+
     uint32_t num_docs() const { return m_num_docs; }
     uint64_t num_color_sets() const { return m_offsets.size() - 1; }
+    uint32_t sparse_set_threshold_size() const { return m_sparse_set_threshold_size; }
+    uint32_t very_dense_set_threshold_size() const { return m_very_dense_set_threshold_size; }
+
+    /* the number of bits of the color set, including its size */
+    uint64_t color_set_num_bits(uint64_t color_set_id) const {
+        assert(color_set_id < num_color_sets());
+        if (!m_hot_sizes.empty() and m_hot[color_set_id]) {
+            const uint64_t size = m_hot_sizes[m_hot.rank(color_set_id)];
+            return is_hot_array(size, m_num_docs) ? size * 32
+                                                  : util::num_64bit_words_for(m_num_docs) * 64;
+        }
+        return m_offsets.access(color_set_id + 1) - m_offsets.access(color_set_id);
+    }
 
     uint64_t num_bits() const {
         return (sizeof(m_num_docs) + sizeof(m_sparse_set_threshold_size) +
                 sizeof(m_very_dense_set_threshold_size)) *
                    8 +
-               m_offsets.num_bits() + essentials::vec_bytes(m_colors) * 8;
+               m_offsets.num_bits() + essentials::vec_bytes(m_colors) * 8 + num_hot_bits() +
+               m_sizes.num_bits();
+    }
+
+    /* the bits of the hot lists, including the map from color set ids */
+    uint64_t num_hot_bits() const {
+        return m_hot.bytes() * 8 +
+               (essentials::vec_bytes(m_hot_sizes) + essentials::vec_bytes(m_hot_offsets) +
+                essentials::vec_bytes(m_hot_ints) + essentials::vec_bytes(m_hot_bitmaps)) *
+                   8;
     }
 
     void print_stats() const {
@@ -326,10 +856,15 @@ struct hybrid {
         uint64_t num_total_integers = 0;
         for (uint64_t color_set_id = 0; color_set_id != m_offsets.size() - 1;
              ++color_set_id) {
-            uint64_t offset = m_offsets.access(color_set_id);
-            bit_vector_iterator it(m_colors.data(), m_colors.size(), offset);
-            uint32_t list_size = util::read_delta(it);
-            uint64_t num_bits = m_offsets.access(color_set_id + 1) - offset;
+            uint32_t list_size = 0;
+            if (!m_hot_sizes.empty() and m_hot[color_set_id]) {
+                list_size = m_hot_sizes[m_hot.rank(color_set_id)];
+            } else {
+                bit_vector_iterator it(m_colors.data(), m_colors.size(),
+                                       m_offsets.access(color_set_id));
+                list_size = util::read_delta(it) >> 1;
+            }
+            uint64_t num_bits = color_set_num_bits(color_set_id);
             auto bucket_it = std::upper_bound(list_size_upperbounds.begin(),
                                               list_size_upperbounds.end(), list_size);
             if (bucket_it != list_size_upperbounds.begin() and *(bucket_it - 1) == list_size) {
@@ -379,6 +914,11 @@ struct hybrid {
                                          m_offsets.num_bits()) /
                          integers
                   << " bits/int" << std::endl;
+        if (!m_hot_sizes.empty()) {
+            std::cout << "  hot lists: " << m_hot_sizes.size() << " ("
+                      << (m_hot_sizes.size() * 100.0) / num_lists << "% of the lists) -- "
+                      << num_hot_bits() / 8 << " bytes" << std::endl;
+        }
     }
 
     // void dump(std::ofstream& os) const {
@@ -404,6 +944,12 @@ struct hybrid {
         visitor.visit(m_very_dense_set_threshold_size);
         visitor.visit(m_offsets);
         visitor.visit(m_colors);
+        visitor.visit(m_hot);
+        visitor.visit(m_hot_sizes);
+        visitor.visit(m_hot_offsets);
+        visitor.visit(m_hot_ints);
+        visitor.visit(m_hot_bitmaps);
+        visitor.visit(m_sizes);
     }
 
 private:
@@ -412,6 +958,16 @@ private:
     uint32_t m_very_dense_set_threshold_size;
     sshash::ef_sequence<false> m_offsets;
     std::vector<uint64_t> m_colors;
+
+    /* The hot lists, stored uncompressed and contiguously: m_hot marks their color set
+       ids, and its rank gives their position in m_hot_sizes and m_hot_offsets (in
+       m_hot_ints or in m_hot_bitmaps, in words). It is empty if there are no hot lists. */
+    ranked_bit_vector m_hot;
+    std::vector<uint32_t> m_hot_sizes;
+    std::vector<uint64_t> m_hot_offsets;
+    std::vector<uint32_t> m_hot_ints;
+    std::vector<uint64_t> m_hot_bitmaps;
+
 };
 
 }  // namespace fulgor
\ No newline at end of file
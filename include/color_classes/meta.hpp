@@ -3,7 +3,7 @@
 namespace fulgor {
 
 template <typename ColorClasses>
-struct meta {
+struct meta : with_color_set_sizes<meta<ColorClasses>> {
     static const bool meta_colored = true;
 
     struct partition_endpoint {
@@ -28,6 +28,10 @@ struct meta {
             assert(partition_sizes.front() == 0);
             m_partition_endpoints.push_back({partition_sizes[0], 0});
             for (uint32_t i = 0, val = 0; i != num_lists_in_partitions.size(); ++i) {
+                /* every partition must have a partial color set: see m_partition_ends */
+                if (num_lists_in_partitions[i] == 0) {
+                    throw std::runtime_error("partition " + std::to_string(i) + " is empty");
+                }
                 val += num_lists_in_partitions[i];
                 m_partition_endpoints.push_back({partition_sizes[i + 1], val});
             }
@@ -68,6 +72,13 @@ struct meta {
             m.m_meta_colors_offsets.encode(m_meta_colors_offsets.begin(),
                                            m_meta_colors_offsets.size(),
                                            m_meta_colors_offsets.back());
+
+            const uint64_t num_partial_color_sets = m_partition_endpoints.back().num_lists_before;
+            pthash::bit_vector_builder partition_ends(num_partial_color_sets, 0);
+            for (uint64_t i = 1; i != m_partition_endpoints.size(); ++i) {
+                partition_ends.set(m_partition_endpoints[i].num_lists_before - 1, 1);
+            }
+            m.m_partition_ends.build(&partition_ends);
             m.m_partition_endpoints.swap(m_partition_endpoints);
         }
 
@@ -83,8 +94,17 @@ struct meta {
     };
 
     struct forward_iterator {
-        forward_iterator(meta<ColorClasses> const* ptr, uint64_t begin)
-            : m_ptr(ptr), m_begin(begin), m_meta_color_list_size((m_ptr->m_meta_colors)[m_begin]) {
+        static constexpr uint32_t invalid_size = uint32_t(-1);
+
+        /* size, if known (e.g., stored), saves the first call to size();
+           partition_bitmap is the bitmap of the partitions of the color set, if stored */
+        forward_iterator(meta<ColorClasses> const* ptr, uint64_t begin, uint32_t size,
+                         uint64_t const* partition_bitmap)
+            : m_ptr(ptr)
+            , m_partition_bitmap(partition_bitmap)
+            , m_begin(begin)
+            , m_meta_color_list_size((m_ptr->m_meta_colors)[m_begin])
+            , m_size(size) {
             rewind();
         }
 
@@ -132,24 +152,52 @@ struct meta {
             assert(value() >= lower_bound);
         }
 
-        /* Warning: this might be slow. */
+        /* The first call takes the size of every partial color set; the size is then
+           cached in the iterator. */
         uint32_t size() const {
+            if (m_size != invalid_size) return m_size;
             uint64_t n = 0;
-            for (uint32_t i = 0, partition_id = 0; i != meta_color_list_size(); ++i) {
-                uint32_t meta_color = (m_ptr->m_meta_colors)[m_begin + 1 + i];
-                partition_id = update_partition_id(meta_color, partition_id);
+            for (uint32_t i = 0; i != meta_color_list_size(); ++i) {
+                uint32_t meta_color = meta_color_at(i);
+                uint32_t partition_id = m_ptr->partition_id(meta_color);
                 uint32_t num_lists_before =
                     (m_ptr->m_partition_endpoints)[partition_id].num_lists_before;
                 n += (m_ptr->m_colors)[partition_id].color_set(meta_color - num_lists_before).size();
             }
+            m_size = n;
+            return m_size;
+        }
+
+        uint64_t decode(uint32_t* out) const { return decode_range(0, num_docs(), out); }
+
+        /* only the partial color sets of the partitions overlapping [lo, hi) are decoded */
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= num_docs());
+            auto const& endpoints = m_ptr->m_partition_endpoints;
+            uint64_t n = 0;
+            for (uint32_t i = 0; i != meta_color_list_size(); ++i) {
+                uint32_t meta_color = meta_color_at(i);
+                uint32_t partition_id = m_ptr->partition_id(meta_color);
+                const uint64_t lower_bound = endpoints[partition_id].docid_lower_bound;
+                const uint64_t upper_bound = endpoints[partition_id + 1].docid_lower_bound;
+                if (upper_bound <= lo) continue;
+                if (lower_bound >= hi) break;
+                auto it = (m_ptr->m_colors)[partition_id].color_set(
+                    meta_color - endpoints[partition_id].num_lists_before);
+                const uint64_t partial_lo = lo > lower_bound ? lo - lower_bound : 0;
+                const uint64_t partial_hi = (hi < upper_bound ? hi : upper_bound) - lower_bound;
+                const uint64_t k = it.decode_range(partial_lo, partial_hi, out + n);
+                for (uint64_t j = n; j != n + k; ++j) out[j] += lower_bound;
+                n += k;
+            }
             return n;
         }
 
         uint32_t meta_color() const { return m_curr_meta_color; }
 
         void read_partition_id() {
-            m_curr_meta_color = (m_ptr->m_meta_colors)[m_begin + 1 + m_pos_in_meta_color_list];
-            m_partition_id = update_partition_id(m_curr_meta_color, m_partition_id);
+            m_curr_meta_color = meta_color_at(m_pos_in_meta_color_list);
+            m_partition_id = m_ptr->partition_id(m_curr_meta_color);
         }
 
         void next_partition_id() {
@@ -161,9 +209,42 @@ struct meta {
             read_partition_id();
         }
 
+        /* The meta colors of a list are sorted, and so are their partitions: the first
+           meta color in a partition >= lower_bound is found by exponential search, and then
+           binary search, from the current position. */
         void next_geq_partition_id(const uint32_t lower_bound) {
             assert(lower_bound <= num_partitions());
-            while (partition_id() < lower_bound) next_partition_id();
+            if (partition_id() >= lower_bound) return;
+            if (lower_bound == num_partitions()) {  // saturate
+                m_pos_in_meta_color_list = meta_color_list_size();
+                m_partition_id = num_partitions();
+                return;
+            }
+            const uint32_t meta_color_lower_bound =
+                m_ptr->m_partition_endpoints[lower_bound].num_lists_before;
+            uint32_t lo = m_pos_in_meta_color_list + 1;
+            uint32_t hi = lo;
+            for (uint32_t step = 1;
+                 hi < meta_color_list_size() and meta_color_at(hi) < meta_color_lower_bound;
+                 step *= 2) {
+                lo = hi + 1;
+                hi += step;
+            }
+            hi = std::min(hi, meta_color_list_size());
+            while (lo < hi) {
+                uint32_t mid = lo + (hi - lo) / 2;
+                if (meta_color_at(mid) < meta_color_lower_bound) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            m_pos_in_meta_color_list = lo;
+            if (m_pos_in_meta_color_list == meta_color_list_size()) {  // saturate
+                m_partition_id = num_partitions();
+                return;
+            }
+            read_partition_id();
             assert(partition_id() >= lower_bound);
         }
 
@@ -192,14 +273,19 @@ struct meta {
         uint32_t meta_color_list_size() const { return m_meta_color_list_size; }
         uint32_t num_docs() const { return m_ptr->num_docs(); }
         uint32_t num_partitions() const { return m_ptr->num_partitions(); }
+        uint32_t partition_size() const { return m_curr_partition_size; }
         uint32_t partition_lower_bound() const { return m_partition_lower_bound; }
         uint32_t partition_upper_bound() const { return m_partition_upper_bound; }
         uint32_t num_lists_before() const {
             return m_ptr->m_partition_endpoints[m_partition_id].num_lists_before;
         }
 
+        /* nullptr if the partition bitmaps are not stored */
+        uint64_t const* partition_bitmap() const { return m_partition_bitmap; }
+
     private:
         meta<ColorClasses> const* m_ptr;
+        uint64_t const* m_partition_bitmap;
         typename ColorClasses::iterator_type m_curr_partition_it;
         uint64_t m_begin;
         uint32_t m_curr_meta_color, m_curr_val;
@@ -207,19 +293,15 @@ struct meta {
         uint32_t m_curr_partition_size, m_pos_in_curr_partition;
         uint32_t m_partition_id;
         uint32_t m_partition_lower_bound, m_partition_upper_bound;
+        mutable uint32_t m_size;
 
         void update_curr_val() {
             m_curr_val = m_curr_partition_it.value() + m_partition_lower_bound;
         }
 
-        uint32_t update_partition_id(const uint32_t meta_color, uint32_t partition_id) const {
-            auto const& endpoints = m_ptr->m_partition_endpoints;
-            while (partition_id + 1 < endpoints.size() and
-                   meta_color >= endpoints[partition_id + 1].num_lists_before) {
-                partition_id += 1;
-            }
-            assert(partition_id < m_ptr->num_partitions());
-            return partition_id;
+        uint32_t meta_color_at(uint32_t pos_in_meta_color_list) const {
+            assert(pos_in_meta_color_list < meta_color_list_size());
+            return (m_ptr->m_meta_colors)[m_begin + 1 + pos_in_meta_color_list];
         }
     };
 
@@ -228,10 +310,16 @@ struct meta {
     forward_iterator color_set(uint64_t color_set_id) const {
         assert(color_set_id < num_color_sets());
         uint64_t begin = m_meta_colors_offsets.access(color_set_id);
-        return forward_iterator(this, begin);
+        uint32_t size =
+            this->m_sizes.empty() ? forward_iterator::invalid_size : this->m_sizes[color_set_id];
+        return forward_iterator(this, begin, size, m_partition_bitmaps.bitmap(color_set_id));
     }
 
-    std::vector<ColorClasses> partial_colors() const { return m_colors; }
+    /* store the partitions of each color set as a bitmap (see partition_bitmaps) */
+    void build_partition_bitmaps() { m_partition_bitmaps.build(*this); }
+    partition_bitmaps const& get_partition_bitmaps() const { return m_partition_bitmaps; }
+
+    std::vector<ColorClasses> const& partial_colors() const { return m_colors; }
 
     uint32_t num_docs() const { return m_num_docs; }
 
@@ -241,13 +329,20 @@ struct meta {
     /* num. partial color sets */
     uint64_t num_partitions() const { return m_partition_endpoints.size() - 1; }
 
+    /* the partition of the partial color set meta_color */
+    uint64_t partition_id(uint64_t meta_color) const {
+        assert(meta_color < m_partition_ends.size());
+        return m_partition_ends.rank(meta_color);
+    }
+
     uint64_t num_bits() const {
         uint64_t colors_bits = sizeof(size_t) * 8;  // for std::vector::size
         for (auto const& c : m_colors) colors_bits += c.num_bits();
         return m_meta_colors_offsets.num_bits() + colors_bits +
                (m_meta_colors.bytes() + essentials::vec_bytes(m_partition_endpoints) +
-                sizeof(m_num_docs)) *
-                   8;
+                m_partition_ends.bytes() + sizeof(m_num_docs)) *
+                   8 +
+               this->m_sizes.num_bits() + m_partition_bitmaps.num_bits();
     }
 
     void print_stats() const {
@@ -258,6 +353,7 @@ struct meta {
         uint64_t num_partial_colors_very_dense = 0;
         uint64_t num_partial_colors_dense = 0;
         uint64_t num_partial_colors_sparse = 0;
+        uint64_t num_partial_colors_runs = 0;
         uint64_t num_total_partial_colors = 0;
 
         for (auto const& c : m_colors) {
@@ -271,6 +367,8 @@ struct meta {
                     ++num_partial_colors_very_dense;
                 } else if (it.type() == list_type::bitmap) {
                     ++num_partial_colors_dense;
+                } else if (it.type() == list_type::run_lengths) {
+                    ++num_partial_colors_runs;
                 } else {
                     assert(it.type() == list_type::delta_gaps);
                     ++num_partial_colors_sparse;
@@ -292,6 +390,10 @@ struct meta {
                   << num_total_partial_colors << " ("
                   << (num_partial_colors_sparse * 100.0) / num_total_partial_colors << "%)"
                   << std::endl;
+        std::cout << "  num_partial_colors_runs = " << num_partial_colors_runs << " / "
+                  << num_total_partial_colors << " ("
+                  << (num_partial_colors_runs * 100.0) / num_total_partial_colors << "%)"
+                  << std::endl;
 
         std::cout << "  partial colors: " << colors_bits / 8 << " bytes ("
                   << (colors_bits * 100.0) / num_bits() << "%)\n";
@@ -300,9 +402,15 @@ struct meta {
                   << ((m_meta_colors.bytes() * 8 + m_meta_colors_offsets.num_bits()) * 100.0) /
                          num_bits()
                   << "%)\n";
-        std::cout << "  other: " << essentials::vec_bytes(m_partition_endpoints) << " bytes ("
-                  << ((essentials::vec_bytes(m_partition_endpoints) * 8) * 100.0) / num_bits()
-                  << "%)\n";
+        const uint64_t other_bytes =
+            essentials::vec_bytes(m_partition_endpoints) + m_partition_ends.bytes();
+        std::cout << "  other: " << other_bytes << " bytes ("
+                  << ((other_bytes * 8) * 100.0) / num_bits() << "%)\n";
+        if (!m_partition_bitmaps.empty()) {
+            std::cout << "  partition bitmaps: " << m_partition_bitmaps.num_bits() / 8
+                      << " bytes (" << (m_partition_bitmaps.num_bits() * 100.0) / num_bits()
+                      << "%)\n";
+        }
         // std::cout << "  colors: "
         //           << ((m_meta_colors.bytes() * 8) * 100.0) /
         //                  (m_meta_colors.bytes() * 8 + m_meta_colors_offsets.num_bits())
@@ -360,6 +468,9 @@ struct meta {
         visitor.visit(m_meta_colors_offsets);
         visitor.visit(m_colors);
         visitor.visit(m_partition_endpoints);
+        visitor.visit(m_partition_ends);
+        visitor.visit(this->m_sizes);
+        visitor.visit(m_partition_bitmaps);
     }
 
 private:
@@ -368,6 +479,12 @@ private:
     sshash::ef_sequence<false> m_meta_colors_offsets;
     std::vector<ColorClasses> m_colors;
     std::vector<partition_endpoint> m_partition_endpoints;
+
+    /* a one at the last partial color set of each partition, so that the partition of a
+       partial color set is the rank of its position */
+    ranked_bit_vector m_partition_ends;
+
+    partition_bitmaps m_partition_bitmaps;  // optional
 };
 
 }  // namespace fulgor
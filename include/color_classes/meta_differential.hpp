@@ -2,7 +2,7 @@
 
 namespace fulgor {
 
-struct meta_differential {
+struct meta_differential : with_color_set_sizes<meta_differential> {
     static const bool meta_colored = true;
     static const bool differential_colored = true;
 
@@ -48,10 +48,10 @@ struct meta_differential {
             m_partition_sets_offsets.push_back(m_partition_sets.num_bits());
         }
 
-        void process_partition(differential& d) {
-            m_partial_colors.push_back(d);
+        void process_partition(differential&& d) {
             m_partition_endpoints.push_back({m_prev_docs, d.num_color_sets()});
             m_prev_docs += d.num_docs();
+            m_partial_colors.push_back(std::move(d));
         }
 
         void process_metacolors(uint64_t partition_set_id, vector<uint64_t>& partition_set,
@@ -112,9 +112,17 @@ struct meta_differential {
     };
 
     struct forward_iterator {
+        static constexpr uint32_t invalid_size = uint32_t(-1);
+
+        /* size, if known (e.g., stored), saves the first call to size();
+           partition_bitmap is the bitmap of the partitions of the color set, if stored */
         forward_iterator(meta_differential const* ptr, uint64_t begin_partition_set,
-                         uint64_t begin_rel)
-            : m_ptr(ptr), m_begin_partition_set(begin_partition_set), m_begin_rel(begin_rel) {
+                         uint64_t begin_rel, uint32_t size, uint64_t const* partition_bitmap)
+            : m_ptr(ptr)
+            , m_partition_bitmap(partition_bitmap)
+            , m_begin_partition_set(begin_partition_set)
+            , m_begin_rel(begin_rel)
+            , m_size(size) {
             rewind();
             assert(m_meta_color_list_size > 0);
         }
@@ -135,6 +143,7 @@ struct meta_differential {
             m_relative_colors_it = bit_vector_iterator(
                 (m_ptr->m_relative_colors).data(), (m_ptr->m_relative_colors).size(), m_begin_rel);
             m_meta_color_list_size = util::read_delta(m_partition_set_id);
+            m_partition_id_gaps.reset(m_meta_color_list_size);
         }
 
         uint64_t value() const { return m_curr_val; }
@@ -185,7 +194,7 @@ struct meta_differential {
         }
 
         void read_partition_id() {
-            uint64_t delta = util::read_delta(m_partition_set_id);
+            uint64_t delta = m_partition_id_gaps.next(m_partition_set_id);
             for (uint64_t i = 0; i < delta; i++) {
                 m_num_lists_before +=
                     m_ptr->m_partition_endpoints[m_curr_partition_id + i].num_lists;
@@ -214,7 +223,10 @@ struct meta_differential {
             update_curr_val();
         }
 
+        /* The first call takes the size of every partial color set; the size is then
+           cached in the iterator. */
         uint64_t size() const {
+            if (m_size != invalid_size) return m_size;
             uint64_t size = 0;
             auto partition_set_it =
                 bit_vector_iterator((m_ptr->m_partition_sets).data(),
@@ -223,18 +235,57 @@ struct meta_differential {
                                               (m_ptr->m_relative_colors).size(), m_begin_rel);
             uint64_t partition_id = 0;
             util::read_delta(partition_set_it);  // remove size
+            util::delta_buffer partition_id_gaps;
+            partition_id_gaps.reset(m_meta_color_list_size);
             for (uint64_t partial_color_id = 0; partial_color_id < m_meta_color_list_size;
                  partial_color_id++) {
-                partition_id += util::read_delta(partition_set_it);
+                partition_id += partition_id_gaps.next(partition_set_it);
                 uint8_t relative_color_size =
                     msb(m_ptr->m_partition_endpoints[partition_id].num_lists);
                 uint64_t relative_color = rel_it.take(relative_color_size);
                 size += m_ptr->m_partial_colors[partition_id].color_set(relative_color).size();
             }
-            return size;
+            m_size = size;
+            return m_size;
+        }
+
+        uint64_t decode(uint32_t* out) const { return decode_range(0, num_docs(), out); }
+
+        /* only the partial color sets of the partitions overlapping [lo, hi) are decoded */
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= num_docs());
+            auto partition_set_it =
+                bit_vector_iterator((m_ptr->m_partition_sets).data(),
+                                    (m_ptr->m_partition_sets).size(), m_begin_partition_set);
+            auto rel_it = bit_vector_iterator((m_ptr->m_relative_colors).data(),
+                                              (m_ptr->m_relative_colors).size(), m_begin_rel);
+            util::read_delta(partition_set_it);  // remove size
+            util::delta_buffer partition_id_gaps;
+            partition_id_gaps.reset(m_meta_color_list_size);
+            uint64_t partition_id = 0;
+            uint64_t n = 0;
+            for (uint64_t partial_color_id = 0; partial_color_id < m_meta_color_list_size;
+                 partial_color_id++) {
+                partition_id += partition_id_gaps.next(partition_set_it);
+                auto const& endpoint = m_ptr->m_partition_endpoints[partition_id];
+                uint8_t relative_color_size = msb(endpoint.num_lists);
+                uint64_t relative_color = rel_it.take(relative_color_size);
+                auto it = m_ptr->m_partial_colors[partition_id].color_set(relative_color);
+                const uint64_t lower_bound = endpoint.docid_lower_bound;
+                const uint64_t upper_bound = lower_bound + it.num_docs();
+                if (upper_bound <= lo) continue;
+                if (lower_bound >= hi) break;
+                const uint64_t partial_lo = lo > lower_bound ? lo - lower_bound : 0;
+                const uint64_t partial_hi = (hi < upper_bound ? hi : upper_bound) - lower_bound;
+                const uint64_t k = it.decode_range(partial_lo, partial_hi, out + n);
+                for (uint64_t j = n; j != n + k; ++j) out[j] += lower_bound;
+                n += k;
+            }
+            return n;
         }
 
         uint32_t partition_id() const { return m_curr_partition_id; }
+        uint32_t partition_size() const { return m_curr_partition_size; }
         uint32_t partition_upper_bound() const {
             return m_docid_lower_bound + m_curr_partition_it.num_docs();
         }
@@ -243,10 +294,15 @@ struct meta_differential {
         uint32_t num_partitions() const { return m_ptr->num_partitions(); }
         uint64_t meta_color_list_size() const { return m_meta_color_list_size; }
 
+        /* nullptr if the partition bitmaps are not stored */
+        uint64_t const* partition_bitmap() const { return m_partition_bitmap; }
+
     private:
         meta_differential const* m_ptr;
+        uint64_t const* m_partition_bitmap;
         differential::iterator_type m_curr_partition_it;
         bit_vector_iterator m_partition_set_id, m_relative_colors_it;
+        util::delta_buffer m_partition_id_gaps;
         uint64_t m_meta_color_list_size;
         uint64_t m_begin_partition_set, m_begin_rel;
         uint64_t m_pos_in_meta_color, m_pos_in_partial_color;
@@ -255,6 +311,7 @@ struct meta_differential {
         uint64_t m_curr_val;
         uint64_t m_docid_lower_bound;
         uint64_t m_num_lists_before;
+        mutable uint32_t m_size;
 
         void update_curr_val() { m_curr_val = m_docid_lower_bound + *m_curr_partition_it; }
 
@@ -268,9 +325,15 @@ struct meta_differential {
         uint64_t begin_partition_set =
             m_partition_sets_offsets.access(m_partition_sets_partitions.rank(color_set_id));
         uint64_t begin_rel = m_relative_colors_offsets.access(color_set_id);
-        return forward_iterator(this, begin_partition_set, begin_rel);
+        uint32_t size = m_sizes.empty() ? forward_iterator::invalid_size : m_sizes[color_set_id];
+        return forward_iterator(this, begin_partition_set, begin_rel, size,
+                                m_partition_bitmaps.bitmap(color_set_id));
     }
 
+    /* store the partitions of each color set as a bitmap (see partition_bitmaps) */
+    void build_partition_bitmaps() { m_partition_bitmaps.build(*this); }
+    partition_bitmaps const& get_partition_bitmaps() const { return m_partition_bitmaps; }
+
     uint32_t num_docs() const { return m_num_docs; }
 
     /* num. meta color lists */
@@ -289,7 +352,8 @@ struct meta_differential {
                essentials::vec_bytes(m_partition_endpoints) * 8 + partial_colors_size +
                essentials::vec_bytes(m_relative_colors) * 8 +
                essentials::vec_bytes(m_partition_sets) * 8 +
-               m_partition_sets_partitions.bytes() * 8;
+               m_partition_sets_partitions.bytes() * 8 + m_sizes.num_bits() +
+               m_partition_bitmaps.num_bits();
     }
 
     void print_stats() const {
@@ -312,6 +376,11 @@ struct meta_differential {
         std::cout << "  other: " << essentials::vec_bytes(m_partition_endpoints) << " bytes ("
                   << ((essentials::vec_bytes(m_partition_endpoints) * 8) * 100.0) / num_bits()
                   << "%)\n";
+        if (!m_partition_bitmaps.empty()) {
+            std::cout << "  partition bitmaps: " << m_partition_bitmaps.num_bits() / 8
+                      << " bytes (" << (m_partition_bitmaps.num_bits() * 100.0) / num_bits()
+                      << "%)\n";
+        }
     }
 
     // void dump(std::ofstream& os) const {
@@ -367,6 +436,8 @@ struct meta_differential {
         visitor.visit(m_relative_colors);
         visitor.visit(m_partition_sets);
         visitor.visit(m_partition_sets_partitions);
+        visitor.visit(m_sizes);
+        visitor.visit(m_partition_bitmaps);
     }
 
 private:
@@ -378,6 +449,7 @@ private:
     std::vector<uint64_t> m_relative_colors;
     std::vector<uint64_t> m_partition_sets;
     ranked_bit_vector m_partition_sets_partitions;
+    partition_bitmaps m_partition_bitmaps;  // optional
 };
 
 }  // namespace fulgor
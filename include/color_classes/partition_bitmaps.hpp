@@ -0,0 +1,63 @@
+#pragma once
+
+#include "include/util.hpp"
+
+namespace fulgor {
+
+/*
+    The partitions of each meta color set, stored as a bitmap of num_partitions bits (in
+    whole words) per color set, so that the partitions shared by some color sets are their
+    word-parallel AND. This is meant for indexes with few partitions (at most
+    constants::max_num_partitions_for_bitmaps). It is optional: empty unless built.
+*/
+struct partition_bitmaps {
+    partition_bitmaps() : m_num_words_per_bitmap(0) {}
+
+    template <typename ColorClasses>
+    void build(ColorClasses const& ccs) {
+        static_assert(ColorClasses::meta_colored);
+        const uint64_t num_partitions = ccs.num_partitions();
+        if (num_partitions > constants::max_num_partitions_for_bitmaps) {
+            throw std::runtime_error("too many partitions for partition bitmaps: " +
+                                     std::to_string(num_partitions) + " > " +
+                                     std::to_string(constants::max_num_partitions_for_bitmaps));
+        }
+        const uint64_t num_words_per_bitmap = (num_partitions + 63) / 64;
+        std::vector<uint64_t> bitmaps(ccs.num_color_sets() * num_words_per_bitmap, 0);
+        for (uint64_t color_set_id = 0; color_set_id != ccs.num_color_sets(); ++color_set_id) {
+            uint64_t* bitmap = bitmaps.data() + color_set_id * num_words_per_bitmap;
+            for (auto it = ccs.color_set(color_set_id); it.partition_id() < num_partitions;
+                 it.next_partition_id()) {
+                bitmap[it.partition_id() / 64] |= uint64_t(1) << (it.partition_id() % 64);
+            }
+        }
+        m_num_words_per_bitmap = num_words_per_bitmap;
+        m_bitmaps.swap(bitmaps);
+    }
+
+    bool empty() const { return m_bitmaps.empty(); }
+    uint64_t num_words_per_bitmap() const { return m_num_words_per_bitmap; }
+
+    /* the bitmap of a color set, or nullptr if the bitmaps are not stored */
+    uint64_t const* bitmap(uint64_t color_set_id) const {
+        if (empty()) return nullptr;
+        assert((color_set_id + 1) * m_num_words_per_bitmap <= m_bitmaps.size());
+        return m_bitmaps.data() + color_set_id * m_num_words_per_bitmap;
+    }
+
+    uint64_t num_bits() const {
+        return sizeof(m_num_words_per_bitmap) * 8 + essentials::vec_bytes(m_bitmaps) * 8;
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_num_words_per_bitmap);
+        visitor.visit(m_bitmaps);
+    }
+
+private:
+    uint64_t m_num_words_per_bitmap;
+    std::vector<uint64_t> m_bitmaps;
+};
+
+}  // namespace fulgor
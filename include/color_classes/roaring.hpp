@@ -0,0 +1,493 @@
+#pragma once
+
+#include <cstring>
+
+namespace fulgor {
+
+/*
+    Roaring-style color sets. The doc ids are split into chunks of 2^16 docs,
+    and the docs of a color set falling into each non-empty chunk form a
+    container, coded as a sorted array of 16-bit values, as a bitmap of 2^16
+    bits, or as a sorted list of runs, whichever takes less space.
+    Differently from hybrid, where a single coding is chosen for the whole
+    list, the coding adapts to lists that are dense in some ranges of doc ids
+    and sparse elsewhere (e.g., after the references have been permuted).
+
+    A color set is a header word (size, number of containers) followed by its
+    containers, in increasing chunk order. A container is a header word
+    (chunk, type, cardinality, number of runs) followed by its payload,
+    padded to a multiple of 64 bits.
+*/
+struct roaring : with_color_set_sizes<roaring> {
+    static const bool meta_colored = false;
+    static const bool differential_colored = false;
+
+    static constexpr uint64_t chunk_bits = 16;
+    static constexpr uint64_t chunk_size = uint64_t(1) << chunk_bits;
+    static constexpr uint64_t bitmap_words = chunk_size / 64;
+    static constexpr uint64_t max_array_size = 4096;  // an array of 4096 values takes 8 KiB
+
+    enum container_type { array_container = 0, bitmap_container = 1, run_container = 2 };
+
+    struct container {
+        uint64_t chunk;  // the container stores the docs in [chunk * 2^16, (chunk + 1) * 2^16)
+        int type;
+        uint32_t cardinality;
+        uint32_t num_runs;
+        uint64_t const* data;  // the payload
+
+        void parse(uint64_t const* header) {
+            const uint64_t w = *header;
+            chunk = w & (chunk_size - 1);
+            type = (w >> 16) & 3;
+            cardinality = (w >> 18) & ((uint64_t(1) << 17) - 1);
+            num_runs = w >> 35;
+            data = header + 1;
+        }
+
+        static uint64_t header(uint64_t chunk, uint64_t type, uint64_t cardinality,
+                               uint64_t num_runs) {
+            assert(chunk < chunk_size and cardinality <= chunk_size and num_runs <= chunk_size);
+            return chunk | (type << 16) | (cardinality << 18) | (num_runs << 35);
+        }
+
+        uint64_t base() const { return chunk << chunk_bits; }
+
+        /* the sorted values of an array container */
+        uint16_t const* values() const { return reinterpret_cast<uint16_t const*>(data); }
+
+        /* the runs of a run container, as pairs (start, length - 1) */
+        uint32_t run_start(uint64_t i) const { return values()[2 * i]; }
+        uint32_t run_last(uint64_t i) const { return values()[2 * i] + values()[2 * i + 1]; }
+
+        uint64_t num_words() const {
+            if (type == array_container) return (cardinality + 3) / 4;
+            if (type == bitmap_container) return bitmap_words;
+            assert(type == run_container);
+            return (num_runs + 1) / 2;
+        }
+
+        /* whether the container has the doc base() + low */
+        bool contains(uint64_t low) const {
+            assert(low < chunk_size);
+            if (type == bitmap_container) return (data[low / 64] >> (low % 64)) & 1;
+            if (type == array_container) {
+                return std::binary_search(values(), values() + cardinality, low);
+            }
+            assert(type == run_container);
+            uint64_t lo = 0, hi = num_runs;  // the first run with start > low
+            while (lo < hi) {
+                uint64_t mid = (lo + hi) / 2;
+                if (run_start(mid) <= low) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo != 0 and run_last(lo - 1) >= low;
+        }
+
+        /* Decode the docs base() + [lo, hi) of the container into out,
+           and return their number. */
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= chunk_size);
+            const uint64_t b = base();
+            uint64_t n = 0;
+            if (type == array_container) {
+                uint16_t const* begin = std::lower_bound(values(), values() + cardinality, lo);
+                for (uint16_t const* v = begin; v != values() + cardinality and *v < hi; ++v) {
+                    out[n++] = b + *v;
+                }
+            } else if (type == bitmap_container) {
+                for (uint64_t i = lo / 64; i < (hi + 63) / 64; ++i) {
+                    uint64_t word = data[i];
+                    if (i == lo / 64) word &= ~uint64_t(0) << (lo % 64);
+                    if (i == hi / 64) word &= (uint64_t(1) << (hi % 64)) - 1;
+                    while (word) {
+                        out[n++] = b + i * 64 + util::lsbll(word);
+                        word &= word - 1;
+                    }
+                }
+            } else {
+                assert(type == run_container);
+                for (uint64_t i = 0; i != num_runs and run_start(i) < hi; ++i) {
+                    const uint64_t first = std::max<uint64_t>(run_start(i), lo);
+                    const uint64_t end = std::min<uint64_t>(run_last(i) + 1, hi);
+                    for (uint64_t x = first; x < end; ++x) out[n++] = b + x;
+                }
+            }
+            return n;
+        }
+    };
+
+    /* the position of the first bit set in the bitmap container at or after from,
+       or chunk_size if there is none */
+    static uint64_t next_set_bit(uint64_t const* words, uint64_t from) {
+        if (from >= chunk_size) return chunk_size;
+        uint64_t i = from / 64;
+        uint64_t word = words[i] & (~uint64_t(0) << (from % 64));
+        while (!word) {
+            if (++i == bitmap_words) return chunk_size;
+            word = words[i];
+        }
+        return i * 64 + util::lsbll(word);
+    }
+
+    struct builder {
+        builder() {}
+        builder(uint64_t num_docs) { init(num_docs); }
+
+        void init(uint64_t num_docs) {
+            m_num_docs = num_docs;
+            std::cout << "m_num_docs: " << m_num_docs << std::endl;
+            m_offsets.push_back(0);
+            m_num_lists = 0;
+            m_num_total_integers = 0;
+            std::fill(m_num_containers, m_num_containers + 3, 0);
+        }
+
+        void process(uint32_t const* colors, uint64_t list_size) {
+            const uint64_t header = m_colors.size();
+            m_colors.push_back(0);
+            uint64_t num_containers = 0;
+            for (uint64_t i = 0; i != list_size;) {
+                const uint64_t chunk = colors[i] >> chunk_bits;
+                uint64_t j = i;
+                uint64_t num_runs = 0;
+                for (; j != list_size and (colors[j] >> chunk_bits) == chunk; ++j) {
+                    assert(j == i or colors[j] > colors[j - 1]);
+                    if (j == i or colors[j] != colors[j - 1] + 1) num_runs += 1;
+                }
+                append_container(chunk, colors + i, j - i, num_runs);
+                num_containers += 1;
+                i = j;
+            }
+            m_colors[header] = list_size | (num_containers << 32);
+            m_offsets.push_back(m_colors.size());
+            m_num_total_integers += list_size;
+            m_num_lists += 1;
+            if (m_num_lists % 500000 == 0) {
+                std::cout << "  processed " << m_num_lists << " lists" << std::endl;
+            }
+        }
+
+        void build(roaring& r) {
+            r.m_num_docs = m_num_docs;
+
+            std::cout << "processed " << m_num_lists << " lists" << std::endl;
+            std::cout << "m_num_total_integers " << m_num_total_integers << std::endl;
+            std::cout << "  array containers: " << m_num_containers[array_container] << '\n'
+                      << "  bitmap containers: " << m_num_containers[bitmap_container] << '\n'
+                      << "  run containers: " << m_num_containers[run_container] << std::endl;
+            assert(m_num_lists == m_offsets.size() - 1);
+
+            r.m_offsets.encode(m_offsets.begin(), m_offsets.size(), m_offsets.back());
+            r.m_colors.swap(m_colors);
+
+            std::cout << "  total bits for ints = " << r.m_colors.size() * 64 << std::endl;
+            std::cout << "  total bits per offsets = " << r.m_offsets.num_bits() << std::endl;
+            std::cout << "  offsets: "
+                      << static_cast<double>(r.m_offsets.num_bits()) / m_num_total_integers
+                      << " bits/int" << std::endl;
+            std::cout << "  lists: "
+                      << static_cast<double>(r.m_colors.size() * 64) / m_num_total_integers
+                      << " bits/int" << std::endl;
+        }
+
+    private:
+        uint32_t m_num_docs;
+        uint64_t m_num_lists;
+        uint64_t m_num_total_integers;
+        uint64_t m_num_containers[3];
+
+        std::vector<uint64_t> m_colors;
+        std::vector<uint64_t> m_offsets;
+        std::vector<uint16_t> m_values;
+
+        /* code the container with the fewest bytes: 2 per value for an array,
+           4 per run for a run container, and 2^16 / 8 for a bitmap */
+        void append_container(uint64_t chunk, uint32_t const* colors, uint64_t cardinality,
+                              uint64_t num_runs) {
+            int type = cardinality <= max_array_size ? array_container : bitmap_container;
+            if (4 * num_runs < std::min<uint64_t>(2 * cardinality, chunk_size / 8)) {
+                type = run_container;
+            }
+            m_num_containers[type] += 1;
+            m_colors.push_back(container::header(chunk, type, cardinality, num_runs));
+
+            const uint64_t mask = chunk_size - 1;
+            if (type == bitmap_container) {
+                const uint64_t begin = m_colors.size();
+                m_colors.resize(begin + bitmap_words, 0);
+                for (uint64_t i = 0; i != cardinality; ++i) {
+                    const uint64_t low = colors[i] & mask;
+                    m_colors[begin + low / 64] |= uint64_t(1) << (low % 64);
+                }
+                return;
+            }
+
+            m_values.clear();
+            if (type == array_container) {
+                for (uint64_t i = 0; i != cardinality; ++i) m_values.push_back(colors[i] & mask);
+            } else {
+                for (uint64_t i = 0; i != cardinality;) {
+                    uint64_t j = i + 1;
+                    while (j != cardinality and colors[j] == colors[j - 1] + 1) ++j;
+                    m_values.push_back(colors[i] & mask);
+                    m_values.push_back(j - i - 1);
+                    i = j;
+                }
+                assert(m_values.size() == 2 * num_runs);
+            }
+            const uint64_t begin = m_colors.size();
+            m_colors.resize(begin + (m_values.size() + 3) / 4, 0);
+            std::memcpy(m_colors.data() + begin, m_values.data(),
+                        m_values.size() * sizeof(uint16_t));
+        }
+    };
+
+    /* iterates over the containers of a color set, in increasing chunk order */
+    struct container_iterator {
+        container_iterator() {}
+
+        container_iterator(uint64_t const* data, uint32_t num_containers)
+            : m_data(data), m_num_containers(num_containers), m_pos(0) {
+            if (m_num_containers != 0) m_curr.parse(m_data);
+        }
+
+        bool has_next() const { return m_pos < m_num_containers; }
+        container const& operator*() const { return m_curr; }
+        container const* operator->() const { return &m_curr; }
+        uint32_t num_containers() const { return m_num_containers; }
+
+        void next() {
+            assert(has_next());
+            m_data += 1 + m_curr.num_words();
+            m_pos += 1;
+            if (has_next()) m_curr.parse(m_data);
+        }
+
+        /* move to the first container whose chunk is >= chunk */
+        void next_geq(uint64_t chunk) {
+            while (has_next() and m_curr.chunk < chunk) next();
+        }
+
+    private:
+        uint64_t const* m_data;
+        uint32_t m_num_containers;
+        uint32_t m_pos;
+        container m_curr;
+    };
+
+    struct forward_iterator {
+        forward_iterator() {}
+
+        forward_iterator(roaring const* ptr, uint64_t begin)
+            : m_ptr(ptr), m_begin(begin), m_num_docs(ptr->m_num_docs) {
+            rewind();
+        }
+
+        void rewind() {
+            const uint64_t header = m_ptr->m_colors[m_begin];
+            m_size = header & 0xffffffff;
+            m_containers = containers();
+            first_in_container();
+        }
+
+        uint64_t value() const { return m_curr_val; }
+        uint64_t operator*() const { return value(); }
+
+        void next() {
+            if (m_curr_val >= m_num_docs) return;
+            auto const& c = *m_containers;
+            const uint64_t base = c.base();
+            if (c.type == array_container) {
+                if (++m_pos < c.cardinality) {
+                    m_curr_val = base + c.values()[m_pos];
+                    return;
+                }
+            } else if (c.type == bitmap_container) {
+                const uint64_t low = next_set_bit(c.data, m_curr_val - base + 1);
+                if (low < chunk_size) {
+                    m_curr_val = base + low;
+                    return;
+                }
+            } else {
+                assert(c.type == run_container);
+                if (m_curr_val < base + c.run_last(m_pos)) {
+                    ++m_curr_val;
+                    return;
+                }
+                if (++m_pos < c.num_runs) {
+                    m_curr_val = base + c.run_start(m_pos);
+                    return;
+                }
+            }
+            m_containers.next();
+            first_in_container();
+        }
+
+        void operator++() { next(); }
+
+        /* update the state of the iterator to the element
+           which is greater-than or equal-to lower_bound */
+        void next_geq(const uint64_t lower_bound) {
+            assert(lower_bound <= num_docs());
+            if (value() >= lower_bound) return;
+            const uint64_t chunk = lower_bound >> chunk_bits;
+            if (m_containers->chunk < chunk) {
+                m_containers.next_geq(chunk);
+                first_in_container();
+                if (value() >= lower_bound) return;
+            }
+
+            /* the current element is in the chunk of lower_bound and is smaller */
+            auto const& c = *m_containers;
+            const uint64_t base = c.base();
+            const uint64_t low = lower_bound - base;
+            if (c.type == array_container) {
+                uint16_t const* values = c.values();
+                m_pos = std::lower_bound(values + m_pos, values + c.cardinality, low) - values;
+                if (m_pos < c.cardinality) {
+                    m_curr_val = base + values[m_pos];
+                    return;
+                }
+            } else if (c.type == bitmap_container) {
+                const uint64_t l = next_set_bit(c.data, low);
+                if (l < chunk_size) {
+                    m_curr_val = base + l;
+                    return;
+                }
+            } else {
+                assert(c.type == run_container);
+                while (m_pos < c.num_runs and c.run_last(m_pos) < low) ++m_pos;
+                if (m_pos < c.num_runs) {
+                    m_curr_val = base + std::max<uint64_t>(low, c.run_start(m_pos));
+                    return;
+                }
+            }
+            m_containers.next();
+            first_in_container();
+            assert(value() >= lower_bound);
+        }
+
+        uint64_t decode(uint32_t* out) const { return decode_range(0, num_docs(), out); }
+
+        uint64_t decode_range(uint64_t lo, uint64_t hi, uint32_t* out) const {
+            assert(lo <= hi and hi <= num_docs());
+            uint64_t n = 0;
+            if (lo == hi) return n;
+            auto it = containers();
+            for (it.next_geq(lo >> chunk_bits); it.has_next() and it->base() < hi; it.next()) {
+                const uint64_t base = it->base();
+                const uint64_t partial_lo = lo > base ? lo - base : 0;
+                const uint64_t partial_hi = std::min(hi - base, chunk_size);
+                n += it->decode_range(partial_lo, partial_hi, out + n);
+            }
+            return n;
+        }
+
+        /* the containers of the color set, from the first one */
+        container_iterator containers() const {
+            uint64_t const* data = m_ptr->m_colors.data() + m_begin;
+            return container_iterator(data + 1, data[0] >> 32);
+        }
+
+        uint32_t size() const { return m_size; }
+        uint32_t num_docs() const { return m_num_docs; }
+
+    private:
+        roaring const* m_ptr;
+        uint64_t m_begin;
+        uint32_t m_num_docs;
+        uint32_t m_size;
+
+        container_iterator m_containers;
+        uint32_t m_pos;  // position in the array, or run, of the current container
+        uint64_t m_curr_val;
+
+        void first_in_container() {
+            m_pos = 0;
+            if (!m_containers.has_next()) {  // saturate
+                m_curr_val = m_num_docs;
+                return;
+            }
+            auto const& c = *m_containers;
+            if (c.type == array_container) {
+                m_curr_val = c.base() + c.values()[0];
+            } else if (c.type == bitmap_container) {
+                m_curr_val = c.base() + next_set_bit(c.data, 0);
+            } else {
+                assert(c.type == run_container);
+                m_curr_val = c.base() + c.run_start(0);
+            }
+        }
+    };
+
+    typedef forward_iterator iterator_type;
+
+    forward_iterator color_set(uint64_t color_set_id) const {
+        assert(color_set_id < num_color_sets());
+        uint64_t begin = m_offsets.access(color_set_id);
+        return forward_iterator(this, begin);
+    }
+
+    uint32_t num_docs() const { return m_num_docs; }
+    uint64_t num_color_sets() const { return m_offsets.size() - 1; }
+
+    uint64_t num_bits() const {
+        return sizeof(m_num_docs) * 8 + m_offsets.num_bits() + essentials::vec_bytes(m_colors) * 8 +
+               m_sizes.num_bits();
+    }
+
+    void print_stats() const {
+        static const char* names[] = {"array", "bitmap", "run"};
+        uint64_t num_containers[3] = {0, 0, 0};
+        uint64_t num_ints[3] = {0, 0, 0};
+        uint64_t container_bits[3] = {0, 0, 0};  // including the container headers
+        uint64_t num_total_integers = 0;
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets(); ++color_set_id) {
+            auto it = color_set(color_set_id);
+            num_total_integers += it.size();
+            for (auto c = it.containers(); c.has_next(); c.next()) {
+                num_containers[c->type] += 1;
+                num_ints[c->type] += c->cardinality;
+                container_bits[c->type] += (1 + c->num_words()) * 64;
+            }
+        }
+
+        std::cout << "CCs SPACE BREAKDOWN:\n";
+        const uint64_t total_bits = num_bits();
+        for (int type = 0; type != 3; ++type) {
+            if (num_containers[type] == 0) continue;
+            std::cout << "num. " << names[type] << " containers: " << num_containers[type]
+                      << " -- integers: " << num_ints[type] << " ("
+                      << (num_ints[type] * 100.0) / num_total_integers << "%) -- bits/int: "
+                      << static_cast<double>(container_bits[type]) / num_ints[type] << " -- "
+                      << static_cast<double>(container_bits[type]) / total_bits * 100.0
+                      << "\% of total space" << '\n';
+        }
+        std::cout << "  colors: "
+                  << static_cast<double>(essentials::vec_bytes(m_colors) * 8) / num_total_integers
+                  << " bits/int" << std::endl;
+        std::cout << "  offsets: "
+                  << static_cast<double>(sizeof(m_num_docs) * 8 + m_offsets.num_bits()) /
+                         num_total_integers
+                  << " bits/int" << std::endl;
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_num_docs);
+        visitor.visit(m_offsets);
+        visitor.visit(m_colors);
+        visitor.visit(m_sizes);
+    }
+
+private:
+    uint32_t m_num_docs;
+    sshash::ef_sequence<false> m_offsets;
+    std::vector<uint64_t> m_colors;
+};
+
+}  // namespace fulgor
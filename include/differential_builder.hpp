@@ -1,11 +1,17 @@
 #pragma once
 
+#include <numeric>
+#include <filesystem>
+
 #include "index.hpp"
+#include "external/sshash/include/query/streaming_query_canonical_parsing.hpp"
+#include "external/FQFeeder/include/FastxParser.hpp"
 
 namespace fulgor {
 struct differential_permuter {
-    differential_permuter(build_configuration const& build_config)
-        : m_build_config(build_config), m_num_partitions(0) {}
+    /* if not verbose, the permuter prints nothing (e.g., when permuting concurrently) */
+    differential_permuter(build_configuration const& build_config, bool verbose = true)
+        : m_build_config(build_config), m_verbose(verbose), m_num_partitions(0) {}
 
     template <typename Index>
     void permute(Index const& index) {
@@ -14,7 +20,7 @@ struct differential_permuter {
         const uint64_t num_slices = slices.size() - 1;
 
         {
-            essentials::logger("step 2. build sketches");
+            if (m_verbose) essentials::logger("step 2. build sketches");
 
             constexpr uint64_t p = 10;
             for (uint64_t i = 0; i < num_slices; i++) {
@@ -28,17 +34,19 @@ struct differential_permuter {
                     m_build_config.tmp_dirname + "/sketches" + std::to_string(i) + ".bin",
                     slices[i], slices[i + 1]);
                 timer.stop();
-                std::cout << "** building sketches took " << timer.elapsed() << " seconds / "
-                          << timer.elapsed() / 60 << " minutes" << std::endl;
+                if (m_verbose) {
+                    std::cout << "** building sketches took " << timer.elapsed() << " seconds / "
+                              << timer.elapsed() / 60 << " minutes" << std::endl;
+                }
                 timer.reset();
             }
         }
 
         {
-            essentials::logger("step 3. clustering sketches");
+            if (m_verbose) essentials::logger("step 3. clustering sketches");
 
             std::vector<uint64_t> color_ids;
-            std::vector<kmeans::cluster_data> clustering_data(num_slices);
+            std::vector<fulgor::clustering_data> clustering_data(num_slices);
             std::vector<uint64_t> num_points(num_slices);
 
             for (uint64_t slice_id = 0; slice_id < num_slices; slice_id++) {
@@ -104,32 +112,45 @@ struct differential_permuter {
                 m_color_sets_ids[permutation[i]] = color_ids[i];
             }
 
-            std::cout << "Computed " << m_num_partitions << " partitions\n";
-
-            m_permutation.resize(num_color_sets);
-            m_references.resize(m_num_partitions);
-            std::vector<uint32_t> distribution(m_num_docs, 0);
-            uint64_t cluster_size = 0;
-            for (uint64_t color_id = 0, cluster_id = 0; color_id != num_color_sets + 1;
-                 ++color_id, ++cluster_size) {
-                if (color_id == m_partition_size[cluster_id + 1]) {
-                    auto& reference = m_references[cluster_id];
-                    for (uint32_t i = 0; i != m_num_docs; ++i) {
-                        if (distribution[i] >= ceil(1. * cluster_size / 2.))
-                            reference.emplace_back(i);
+            if (m_verbose) std::cout << "Computed " << m_num_partitions << " partitions\n";
+
+            if (m_query_weights.empty() and m_build_config.max_representatives <= 1) {
+                /* one representative per cluster, by majority vote */
+                m_permutation.resize(num_color_sets);
+                m_references.resize(m_num_partitions);
+                std::vector<uint32_t> distribution(m_num_docs, 0);
+                std::vector<uint32_t> list(m_num_docs);
+                uint64_t cluster_size = 0;
+                for (uint64_t color_id = 0, cluster_id = 0; color_id != num_color_sets + 1;
+                     ++color_id, ++cluster_size) {
+                    if (color_id == m_partition_size[cluster_id + 1]) {
+                        auto& reference = m_references[cluster_id];
+                        for (uint32_t i = 0; i != m_num_docs; ++i) {
+                            if (distribution[i] >= ceil(1. * cluster_size / 2.))
+                                reference.emplace_back(i);
+                        }
+                        fill(distribution.begin(), distribution.end(), 0);
+                        cluster_id++;
+                        cluster_size = 0;
+                        if (color_id == num_color_sets) break;
                     }
-                    fill(distribution.begin(), distribution.end(), 0);
-                    cluster_id++;
-                    cluster_size = 0;
-                    if (color_id == num_color_sets) break;
+                    const uint64_t size =
+                        index.color_set(m_color_sets_ids[color_id]).decode(list.data());
+                    for (uint64_t i = 0; i != size; ++i) distribution[list[i]]++;
+                    m_permutation[color_id] = {cluster_id, m_color_sets_ids[color_id]};
                 }
-                auto it = index.color_set(m_color_sets_ids[color_id]);
-                for (uint32_t i = 0; i != it.size(); ++i, ++it) { distribution[*it]++; }
-                m_permutation[color_id] = {cluster_id, m_color_sets_ids[color_id]};
+            } else {
+                optimize_representatives(index);
             }
         }
     }
 
+    /* The number of queries that hit each color set (by color set id), to weigh the
+       color sets when choosing the representatives. */
+    void set_query_weights(std::vector<uint64_t> query_weights) {
+        m_query_weights.swap(query_weights);
+    }
+
     uint64_t num_partitions() const { return m_num_partitions; }
     uint64_t num_docs() const { return m_num_docs; }
     std::vector<std::pair<uint32_t, uint32_t>> permutation() const { return m_permutation; }
@@ -138,63 +159,281 @@ struct differential_permuter {
 
 private:
     build_configuration m_build_config;
+    bool m_verbose;
     uint64_t m_num_partitions, m_num_docs;
     std::vector<std::pair<uint32_t, uint32_t>> m_permutation;
     std::vector<std::vector<uint32_t>> m_references;
     std::vector<uint32_t> m_partition_size;
     std::vector<uint32_t> m_color_sets_ids;
+    std::vector<uint64_t> m_query_weights;
+
+    struct group {
+        std::vector<uint32_t> members;  // positions in the cluster
+        std::vector<uint32_t> representative;
+        double cost;
+    };
+
+    /* the number of ints in the symmetric difference of two sorted lists */
+    static uint64_t num_differences(std::vector<uint32_t> const& x,
+                                    std::vector<uint32_t> const& y) {
+        uint64_t i = 0, j = 0, common = 0;
+        while (i != x.size() and j != y.size()) {
+            if (x[i] == y[j]) {
+                ++common;
+                ++i;
+                ++j;
+            } else if (x[i] < y[j]) {
+                ++i;
+            } else {
+                ++j;
+            }
+        }
+        return x.size() + y.size() - 2 * common;
+    }
 
-    uint64_t cluster(std::string filename, kmeans::cluster_data& clustering_data,
-                     std::vector<uint64_t>& color_ids) {
-        essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
-        timer.start();
+    /*
+        Choose the representatives of each cluster so as to minimize
 
-        std::ifstream in(m_build_config.tmp_dirname + filename, std::ios::binary);
-        if (!in.is_open()) throw std::runtime_error("error in opening file");
+            |r| + sum of w(c) * |c xor r| over the color sets c of the cluster,
 
-        std::vector<kmeans::point> points;
-        std::vector<uint64_t> group_color_ids;
-        uint64_t num_bytes_per_point = 0;
-        uint64_t num_points = 0;
-        uint64_t num_docs = 0;
-        in.read(reinterpret_cast<char*>(&num_bytes_per_point), sizeof(uint64_t));
-        in.read(reinterpret_cast<char*>(&num_docs), sizeof(uint64_t));
-        in.read(reinterpret_cast<char*>(&num_points), sizeof(uint64_t));
-        points.resize(num_points, kmeans::point(num_bytes_per_point));
-        group_color_ids.resize(num_points);
-        for (uint64_t i = 0; i != num_points; ++i) {
-            in.read(reinterpret_cast<char*>(&group_color_ids[i]), sizeof(uint64_t));
+        i.e., the ints of the representative plus those of the differential lists,
+        each weighted by w(c) = (1 + q(c) / mean(q)) / 2, where q(c) is the query
+        weight of c: a doc belongs to the representative iff twice its weight in the
+        cluster exceeds the weight of the cluster plus one, the int that it adds to
+        the representative (a weighted majority vote).
+
+        With max_representatives > 1, the most costly cluster is also split in two
+        (by 2-means under the Hamming distance) as long as the split lowers the cost,
+        up to max_representatives representatives per cluster. Each representative
+        becomes a partition of its own, so that the layout of the differential colors
+        does not change. The color sets of a cluster are decoded in memory.
+    */
+    template <typename Index>
+    void optimize_representatives(Index const& index) {
+        const uint64_t num_color_sets = index.num_color_sets();
+        const uint64_t max_representatives =
+            std::max<uint64_t>(1, m_build_config.max_representatives);
+
+        double mean_query_weight = 1;
+        if (!m_query_weights.empty()) {
+            assert(m_query_weights.size() == num_color_sets);
+            const uint64_t total =
+                std::accumulate(m_query_weights.begin(), m_query_weights.end(), uint64_t(0));
+            if (total > 0) mean_query_weight = static_cast<double>(total) / num_color_sets;
         }
-        for (auto& point : points) {
-            in.read(reinterpret_cast<char*>(point.data()), num_bytes_per_point);
+        auto query_weight = [&](uint64_t color_id) -> double {
+            return m_query_weights.empty() ? 1.0 : m_query_weights[color_id];
+        };
+
+        std::vector<std::vector<uint32_t>> sets;  // of the current cluster
+        std::vector<double> weights;              // of the current cluster
+        std::vector<double> doc_weights(m_num_docs, 0);
+        std::vector<uint32_t> docs;
+
+        /* the weighted majority vote (or the plain one, with unit weights) */
+        auto vote = [&](std::vector<uint32_t> const& members, bool unit_weights) {
+            double total = 0;
+            docs.clear();
+            for (auto m : members) {
+                const double w = unit_weights ? 1.0 : weights[m];
+                total += w;
+                for (auto doc : sets[m]) {
+                    if (doc_weights[doc] == 0) docs.push_back(doc);
+                    doc_weights[doc] += w;
+                }
+            }
+            std::vector<uint32_t> representative;
+            for (auto doc : docs) {
+                if (unit_weights ? doc_weights[doc] >= std::ceil(total / 2)
+                                 : 2 * doc_weights[doc] > total + 1) {
+                    representative.push_back(doc);
+                }
+                doc_weights[doc] = 0;
+            }
+            std::sort(representative.begin(), representative.end());
+            return representative;
+        };
+        auto cost = [&](std::vector<uint32_t> const& members,
+                        std::vector<uint32_t> const& representative) {
+            double c = representative.size();
+            for (auto m : members) c += weights[m] * num_differences(sets[m], representative);
+            return c;
+        };
+        auto make_group = [&](std::vector<uint32_t> members) {
+            group g;
+            g.members.swap(members);
+            g.representative = vote(g.members, false);
+            g.cost = cost(g.members, g.representative);
+            return g;
+        };
+
+        /* 2-means, starting from the representative and the farthest color set */
+        auto bisect = [&](group const& g, group& x, group& y) {
+            if (g.members.size() < 2) return false;
+            uint32_t farthest = g.members.front();
+            uint64_t max_differences = 0;
+            for (auto m : g.members) {
+                const uint64_t d = num_differences(sets[m], g.representative);
+                if (d > max_differences) {
+                    max_differences = d;
+                    farthest = m;
+                }
+            }
+            if (max_differences == 0) return false;
+            std::vector<uint32_t> centers[2] = {g.representative, sets[farthest]};
+            std::vector<uint32_t> parts[2];
+            std::vector<bool> assignment(g.members.size(), false), prev_assignment;
+            constexpr uint64_t max_iterations = 8;
+            for (uint64_t iteration = 0; iteration != max_iterations; ++iteration) {
+                parts[0].clear();
+                parts[1].clear();
+                for (uint64_t i = 0; i != g.members.size(); ++i) {
+                    const uint32_t m = g.members[i];
+                    assignment[i] = num_differences(sets[m], centers[1]) <
+                                    num_differences(sets[m], centers[0]);
+                    parts[assignment[i]].push_back(m);
+                }
+                if (parts[0].empty() or parts[1].empty()) return false;
+                if (assignment == prev_assignment) break;
+                prev_assignment = assignment;
+                centers[0] = vote(parts[0], false);
+                centers[1] = vote(parts[1], false);
+            }
+            x = make_group(parts[0]);
+            y = make_group(parts[1]);
+            return x.cost + y.cost < g.cost;
+        };
+
+        /* statistics: the selected representatives vs. one by majority vote */
+        uint64_t representative_ints = 0, differential_ints = 0;
+        uint64_t majority_representative_ints = 0, majority_differential_ints = 0;
+        double total_query_weight = 0, expected_decoded_ints = 0,
+               majority_expected_decoded_ints = 0;
+
+        std::vector<std::pair<uint32_t, uint32_t>> permutation;
+        std::vector<uint32_t> color_sets_ids;
+        permutation.reserve(num_color_sets);
+        color_sets_ids.reserve(num_color_sets);
+        m_references.clear();
+
+        for (uint64_t cluster_id = 0; cluster_id != m_num_partitions; ++cluster_id) {
+            const uint64_t begin = m_partition_size[cluster_id];
+            const uint64_t end = m_partition_size[cluster_id + 1];
+            if (begin == end) continue;
+            sets.resize(end - begin);
+            weights.resize(end - begin);
+            std::vector<uint32_t> members(end - begin);
+            for (uint64_t i = begin; i != end; ++i) {
+                auto it = index.color_set(m_color_sets_ids[i]);
+                sets[i - begin].resize(it.size());
+                it.decode(sets[i - begin].data());
+                weights[i - begin] =
+                    (1.0 + query_weight(m_color_sets_ids[i]) / mean_query_weight) / 2;
+                members[i - begin] = i - begin;
+            }
+
+            {
+                auto majority = vote(members, true);
+                majority_representative_ints += majority.size();
+                for (auto m : members) {
+                    const uint64_t d = num_differences(sets[m], majority);
+                    majority_differential_ints += d;
+                    majority_expected_decoded_ints +=
+                        query_weight(m_color_sets_ids[begin + m]) * (majority.size() + d);
+                }
+            }
+
+            std::vector<group> groups;
+            groups.push_back(make_group(members));
+            std::vector<bool> cannot_split(1, false);
+            while (groups.size() < max_representatives) {
+                uint64_t i = groups.size();
+                for (uint64_t j = 0; j != groups.size(); ++j) {
+                    if (cannot_split[j]) continue;
+                    if (i == groups.size() or groups[j].cost > groups[i].cost) i = j;
+                }
+                if (i == groups.size()) break;
+                group x, y;
+                if (bisect(groups[i], x, y)) {
+                    groups[i] = std::move(x);
+                    groups.push_back(std::move(y));
+                    cannot_split.push_back(false);
+                } else {
+                    cannot_split[i] = true;
+                }
+            }
+
+            for (auto const& g : groups) {
+                const uint32_t partition_id = m_references.size();
+                representative_ints += g.representative.size();
+                for (auto m : g.members) {
+                    const uint32_t color_id = m_color_sets_ids[begin + m];
+                    const uint64_t d = num_differences(sets[m], g.representative);
+                    differential_ints += d;
+                    total_query_weight += query_weight(color_id);
+                    expected_decoded_ints +=
+                        query_weight(color_id) * (g.representative.size() + d);
+                    permutation.emplace_back(partition_id, color_id);
+                    color_sets_ids.push_back(color_id);
+                }
+                m_references.push_back(g.representative);
+            }
         }
-        in.close();
-        std::remove((m_build_config.tmp_dirname + filename).c_str());
-
-        if (num_points == 0) {
-            std::cout << "Found empty partition" << endl;
-	    clustering_data.num_clusters = 0;
-            clustering_data.clusters = {};
-            return 0;
-        } else {
-            kmeans::clustering_parameters params;
-            float min_delta = 0.0001;
-            float max_iteration = 10;
-            uint64_t min_cluster_size = 0;
-            uint64_t seed = 0;
-            params.set_min_delta(min_delta);
-            params.set_max_iteration(max_iteration);
-            params.set_min_cluster_size(min_cluster_size);
-            params.set_random_seed(seed);
-
-            clustering_data = kmeans::kmeans_divisive(points.begin(), points.end(), params);
+
+        assert(permutation.size() == num_color_sets);
+        if (m_verbose) {
+            std::cout << "Selected " << m_references.size() << " representatives for "
+                      << m_num_partitions << " clusters\n";
         }
+        m_num_partitions = m_references.size();
+        m_permutation.swap(permutation);
+        m_color_sets_ids.swap(color_sets_ids);
+
+        if (total_query_weight == 0) total_query_weight = 1;  // no color set was hit
+        if (!m_verbose) return;
+        std::cout << "  representatives: " << representative_ints << " ints; differential lists: "
+                  << differential_ints << " ints (majority vote: "
+                  << majority_representative_ints << " and " << majority_differential_ints
+                  << " ints)" << std::endl;
+        std::cout << "  expected decoded ints per color set hit: "
+                  << expected_decoded_ints / total_query_weight << " (majority vote: "
+                  << majority_expected_decoded_ints / total_query_weight << ")" << std::endl;
+    }
+
+    uint64_t cluster(std::string filename, fulgor::clustering_data& clustering_data,
+                     std::vector<uint64_t>& color_ids) {
+        essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+        timer.start();
 
-        color_ids.insert(color_ids.end(), group_color_ids.begin(), group_color_ids.end());
+        const std::string sketches_filename = m_build_config.tmp_dirname + filename;
+        uint64_t num_points = 0;
+        {
+            mmapped_sketch_matrix sketches(sketches_filename);
+            num_points = sketches.num_points();
+            assert(sketches.num_ids() == num_points);
+            if (num_points == 0) {
+                if (m_verbose) std::cout << "Found empty partition" << endl;
+                clustering_data.num_clusters = 0;
+                clustering_data.clusters = {};
+            } else {
+                clustering_parameters params;
+                params.min_delta = 0.0001;
+                params.max_iteration = 10;
+                params.min_cluster_size = 0;
+                params.seed = 0;
+                params.num_threads = m_build_config.num_threads;
+                clustering_data = kmeans_divisive(sketches.points(), params);
+            }
+            for (uint64_t i = 0; i != num_points; ++i) color_ids.push_back(sketches.id(i));
+        }
+        std::remove(sketches_filename.c_str());
+        if (num_points == 0) return 0;
 
         timer.stop();
-        std::cout << "** clustering sketches took " << timer.elapsed() << " seconds / "
-                  << timer.elapsed() / 60 << " minutes" << std::endl;
+        if (m_verbose) {
+            std::cout << "** clustering sketches took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+        }
         timer.reset();
 
         return num_points;
@@ -218,6 +457,11 @@ struct index<ColorClasses>::differential_builder {
         essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
 
         differential_permuter p(m_build_config);
+        if (!m_build_config.query_weights.empty()) {
+            essentials::logger("computing query weights of the color sets...");
+            p.set_query_weights(query_weights(index));
+            essentials::logger("DONE");
+        }
         p.permute(index);
         auto const& permutation = p.permutation();
         auto const& references = p.references();
@@ -251,9 +495,6 @@ struct index<ColorClasses>::differential_builder {
             std::ofstream out(permuted_unitigs_filename.c_str());
             if (!out.is_open()) throw std::runtime_error("cannot open output file");
 
-            pthash::darray1 d;  // for select_1 on index.u2c
-            d.build(index.get_u2c());
-
             const uint64_t num_unitigs = index.get_u2c().size();
             pthash::bit_vector_builder u2c_builder(num_unitigs + 1, 0);
 
@@ -263,14 +504,8 @@ struct index<ColorClasses>::differential_builder {
             uint64_t pos = 0;
             for (uint64_t new_color_id = 0; new_color_id != num_color_sets; ++new_color_id) {
                 auto [_, old_color_id] = permutation[new_color_id];
-                uint64_t old_unitig_id_end = num_unitigs;
-                if (old_color_id < num_color_sets - 1) {
-                    old_unitig_id_end = d.select(index.get_u2c(), old_color_id) + 1;
-                }
-                uint64_t old_unitig_id_begin = 0;
-                if (old_color_id > 0) {
-                    old_unitig_id_begin = d.select(index.get_u2c(), old_color_id - 1) + 1;
-                }
+                auto [old_unitig_id_begin, old_unitig_id_end] =
+                    index.get_u2c().unitigs(old_color_id);
 
                 // num. unitigs that have the same color
                 pos += old_unitig_id_end - old_unitig_id_begin;
@@ -323,25 +558,10 @@ struct index<ColorClasses>::differential_builder {
         if (m_build_config.check) {
             essentials::logger("step 7. check correctness...");
 
+            std::vector<uint32_t> expected(index.num_docs()), got(index.num_docs());
             for (uint64_t color_id = 0; color_id < num_color_sets; color_id++) {
-                auto exp_it = index.color_set(permutation[color_id].second);
-                auto res_it = idx.color_set(color_id);
-                if (res_it.size() != exp_it.size()) {
-                    std::cout << "Error while checking color " << color_id
-                              << ", different sizes: expected " << exp_it.size() << " but got "
-                              << res_it.size() << ")" << std::endl;
-                    continue;
-                }
-
-                for (uint64_t j = 0; j < exp_it.size(); ++j, ++exp_it, ++res_it) {
-                    auto exp = *exp_it;
-                    auto got = *res_it;
-                    if (exp != got) {
-                        std::cout << "Error while checking color " << color_id
-                                  << ", mismatch at position " << j << ": expected " << exp
-                                  << " but got " << got << std::endl;
-                    }
-                }
+                util::check_color_set(index.color_set(permutation[color_id].second),
+                                      idx.color_set(color_id), color_id, expected, got);
             }
 
             std::cout << " COLORS DONE." << std::endl;
@@ -362,23 +582,9 @@ struct index<ColorClasses>::differential_builder {
                     uint64_t new_color_id = idx.u2c(new_contig_id);
                     uint64_t old_color_id = index.u2c(old_contig_id);
 
-                    auto exp_it = index.color_set(old_color_id);
-                    auto res_it = idx.color_set(new_color_id);
-                    if (res_it.size() != exp_it.size()) {
-                        std::cout << "Error while checking color " << new_color_id
-                                  << ", different sizes: expected " << exp_it.size() << " but got "
-                                  << res_it.size() << std::endl;
-                        continue;
-                    }
-                    for (uint64_t j = 0; j < exp_it.size(); ++j, ++exp_it, ++res_it) {
-                        auto exp = *exp_it;
-                        auto got = *res_it;
-                        if (exp != got) {
-                            std::cout << "Error while checking color " << new_color_id
-                                      << ", mismatch at position " << j << ": expected " << exp
-                                      << " but got " << got << std::endl;
-                        }
-                    }
+                    util::check_color_set(index.color_set(old_color_id),
+                                          idx.color_set(new_color_id), new_color_id, expected,
+                                          got);
                 }
             }
         }
@@ -386,5 +592,60 @@ struct index<ColorClasses>::differential_builder {
 
 private:
     build_configuration m_build_config;
+
+    /* the query weight of each color set: its number of unitigs, or the number of
+       reads of a FASTA/FASTQ sample that hit it */
+    std::vector<uint64_t> query_weights(index_type const& index) const {
+        const uint64_t num_color_sets = index.num_color_sets();
+        std::vector<uint64_t> weights(num_color_sets, 0);
+
+        if (m_build_config.query_weights == "unitigs") {
+            for (uint64_t color_id = 0; color_id != num_color_sets; ++color_id) {
+                auto [begin, end] = index.get_u2c().unitigs(color_id);
+                weights[color_id] = end - begin;
+            }
+            return weights;
+        }
+
+        if (!std::filesystem::exists(m_build_config.query_weights)) {
+            throw std::runtime_error("cannot open file '" + m_build_config.query_weights + "'");
+        }
+
+        auto const& dict = index.get_k2u();
+        std::vector<uint32_t> color_ids;
+        uint64_t num_reads = 0;
+        auto process = [&](std::string const& read) {
+            if (read.length() < dict.k()) return;
+            num_reads += 1;
+            color_ids.clear();
+            sshash::streaming_query_canonical_parsing query(&dict);
+            query.start();
+            const uint64_t num_kmers = read.length() - dict.k() + 1;
+            for (uint64_t i = 0, prev_unitig_id = -1; i != num_kmers; ++i) {
+                auto answer = query.lookup_advanced(read.data() + i);
+                if (answer.kmer_id == sshash::constants::invalid_uint64) continue;
+                if (answer.contig_id != prev_unitig_id) {
+                    color_ids.push_back(index.u2c(answer.contig_id));
+                    prev_unitig_id = answer.contig_id;
+                }
+            }
+            std::sort(color_ids.begin(), color_ids.end());
+            auto end = std::unique(color_ids.begin(), color_ids.end());
+            for (auto it = color_ids.begin(); it != end; ++it) weights[*it] += 1;
+        };
+
+        /* FASTA or FASTQ, possibly gzipped: one consumer (this thread), one parsing thread */
+        fastx_parser::FastxParser<fastx_parser::ReadSeq> rparser({m_build_config.query_weights},
+                                                                 1, 1);
+        rparser.start();
+        auto rg = rparser.getReadGroup();
+        while (rparser.refill(rg)) {
+            for (auto const& record : rg) process(record.seq);
+        }
+        rparser.stop();
+
+        std::cout << "processed " << num_reads << " reads of the query sample" << std::endl;
+        return weights;
+    }
 };
 }  // namespace fulgor
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <numeric>
+
+#include "index.hpp"
+
+namespace fulgor {
+
+/*
+    Rebuild a hybrid index storing its most accessed color sets uncompressed, in the hot
+    lists of hybrid (see hybrid::builder::process_hot), given the number of accesses to
+    each color set id in a sample run. The color set ids do not change, so that the
+    profile stays valid and color_set() routes each id to its section. The unitigs are
+    not changed either: the k2u and u2c maps are moved from the source index.
+*/
+template <typename ColorClasses>
+struct index<ColorClasses>::hot_color_sets_builder {
+    static_assert(std::is_same_v<ColorClasses, hybrid>,
+                  "only hybrid indexes can store hot color sets");
+
+    hot_color_sets_builder() {}
+
+    /* the hot color sets are the most accessed ones, at most max_fraction of them */
+    void build(index& from, std::vector<uint64_t> const& accesses, double max_fraction,
+               index& idx) {
+        if (idx.m_k2u.size() != 0) throw std::runtime_error("index already built");
+
+        const uint64_t num_docs = from.num_docs();
+        const uint64_t num_color_sets = from.num_color_sets();
+        if (accesses.size() != num_color_sets) throw std::runtime_error("wrong profile size");
+
+        std::vector<uint32_t> by_accesses(num_color_sets);
+        std::iota(by_accesses.begin(), by_accesses.end(), 0);
+        const uint64_t max_num_hot = std::min<uint64_t>(max_fraction * num_color_sets,
+                                                        num_color_sets);
+        std::partial_sort(by_accesses.begin(), by_accesses.begin() + max_num_hot,
+                          by_accesses.end(), [&](uint32_t x, uint32_t y) {
+                              return accesses[x] > accesses[y] or
+                                     (accesses[x] == accesses[y] and x < y);
+                          });
+
+        std::vector<bool> hot(num_color_sets, false);
+        uint64_t num_hot = 0, hot_accesses = 0;
+        for (uint64_t i = 0; i != max_num_hot and accesses[by_accesses[i]] > 0; ++i) {
+            hot[by_accesses[i]] = true;
+            hot_accesses += accesses[by_accesses[i]];
+            num_hot += 1;
+        }
+        const uint64_t total_accesses =
+            std::accumulate(accesses.begin(), accesses.end(), uint64_t(0));
+
+        /* the sizes of the color sets do not change: keep the thresholds of the index */
+        typename ColorClasses::builder colors_builder(num_docs,
+                                                      from.m_ccs.sparse_set_threshold_size(),
+                                                      from.m_ccs.very_dense_set_threshold_size());
+        std::vector<uint32_t> list(num_docs);
+        for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+            const uint64_t size = from.color_set(color_set_id).decode(list.data());
+            if (hot[color_set_id]) {
+                colors_builder.process_hot(list.data(), size);
+            } else {
+                colors_builder.process(list.data(), size);
+            }
+        }
+        colors_builder.build(idx.m_ccs);
+        if (!from.m_ccs.sizes().empty()) idx.m_ccs.build_color_set_sizes();
+
+        std::cout << "hot color sets: " << num_hot << " ("
+                  << (num_hot * 100.0) / num_color_sets << "% of the color sets, "
+                  << (total_accesses ? (hot_accesses * 100.0) / total_accesses : 0.0)
+                  << "% of the accesses)" << std::endl;
+
+        idx.m_filenames = std::move(from.m_filenames);
+        idx.m_u2c = std::move(from.m_u2c);
+        idx.m_k2u = std::move(from.m_k2u);
+    }
+};
+
+}  // namespace fulgor
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <limits>
+#include <random>
+
+#include "color_classes/color_classes.hpp"
+
+namespace fulgor {
+
+/*
+    Choose the thresholds of hybrid for an index, instead of the default ones
+    (chosen for space), by coding a sample of its color sets with each of the
+    three representations and measuring their space and their next/next_geq
+    time.
+
+    The color sets are bucketed by size, in num_buckets buckets of
+    num_docs / num_buckets ints, and the thresholds are chosen among the
+    bucket boundaries: a pair of thresholds assigns a representation to each
+    bucket, and its cost is the sum over the buckets of the number of color
+    sets in the bucket times the average cost of the representation on the
+    sampled color sets of the bucket. Each bucket keeps a uniform sample of its
+    color sets, of at most max_sample_ints ints.
+*/
+struct hybrid_thresholds_calibrator {
+    static constexpr uint64_t num_buckets = 20;  // the default thresholds are boundaries
+    static constexpr uint64_t max_sample_ints = uint64_t(1) << 22;
+    static constexpr uint64_t min_sample_lists = 8;
+    static constexpr uint64_t num_repetitions = 3;  // of each time measurement
+
+    hybrid_thresholds_calibrator(uint64_t num_docs, uint64_t seed = 0)
+        : m_num_docs(num_docs), m_rng(seed) {
+        m_boundaries.resize(num_buckets + 1);
+        for (uint64_t b = 0; b <= num_buckets; ++b) {
+            m_boundaries[b] = b * num_docs / num_buckets;
+        }
+        m_num_lists.resize(num_buckets, 0);
+        m_sample.resize(num_buckets);
+    }
+
+    /* reservoir sampling of the color sets of each bucket */
+    void add(uint32_t const* colors, uint64_t list_size) {
+        const uint64_t b = bucket(list_size);
+        const uint64_t capacity =
+            std::max<uint64_t>(min_sample_lists, max_sample_ints / (m_boundaries[b + 1] + 1));
+        m_num_lists[b] += 1;
+        if (m_sample[b].size() < capacity) {
+            m_sample[b].emplace_back(colors, colors + list_size);
+            return;
+        }
+        const uint64_t i = m_rng() % m_num_lists[b];
+        if (i < capacity) m_sample[b][i].assign(colors, colors + list_size);
+    }
+
+    /* the pair (sparse_set_threshold_size, very_dense_set_threshold_size) */
+    std::pair<uint32_t, uint32_t> calibrate(optimize_target target) {
+        measure();
+
+        /* the representation of bucket b is delta_gaps if b < s, bitmap if s <= b < d,
+           complement_delta_gaps otherwise */
+        auto cost = [&](uint64_t s, uint64_t d) {
+            double bits = 0, ns = 0;
+            for (uint64_t b = 0; b != num_buckets; ++b) {
+                const int r = b < s   ? list_type::delta_gaps
+                              : b < d ? list_type::bitmap
+                                      : list_type::complement_delta_gaps;
+                bits += m_num_lists[b] * m_bits[r][b];
+                ns += m_num_lists[b] * m_ns[r][b];
+            }
+            return std::pair<double, double>{bits, ns};
+        };
+
+        const uint64_t default_s = num_buckets / 4, default_d = 3 * num_buckets / 4;
+        assert(m_boundaries[default_s] == hybrid::default_sparse_set_threshold(m_num_docs));
+        assert(m_boundaries[default_d] == hybrid::default_very_dense_set_threshold(m_num_docs));
+        auto [default_bits, default_ns] = cost(default_s, default_d);
+
+        uint64_t best_s = default_s, best_d = default_d;
+        double best_bits = default_bits, best_ns = default_ns;
+        auto better = [&](double bits, double ns) {
+            if (target == optimize_target::space) {
+                return bits < best_bits or (bits == best_bits and ns < best_ns);
+            }
+            if (target == optimize_target::speed) {
+                return ns < best_ns or (ns == best_ns and bits < best_bits);
+            }
+            assert(target == optimize_target::balanced);
+            /* relative to the default thresholds */
+            return bits / default_bits + ns / default_ns <
+                   best_bits / default_bits + best_ns / default_ns;
+        };
+        for (uint64_t s = 0; s <= num_buckets; ++s) {
+            for (uint64_t d = s; d <= num_buckets; ++d) {
+                auto [bits, ns] = cost(s, d);
+                if (better(bits, ns)) {
+                    best_s = s;
+                    best_d = d;
+                    best_bits = bits;
+                    best_ns = ns;
+                }
+            }
+        }
+
+        std::cout << "calibrated thresholds: " << m_boundaries[best_s] << " and "
+                  << m_boundaries[best_d] << " (default: " << m_boundaries[default_s] << " and "
+                  << m_boundaries[default_d] << ")" << std::endl;
+        std::cout << "  estimated space: " << best_bits / default_bits * 100.0
+                  << "% of the default; estimated next/next_geq time: "
+                  << best_ns / default_ns * 100.0 << "% of the default" << std::endl;
+        return {m_boundaries[best_s], m_boundaries[best_d]};
+    }
+
+private:
+    uint64_t m_num_docs;
+    std::mt19937_64 m_rng;
+    std::vector<uint32_t> m_boundaries;
+    std::vector<uint64_t> m_num_lists;                        // per bucket
+    std::vector<std::vector<std::vector<uint32_t>>> m_sample;  // per bucket
+    uint64_t m_checksum = 0;
+
+    /* average bits and nanoseconds per color set, per representation and bucket */
+    double m_bits[3][num_buckets];
+    double m_ns[3][num_buckets];
+
+    uint64_t bucket(uint64_t list_size) const {
+        uint64_t b = std::upper_bound(m_boundaries.begin() + 1, m_boundaries.end(), list_size) -
+                     (m_boundaries.begin() + 1);
+        return std::min(b, num_buckets - 1);
+    }
+
+    void measure() {
+        /* thresholds that code all the color sets with one representation (and no run-length
+           coding, which would otherwise replace it on the lists with long runs) */
+        const uint32_t all = m_num_docs + 1;
+        const std::pair<uint32_t, uint32_t> thresholds[3] = {{all, all}, {0, all}, {0, 0}};
+
+        for (int r = 0; r != 3; ++r) {
+            hybrid h;
+            {
+                hybrid::builder builder(m_num_docs, thresholds[r].first, thresholds[r].second,
+                                        /* verbose */ false);
+                builder.set_run_length_coding(false);
+                for (auto const& bucket_sample : m_sample) {
+                    for (auto const& list : bucket_sample) {
+                        builder.process(list.data(), list.size());
+                    }
+                }
+                builder.build(h);
+            }
+
+            uint64_t color_set_id = 0;
+            for (uint64_t b = 0; b != num_buckets; ++b) {
+                const uint64_t n = m_sample[b].size();
+                m_bits[r][b] = m_ns[r][b] = 0;
+                if (n == 0) continue;
+                for (uint64_t i = 0; i != n; ++i) {
+                    m_bits[r][b] += h.color_set_num_bits(color_set_id + i);
+                }
+                m_bits[r][b] /= n;
+                double min_ns = std::numeric_limits<double>::max();
+                for (uint64_t rep = 0; rep != num_repetitions; ++rep) {
+                    min_ns = std::min(min_ns, time(h, color_set_id, n));
+                }
+                m_ns[r][b] = min_ns / n;
+                color_set_id += n;
+            }
+        }
+    }
+
+    /* scan each color set with next(), then skip through it with next_geq() */
+    double time(hybrid const& h, uint64_t begin, uint64_t n) {
+        essentials::timer<std::chrono::high_resolution_clock, std::chrono::nanoseconds> timer;
+        const uint64_t step = std::max<uint64_t>(1, m_num_docs / 64);
+        uint64_t sum = 0;
+        timer.start();
+        for (uint64_t i = begin; i != begin + n; ++i) {
+            auto it = h.color_set(i);
+            for (; it.value() < m_num_docs; it.next()) sum += it.value();
+            it = h.color_set(i);
+            for (uint64_t lower_bound = 0; lower_bound < m_num_docs; lower_bound += step) {
+                it.next_geq(lower_bound);
+                sum += it.value();
+            }
+        }
+        timer.stop();
+        m_checksum += sum;  // so that the scans are not optimized away
+        return timer.elapsed();
+    }
+};
+
+}  // namespace fulgor
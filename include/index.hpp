@@ -1,7 +1,7 @@
 #pragma once
 
 #include "external/sshash/include/dictionary.hpp"
-#include "ranked_bit_vector.hpp"
+#include "u2c_map.hpp"
 #include "filenames.hpp"
 #include "util.hpp"
 
@@ -15,6 +15,13 @@ struct index {
     struct meta_builder;
     struct differential_builder;
     struct meta_differential_builder;
+    struct permuted_references_builder;
+    struct reordered_unitigs_builder;
+    struct hot_color_sets_builder;
+
+    index()
+        : m_format_magic(constants::index_format_magic)
+        , m_format_version(constants::index_format_version) {}
 
     typename color_classes_type::iterator_type color_set(uint64_t color_set_id) const {
         assert(color_set_id < num_color_sets());
@@ -24,18 +31,28 @@ struct index {
     /* from unitig_id to color_set_id */
     uint64_t u2c(uint64_t unitig_id) const { return m_u2c.rank(unitig_id); }
 
-    void pseudoalign_full_intersection(std::string const& sequence,
-                                       std::vector<uint32_t>& results) const;
+    /* with num_threads > 1, the k-mers of sequence are streamed, and its color sets are
+       intersected, in parallel (e.g., for a long sequence) */
+    void pseudoalign_full_intersection(std::string const& sequence, std::vector<uint32_t>& results,
+                                       uint64_t num_threads = 1) const;
     void pseudoalign_threshold_union(std::string const& sequence, std::vector<uint32_t>& results,
                                      const double threshold) const;
 
-    void intersect_unitigs(std::vector<uint64_t>& unitig_ids, std::vector<uint32_t>& color_set) const;
+    void intersect_unitigs(std::vector<uint64_t>& unitig_ids, std::vector<uint32_t>& color_set,
+                           uint64_t num_threads = 1) const;
 
     std::string_view filename(uint64_t doc_id) const {
         assert(doc_id < num_docs());
         return m_filenames.filename(doc_id);
     }
 
+    /* store the sizes of the color sets, to read them in O(1) (see color_set_sizes) */
+    void build_color_set_sizes() { m_ccs.build_color_set_sizes(); }
+
+    /* meta coloring: store the partitions of each color set as a bitmap (see
+       partition_bitmaps) */
+    void build_partition_bitmaps() { m_ccs.build_partition_bitmaps(); }
+
     void print_stats() const;
     void dump(std::string const& basename) const;
 
@@ -49,14 +66,29 @@ struct index {
     uint64_t num_color_sets() const { return m_ccs.num_color_sets(); }
 
     sshash::dictionary const& get_k2u() const { return m_k2u; }
-    ranked_bit_vector const& get_u2c() const { return m_u2c; }
+    u2c_map const& get_u2c() const { return m_u2c; }
     ColorClasses const& get_color_sets() const { return m_ccs; }
     filenames const& get_filenames() const { return m_filenames; }
 
     template <typename Visitor>
     void visit(Visitor& visitor) {
+        visitor.visit(m_format_magic);
+        visitor.visit(m_format_version);
+        util::check_index_format(m_format_magic, m_format_version);
+        visit_unitigs(visitor);
+        visit_colors(visitor);
+    }
+
+    /* The maps that only depend on the unitigs and their order:
+       a layered index takes them from its parent (see layered_index.hpp). */
+    template <typename Visitor>
+    void visit_unitigs(Visitor& visitor) {
         visitor.visit(m_k2u);
         visitor.visit(m_u2c);
+    }
+
+    template <typename Visitor>
+    void visit_colors(Visitor& visitor) {
         visitor.visit(m_ccs);
         visitor.visit(m_filenames);
     }
@@ -66,10 +98,15 @@ struct index {
     }
 
 private:
+    template <typename>
+    friend struct index;  // builders derive an index from another index type
+
     sshash::dictionary m_k2u;  // map: kmer to unitig-id
-    ranked_bit_vector m_u2c;   // map: unitig-id to color-class-id
+    u2c_map m_u2c;             // map: unitig-id to color-class-id
     ColorClasses m_ccs;
     filenames m_filenames;
+
+    uint64_t m_format_magic, m_format_version;  // see constants::index_format_version
 };
 
 }  // namespace fulgor
@@ -8,8 +8,13 @@
 namespace fulgor {
 typedef index<hybrid> hybrid_colors_index_type;
 typedef hybrid_colors_index_type index_type;  // in use
+
+typedef index<roaring> roaring_colors_index_type;
+typedef roaring_colors_index_type roaring_index_type;  // in use
 }  // namespace fulgor
 
+#include "bp_reorderer.hpp"
+
 #include "meta_builder.hpp"
 #include "color_classes/meta.hpp"
 
@@ -32,4 +37,9 @@ typedef differential_colors_index_type differential_index_type;  // in use
 namespace fulgor {
 typedef index<meta_differential> meta_differential_colors_index_type;
 typedef meta_differential_colors_index_type meta_differential_index_type;  // in use
-}  // namespace fulgor
\ No newline at end of file
+}  // namespace fulgor
+
+#include "reordered_unitigs_builder.hpp"
+#include "hot_color_sets_builder.hpp"
+#include "layered_index.hpp"
+#include "sharded_index.hpp"
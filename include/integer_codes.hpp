@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <cassert>
 
 #include "bit_vector.hpp"
@@ -60,10 +61,128 @@ static void write_delta(bit_vector_builder& builder, uint64_t x) {
     uint64_t mask = (uint64_t(1) << b) - 1;
     builder.append_bits(xx & mask, b);
 }
+
+/*
+    Decoding of delta codes from the buffered bits of the iterator, without
+    refilling the buffer bit by bit: a code of at most delta_table_bits bits
+    (i.e., a value less than 127) is decoded with one lookup in delta_table;
+    a longer code that fits in 64 bits with one tzcnt and shifts; only the
+    (very rare) longer codes fall back to read_gamma.
+*/
+constexpr uint64_t delta_table_bits = 11;
+
+/* delta_table[w] is (x << 4) | length if w starts with the code of x, or 0 */
+constexpr std::array<uint16_t, uint64_t(1) << delta_table_bits> build_delta_table() {
+    std::array<uint16_t, uint64_t(1) << delta_table_bits> table{};
+    for (uint64_t w = 1; w != table.size(); ++w) {
+        uint64_t l = 0;
+        while (((w >> l) & 1) == 0) ++l;
+        if (2 * l + 1 > delta_table_bits) continue;
+        uint64_t b = (((w >> (l + 1)) & ((uint64_t(1) << l) - 1)) | (uint64_t(1) << l)) - 1;
+        uint64_t length = 2 * l + 1 + b;
+        if (length > delta_table_bits) continue;
+        uint64_t x = (((w >> (2 * l + 1)) & ((uint64_t(1) << b) - 1)) | (uint64_t(1) << b)) - 1;
+        table[w] = (x << 4) | length;
+    }
+    return table;
+}
+inline constexpr auto delta_table = build_delta_table();
+
+/* decode the code of x at the beginning of w, if it fits in 64 bits, setting its length */
+static inline bool decode_delta(uint64_t w, uint64_t& x, uint64_t& length) {
+    const uint64_t entry = delta_table[w & ((uint64_t(1) << delta_table_bits) - 1)];
+    if (entry != 0) {
+        x = entry >> 4;
+        length = entry & 15;
+        return true;
+    }
+    if (w == 0) return false;
+    const uint64_t l = lsbll(w);
+    if (l > 31) return false;
+    const uint64_t b = (((w >> (l + 1)) & ((uint64_t(1) << l) - 1)) | (uint64_t(1) << l)) - 1;
+    length = 2 * l + 1 + b;
+    if (length > 64) return false;
+    x = (((w >> (2 * l + 1)) & ((uint64_t(1) << b) - 1)) | (uint64_t(1) << b)) - 1;
+    return true;
+}
+
 static uint64_t read_delta(bit_vector_iterator& it) {
+    uint64_t x = 0, length = 0;
+    if (decode_delta(it.peek(), x, length) and length <= it.available()) {
+        it.skip(length);
+        return x;
+    }
+    it.fill_buf();  // the next 64 bits
+    if (decode_delta(it.peek(), x, length)) {
+        it.skip(length);
+        return x;
+    }
     uint64_t b = read_gamma(it);
     return (it.take(b) | (uint64_t(1) << b)) - 1;
 }
+
+/* decode the next n delta codes into out[0..n) */
+template <typename T>
+static void read_delta_n(bit_vector_iterator& it, T* out, uint64_t n) {
+    uint64_t i = 0;
+    while (i != n) {
+        /* decode as many codes as possible from the buffered bits */
+        uint64_t w = it.peek();
+        const uint64_t available = it.available();
+        uint64_t consumed = 0;
+        uint64_t x = 0, length = 0;
+        while (i != n and decode_delta(w, x, length) and length <= available - consumed) {
+            out[i++] = x;
+            consumed += length;
+            w = length < 64 ? w >> length : 0;
+        }
+        if (consumed == 0) {
+            out[i++] = read_delta(it);  // a code longer than the buffered bits
+        } else {
+            it.skip(consumed);
+        }
+    }
+}
+
+/*
+    Buffered decoding of a sequence of num_values delta codes, read_delta_n
+    decoding up to capacity values at a time. It never decodes past the last
+    value of the sequence.
+*/
+struct delta_buffer {
+    static constexpr uint64_t capacity = 16;
+
+    delta_buffer() : m_remaining(0), m_begin(0), m_end(0) {}
+
+    void reset(uint64_t num_values) {
+        m_remaining = num_values;
+        m_begin = 0;
+        m_end = 0;
+    }
+
+    inline uint64_t next(bit_vector_iterator& it) {
+        if (m_begin == m_end) {
+            assert(m_remaining > 0);
+            const uint64_t n = m_remaining < capacity ? m_remaining : capacity;
+            read_delta_n(it, m_values, n);
+            m_remaining -= n;
+            m_begin = 0;
+            m_end = n;
+        }
+        return m_values[m_begin++];
+    }
+
+private:
+    uint64_t m_remaining;
+    uint32_t m_begin, m_end;
+    uint32_t m_values[capacity];
+};
+
+/* number of bits taken by write_delta(x) */
+static uint64_t delta_length(uint64_t x) {
+    uint64_t b = msbll(x + 1);
+    return 2 * msbll(b + 1) + 1 + b;
+}
 /***/
 
 /* Rice */
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <filesystem>
+
+#include "index.hpp"
+
+namespace fulgor {
+
+namespace constants {
+constexpr uint64_t layered_index_magic = 0x31474c524f474c46;  // "FLGORLG1" in little endian
+}
+
+/*
+    A visitor computing a 128-bit hash of the bytes that essentials::saver
+    would write for the visited data.
+*/
+struct serialization_hasher {
+    static constexpr uint64_t buffer_size = 1ULL << 20;
+
+    serialization_hasher() : m_hash(0) { m_buffer.reserve(buffer_size); }
+
+    template <typename T>
+    void visit(T& val) {
+        if constexpr (essentials::is_pod<T>::value) {
+            append(reinterpret_cast<char const*>(&val), sizeof(T));
+        } else {
+            val.visit(*this);
+        }
+    }
+
+    template <typename T, typename Allocator>
+    void visit(std::vector<T, Allocator>& vec) {
+        size_t n = vec.size();
+        visit(n);
+        if constexpr (essentials::is_pod<T>::value) {
+            append(reinterpret_cast<char const*>(vec.data()), sizeof(T) * n);
+        } else {
+            for (auto& v : vec) visit(v);
+        }
+    }
+
+    __uint128_t digest() {
+        flush();
+        return m_hash;
+    }
+
+private:
+    __uint128_t m_hash;
+    std::vector<char> m_buffer;
+
+    void append(char const* data, uint64_t num_bytes) {
+        while (num_bytes != 0) {
+            uint64_t n = std::min(num_bytes, buffer_size - m_buffer.size());
+            m_buffer.insert(m_buffer.end(), data, data + n);
+            data += n;
+            num_bytes -= n;
+            if (m_buffer.size() == buffer_size) flush();
+        }
+    }
+
+    /* hash the buffer, seeding with the hash of the previous bytes */
+    void flush() {
+        if (m_buffer.empty()) return;
+        const uint64_t seed = static_cast<uint64_t>(m_hash) ^ static_cast<uint64_t>(m_hash >> 64);
+        m_hash = util::hash128(m_buffer.data(), m_buffer.size(), seed);
+        m_buffer.clear();
+    }
+};
+
+/*
+    A layered index file does not store the k2u and u2c maps, but references them
+    from its parent index file, which must be an index with the same unitigs in the
+    same order. The file stores this header (starting with the format of the index, as a
+    full index file does) followed by the color sets and the filenames.
+*/
+struct layered_index_header {
+    layered_index_header()
+        : m_magic(0)
+        , m_format_magic(constants::index_format_magic)
+        , m_format_version(constants::index_format_version)
+        , m_parent_hash_low(0)
+        , m_parent_hash_high(0) {}
+
+    layered_index_header(std::string const& parent_filename, __uint128_t parent_hash)
+        : m_magic(constants::layered_index_magic)
+        , m_format_magic(constants::index_format_magic)
+        , m_format_version(constants::index_format_version)
+        , m_parent_hash_low(static_cast<uint64_t>(parent_hash))
+        , m_parent_hash_high(static_cast<uint64_t>(parent_hash >> 64))
+        , m_parent_filename(parent_filename.begin(), parent_filename.end()) {}
+
+    bool valid() const { return m_magic == constants::layered_index_magic; }
+
+    std::string parent_filename() const {
+        return std::string(m_parent_filename.begin(), m_parent_filename.end());
+    }
+
+    __uint128_t parent_hash() const {
+        return (__uint128_t(m_parent_hash_high) << 64) | m_parent_hash_low;
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_magic);
+        visitor.visit(m_format_magic);
+        visitor.visit(m_format_version);
+        util::check_index_format(m_format_magic, m_format_version);
+        visitor.visit(m_parent_hash_low);
+        visitor.visit(m_parent_hash_high);
+        visitor.visit(m_parent_filename);
+    }
+
+private:
+    uint64_t m_magic;
+    uint64_t m_format_magic, m_format_version;  // see constants::index_format_version
+    uint64_t m_parent_hash_low, m_parent_hash_high;
+    std::vector<char> m_parent_filename;
+};
+
+/* hash of the k2u and u2c maps of the index */
+template <typename Index>
+__uint128_t unitigs_hash(Index& index) {
+    serialization_hasher hasher;
+    index.visit_unitigs(hasher);
+    return hasher.digest();
+}
+
+static bool is_layered(std::string const& index_filename) {
+    std::ifstream in(index_filename.c_str(), std::ios::binary);
+    if (!in.is_open()) throw std::runtime_error("cannot open file '" + index_filename + "'");
+    uint64_t magic = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(uint64_t));
+    return in.gcount() == sizeof(uint64_t) and magic == constants::layered_index_magic;
+}
+
+/*
+    Save the index as a layered index referencing the k2u and u2c maps of
+    parent_filename, which must store the same maps of the index.
+*/
+template <typename Index>
+size_t save_layered(Index& index, std::string const& parent_filename,
+                    std::string const& filename) {
+    layered_index_header header(std::filesystem::absolute(parent_filename).string(),
+                                unitigs_hash(index));
+    essentials::saver saver(filename.c_str());
+    saver.visit(header);
+    index.visit_colors(saver);
+    return saver.bytes();
+}
+
+/* Load an index, either layered or not. */
+template <typename Index>
+void load_index(Index& index, std::string const& filename) {
+    if (!is_layered(filename)) {
+        essentials::load(index, filename.c_str());
+        return;
+    }
+
+    essentials::loader loader(filename.c_str());
+    layered_index_header header;
+    loader.visit(header);
+    assert(header.valid());
+
+    const std::string parent_filename = header.parent_filename();
+    if (!std::filesystem::exists(parent_filename)) {
+        throw std::runtime_error("cannot find the parent index '" + parent_filename + "' of '" +
+                                 filename + "'");
+    }
+    {
+        essentials::loader parent_loader(parent_filename.c_str());
+        uint64_t format_magic = 0, format_version = 0;
+        parent_loader.visit(format_magic);
+        parent_loader.visit(format_version);
+        util::check_index_format(format_magic, format_version);
+        index.visit_unitigs(parent_loader);
+    }
+    if (unitigs_hash(index) != header.parent_hash()) {
+        throw std::runtime_error("the parent index '" + parent_filename + "' of '" + filename +
+                                 "' has changed since '" + filename + "' was built");
+    }
+
+    index.visit_colors(loader);
+}
+
+}  // namespace fulgor
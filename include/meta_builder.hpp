@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <numeric>
+#include <thread>
+
 #include "index.hpp"
 #include "build_util.hpp"
 
@@ -9,6 +13,180 @@ struct partition_endpoint {
     uint64_t begin, end;  // [..)
 };
 
+/*
+    The distinct partial colors of a partition, in order of first occurrence,
+    together with their hashes. The partial colors are coded as gaps with delta
+    to keep the buffer small.
+*/
+struct partial_colors_buffer {
+    void append(__uint128_t hash, uint32_t const* partial_color, uint64_t size) {
+        assert(size > 0);
+        m_hashes.push_back(hash);
+        util::write_delta(m_bvb, size);
+        uint32_t prev_val = partial_color[0];
+        util::write_delta(m_bvb, prev_val);
+        for (uint64_t i = 1; i != size; ++i) {
+            uint32_t val = partial_color[i];
+            assert(val >= prev_val + 1);
+            util::write_delta(m_bvb, val - (prev_val + 1));
+            prev_val = val;
+        }
+    }
+
+    bit_vector_iterator iterator() const {
+        return bit_vector_iterator(m_bvb.data(), util::num_64bit_words_for(m_bvb.num_bits()));
+    }
+
+    /* decode the next partial color from the iterator */
+    static void decode(bit_vector_iterator& it, std::vector<uint32_t>& partial_color) {
+        partial_color.clear();
+        uint64_t size = util::read_delta(it);
+        uint32_t val = util::read_delta(it);
+        partial_color.push_back(val);
+        for (uint64_t i = 1; i != size; ++i) {
+            val += util::read_delta(it) + 1;
+            partial_color.push_back(val);
+        }
+    }
+
+    __uint128_t hash(uint64_t i) const { return m_hashes[i]; }
+    uint64_t size() const { return m_hashes.size(); }
+
+    void clear() {
+        std::vector<__uint128_t>().swap(m_hashes);
+        m_bvb = bit_vector_builder();
+    }
+
+private:
+    std::vector<__uint128_t> m_hashes;
+    bit_vector_builder m_bvb;
+};
+
+/*
+    Append-only, buffered writer of meta color lists to a temporary file.
+    A meta color list is a sequence of (partition_id, partial_color_id) pairs,
+    with increasing partition ids: each pair is coded as the gap between
+    consecutive partition ids followed by the partial_color_id, both with
+    variable-byte codes. The sizes of the lists are not written to the file
+    but kept in memory, and must be given to the reader.
+*/
+struct metacolors_writer {
+    static constexpr uint64_t buffer_size = 1ULL << 20;
+
+    metacolors_writer(std::string const& filename)
+        : m_out(filename, std::ios::binary), m_list_size(0), m_prev_partition_id(0) {
+        if (!m_out.is_open()) throw std::runtime_error("error in opening file");
+        m_buffer.reserve(buffer_size + 2 * max_vbyte_bytes);
+    }
+
+    void append(uint32_t partition_id, uint32_t partial_color_id) {
+        assert(m_list_size == 0 or partition_id > m_prev_partition_id);
+        write_vbyte(m_list_size == 0 ? partition_id : partition_id - (m_prev_partition_id + 1));
+        write_vbyte(partial_color_id);
+        if (m_buffer.size() >= buffer_size) flush();
+        m_prev_partition_id = partition_id;
+        m_list_size += 1;
+    }
+
+    /* terminate the current meta color list */
+    void close_list() {
+        m_list_sizes.push_back(m_list_size);
+        m_list_size = 0;
+    }
+
+    void close() {
+        assert(m_list_size == 0);
+        flush();
+        m_out.close();
+    }
+
+    std::vector<uint32_t>& list_sizes() { return m_list_sizes; }
+
+private:
+    static constexpr uint64_t max_vbyte_bytes = 5;  // for 32-bit integers
+
+    std::ofstream m_out;
+    std::vector<uint8_t> m_buffer;
+    std::vector<uint32_t> m_list_sizes;
+    uint32_t m_list_size;
+    uint32_t m_prev_partition_id;
+
+    void write_vbyte(uint32_t x) {
+        while (x >= 128) {
+            m_buffer.push_back(static_cast<uint8_t>(x | 128));
+            x >>= 7;
+        }
+        m_buffer.push_back(static_cast<uint8_t>(x));
+    }
+
+    void flush() {
+        m_out.write(reinterpret_cast<char const*>(m_buffer.data()), m_buffer.size());
+        m_buffer.clear();
+    }
+};
+
+/* Reads, in large blocks, the meta color lists written by a metacolors_writer. */
+struct metacolors_reader {
+    static constexpr uint64_t buffer_size = 1ULL << 20;
+
+    metacolors_reader(std::string const& filename, std::vector<uint32_t> const& list_sizes)
+        : m_in(filename, std::ios::binary)
+        , m_list_sizes(list_sizes)
+        , m_list_id(0)
+        , m_buffer(buffer_size)
+        , m_begin(0)
+        , m_end(0) {
+        if (!m_in.is_open()) throw std::runtime_error("error in opening file");
+    }
+
+    bool has_next() const { return m_list_id != m_list_sizes.size(); }
+
+    /* read the next meta color list as (partition_id, partial_color_id) pairs */
+    void next(std::vector<std::pair<uint32_t, uint32_t>>& list) {
+        assert(has_next());
+        list.clear();
+        const uint32_t list_size = m_list_sizes[m_list_id];
+        uint32_t partition_id = 0;
+        for (uint32_t i = 0; i != list_size; ++i) {
+            if (m_end - m_begin < 2 * max_vbyte_bytes) refill();
+            partition_id += read_vbyte() + (i != 0);
+            uint32_t partial_color_id = read_vbyte();
+            list.emplace_back(partition_id, partial_color_id);
+        }
+        m_list_id += 1;
+    }
+
+    void close() { m_in.close(); }
+
+private:
+    static constexpr uint64_t max_vbyte_bytes = 5;
+
+    std::ifstream m_in;
+    std::vector<uint32_t> const& m_list_sizes;
+    uint64_t m_list_id;
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_begin, m_end;  // unread bytes in m_buffer
+
+    uint32_t read_vbyte() {
+        uint32_t x = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            assert(m_begin < m_end);
+            uint8_t byte = m_buffer[m_begin++];
+            x |= uint32_t(byte & 127) << shift;
+            if (byte < 128) break;
+        }
+        return x;
+    }
+
+    void refill() {
+        std::copy(m_buffer.begin() + m_begin, m_buffer.begin() + m_end, m_buffer.begin());
+        m_end -= m_begin;
+        m_begin = 0;
+        m_in.read(reinterpret_cast<char*>(m_buffer.data() + m_end), buffer_size - m_end);
+        m_end += m_in.gcount();
+    }
+};
+
 struct permuter {
     permuter(build_configuration const& build_config)
         : m_build_config(build_config), m_num_partitions(0), m_max_partition_size(0) {}
@@ -21,7 +199,8 @@ struct permuter {
             timer.start();
             constexpr uint64_t p = 10;  // use 2^p bytes per HLL sketch
             build_reference_sketches(index, p, m_build_config.num_threads,
-                                     m_build_config.tmp_dirname + "/sketches.bin");
+                                     m_build_config.tmp_dirname + "/sketches.bin",
+                                     m_build_config.sketch_sampling_rate);
             timer.stop();
             std::cout << "** building sketches took " << timer.elapsed() << " seconds / "
                       << timer.elapsed() / 60 << " minutes" << std::endl;
@@ -32,35 +211,19 @@ struct permuter {
             essentials::logger("step 3. clustering sketches");
             timer.start();
 
-            std::ifstream in(m_build_config.tmp_dirname + "/sketches.bin", std::ios::binary);
-            if (!in.is_open()) throw std::runtime_error("error in opening file");
-
-            std::vector<kmeans::point> points;
-            uint64_t num_bytes_per_point = 0;
-            uint64_t num_points = 0;
-            in.read(reinterpret_cast<char*>(&num_bytes_per_point), sizeof(uint64_t));
-            in.read(reinterpret_cast<char*>(&num_points), sizeof(uint64_t));
-            points.resize(num_points, kmeans::point(num_bytes_per_point));
-            for (auto& point : points) {
-                in.read(reinterpret_cast<char*>(point.data()), num_bytes_per_point);
+            clustering_parameters params;
+            params.min_delta = 0.0001;
+            params.max_iteration = 10;
+            params.min_cluster_size = 50;
+            params.seed = 0;
+            params.num_threads = m_build_config.num_threads;
+            fulgor::clustering_data clustering_data;
+            {
+                mmapped_sketch_matrix sketches(m_build_config.tmp_dirname + "/sketches.bin");
+                clustering_data = kmeans_divisive(sketches.points(), params);
             }
-            in.close();
-
             std::remove((m_build_config.tmp_dirname + "/sketches.bin").c_str());
 
-            kmeans::clustering_parameters params;
-
-            /* kmeans_divisive */
-            constexpr float min_delta = 0.0001;
-            constexpr float max_iteration = 10;
-            constexpr uint64_t min_cluster_size = 50;
-            constexpr uint64_t seed = 0;
-            params.set_min_delta(min_delta);
-            params.set_max_iteration(max_iteration);
-            params.set_min_cluster_size(min_cluster_size);
-            params.set_random_seed(seed);
-            auto clustering_data = kmeans::kmeans_divisive(points.begin(), points.end(), params);
-
             timer.stop();
             std::cout << "** clustering sketches took " << timer.elapsed() << " seconds / "
                       << timer.elapsed() / 60 << " minutes" << std::endl;
@@ -152,18 +315,6 @@ struct index<ColorClasses>::meta_builder {
             essentials::logger("step 4. building partial/meta colors");
             timer.start();
 
-            std::ofstream metacolors_out(m_build_config.tmp_dirname + "/metacolors.bin",
-                                         std::ios::binary);
-            if (!metacolors_out.is_open()) throw std::runtime_error("error in opening file");
-
-            uint64_t num_integers_in_metacolors = 0;
-            uint64_t num_partial_colors = 0;
-
-            std::vector<uint32_t> partial_color;
-            std::vector<uint32_t> permuted_list;
-            partial_color.reserve(max_partition_size);
-            permuted_list.reserve(num_docs);
-
             typename ColorClasses::builder colors_builder;
 
             colors_builder.init_colors_builder(num_docs, num_partitions);
@@ -173,143 +324,240 @@ struct index<ColorClasses>::meta_builder {
                 colors_builder.init_color_partition(partition_id, num_docs_in_partition);
             }
 
-            uint64_t partition_id = 0;
-            uint32_t meta_color_list_size = 0;
-
-            std::vector<std::unordered_map<__uint128_t,            // key
-                                           uint32_t,               // value
-                                           util::hasher_uint128_t  // key's hasher
-                                           >>
-                hashes;  // (hash, id)
-            hashes.resize(num_partitions);
-
-            auto hash_and_compress = [&]() {
-                assert(!partial_color.empty());
-                auto hash = util::hash128(reinterpret_cast<char const*>(partial_color.data()),
-                                          partial_color.size() * sizeof(uint32_t));
-                uint32_t partial_color_id = 0;
-                auto it = hashes[partition_id].find(hash);
-                if (it == hashes[partition_id].cend()) {  // new partial color
-                    partial_color_id = hashes[partition_id].size();
-                    hashes[partition_id].insert({hash, partial_color_id});
-                    colors_builder.process_colors(partition_id, partial_color.data(),
-                                                  partial_color.size());
-                } else {
-                    partial_color_id = (*it).second;
+            /* split the color sets into slices of roughly the same number of integers */
+            struct slice {
+                uint64_t begin, end;  // [..)
+            };
+            std::vector<slice> thread_slices;
+            {
+                uint64_t load = 0;
+                for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+                    load += index.get_color_sets().color_set_size(color_set_id);
+                }
+                const uint64_t load_per_thread =
+                    std::max<uint64_t>(load / m_build_config.num_threads, 1);
+                slice s;
+                s.begin = 0;
+                uint64_t curr_load = 0;
+                for (uint64_t color_set_id = 0; color_set_id != num_color_sets; ++color_set_id) {
+                    curr_load += index.get_color_sets().color_set_size(color_set_id);
+                    if (curr_load >= load_per_thread or color_set_id == num_color_sets - 1) {
+                        s.end = color_set_id + 1;
+                        thread_slices.push_back(s);
+                        s.begin = color_set_id + 1;
+                        curr_load = 0;
+                    }
                 }
+            }
+            const uint64_t num_threads = thread_slices.size();
+
+            /*
+                Each thread deduplicates the partial colors of its slice within each
+                partition, and writes the meta colors of its slice to its own file
+                as (partition_id, partial_color_id) pairs, where partial_color_id is
+                relative to the distinct partial colors of the partition seen by the
+                thread (thread_partial_colors[thread_id][partition_id]).
+            */
+            std::vector<std::vector<partial_colors_buffer>> thread_partial_colors(
+                num_threads, std::vector<partial_colors_buffer>(num_partitions));
+            std::vector<uint64_t> thread_num_integers_in_metacolors(num_threads, 0);
+            std::vector<std::vector<uint32_t>> thread_meta_color_list_sizes(num_threads);
+
+            auto metacolors_filename = [&](uint64_t thread_id) {
+                return m_build_config.tmp_dirname + "/metacolors." + std::to_string(thread_id) +
+                       ".bin";
+            };
+
+            auto exe = [&](uint64_t thread_id) {
+                assert(thread_id < thread_slices.size());
+                auto s = thread_slices[thread_id];
+                auto& partial_colors = thread_partial_colors[thread_id];
+
+                metacolors_writer metacolors_out(metacolors_filename(thread_id));
+
+                std::vector<uint32_t> partial_color;
+                std::vector<uint32_t> permuted_list;
+                partial_color.reserve(max_partition_size);
+                permuted_list.reserve(num_docs);
+
+                uint64_t partition_id = 0;
+                uint32_t meta_color_list_size = 0;
+
+                std::vector<std::unordered_map<__uint128_t,            // key
+                                               uint32_t,               // value
+                                               util::hasher_uint128_t  // key's hasher
+                                               >>
+                    hashes;  // (hash, id)
+                hashes.resize(num_partitions);
+
+                auto hash_and_compress = [&]() {
+                    assert(!partial_color.empty());
+                    auto hash = util::hash128(reinterpret_cast<char const*>(partial_color.data()),
+                                              partial_color.size() * sizeof(uint32_t));
+                    uint32_t partial_color_id = 0;
+                    auto it = hashes[partition_id].find(hash);
+                    if (it == hashes[partition_id].cend()) {  // new partial color
+                        partial_color_id = hashes[partition_id].size();
+                        hashes[partition_id].insert({hash, partial_color_id});
+                        partial_colors[partition_id].append(hash, partial_color.data(),
+                                                            partial_color.size());
+                    } else {
+                        partial_color_id = (*it).second;
+                    }
 
-                /*  write meta color: (partition_id, partial_color_id)
-                    Note: at this stage, partial_color_id is relative
-                          to its partition (is not global yet).
-                */
-                metacolors_out.write(reinterpret_cast<char const*>(&partition_id),
-                                     sizeof(uint32_t));
-                metacolors_out.write(reinterpret_cast<char const*>(&partial_color_id),
-                                     sizeof(uint32_t));
-
-                partial_color.clear();
-                meta_color_list_size += 1;
+                    /*  write meta color: (partition_id, partial_color_id)
+                        Note: at this stage, partial_color_id is relative
+                              to its partition and thread (is not global yet).
+                    */
+                    metacolors_out.append(partition_id, partial_color_id);
+
+                    partial_color.clear();
+                    meta_color_list_size += 1;
+                };
+
+                for (uint64_t color_set_id = s.begin; color_set_id != s.end; ++color_set_id) {
+                    /* permute list */
+                    permuted_list.resize(num_docs);
+                    permuted_list.resize(
+                        index.color_set(color_set_id).decode(permuted_list.data()));
+                    for (auto& ref_id : permuted_list) ref_id = permutation[ref_id];
+                    const uint64_t list_size = permuted_list.size();
+                    std::sort(permuted_list.begin(), permuted_list.end());
+
+                    /* partition list */
+                    meta_color_list_size = 0;
+                    partition_id = 0;
+                    partition_endpoint curr_partition = p.partition_endpoints(0);
+                    assert(partial_color.empty());
+
+                    for (uint64_t i = 0; i != list_size; ++i) {
+                        uint32_t ref_id = permuted_list[i];
+                        while (ref_id >= curr_partition.end) {
+                            if (!partial_color.empty()) hash_and_compress();
+                            partition_id += 1;
+                            curr_partition = p.partition_endpoints(partition_id);
+                        }
+                        assert(ref_id >= curr_partition.begin);
+                        partial_color.push_back(ref_id - curr_partition.begin);
+                    }
+                    if (!partial_color.empty()) hash_and_compress();
+
+                    thread_num_integers_in_metacolors[thread_id] += meta_color_list_size;
+                    metacolors_out.close_list();
+                }
+
+                metacolors_out.close();
+                thread_meta_color_list_sizes[thread_id].swap(metacolors_out.list_sizes());
             };
 
-            for (uint64_t color_set_id = 0; color_set_id != num_color_sets;
-                 ++color_set_id) {
-                /* permute list */
-                permuted_list.clear();
-                auto it = index.color_set(color_set_id);
-                uint64_t list_size = it.size();
-                for (uint64_t i = 0; i != list_size; ++i, ++it) {
-                    uint32_t ref_id = *it;
-                    permuted_list.push_back(permutation[ref_id]);
+            {
+                std::vector<std::thread> threads(num_threads);
+                for (uint64_t thread_id = 0; thread_id != num_threads; ++thread_id) {
+                    threads[thread_id] = std::thread(exe, thread_id);
                 }
-                std::sort(permuted_list.begin(), permuted_list.end());
+                for (auto& t : threads) {
+                    if (t.joinable()) t.join();
+                }
+            }
 
-                /* partition list */
-                meta_color_list_size = 0;
-                partition_id = 0;
-                partition_endpoint curr_partition = p.partition_endpoints(0);
-                assert(partial_color.empty());
-
-                /* reserve space to hold the size of the meta color list */
-                metacolors_out.write(reinterpret_cast<char const*>(&meta_color_list_size),
-                                     sizeof(uint32_t));
-
-                for (uint64_t i = 0; i != list_size; ++i) {
-                    uint32_t ref_id = permuted_list[i];
-                    while (ref_id >= curr_partition.end) {
-                        if (!partial_color.empty()) hash_and_compress();
-                        partition_id += 1;
-                        curr_partition = p.partition_endpoints(partition_id);
+            /*
+                Merge the partial colors of each partition, visiting the threads in order:
+                a partial color gets its id the first time it is seen, so the ids are the
+                same as those assigned by a single thread scanning all the color sets.
+                Partitions are independent of each other and are merged in parallel.
+                to_partition_id[thread_id][partition_id][i] is the id, relative to
+                the partition, of the i-th partial color of the partition seen by the thread.
+            */
+            std::vector<std::vector<std::vector<uint32_t>>> to_partition_id(
+                num_threads, std::vector<std::vector<uint32_t>>(num_partitions));
+            std::vector<uint32_t> num_lists_in_partition(num_partitions, 0);
+            {
+                std::atomic<uint64_t> next_partition_id = 0;
+                auto merge = [&]() {
+                    std::vector<uint32_t> partial_color;
+                    partial_color.reserve(max_partition_size);
+                    std::unordered_map<__uint128_t, uint32_t, util::hasher_uint128_t> hashes;
+                    while (true) {
+                        const uint64_t partition_id = next_partition_id++;
+                        if (partition_id >= num_partitions) break;
+                        hashes.clear();
+                        for (uint64_t thread_id = 0; thread_id != num_threads; ++thread_id) {
+                            auto const& partial_colors =
+                                thread_partial_colors[thread_id][partition_id];
+                            auto& ids = to_partition_id[thread_id][partition_id];
+                            ids.reserve(partial_colors.size());
+                            bit_vector_iterator it = partial_colors.iterator();
+                            for (uint64_t i = 0; i != partial_colors.size(); ++i) {
+                                auto hash = partial_colors.hash(i);
+                                partial_colors_buffer::decode(it, partial_color);
+                                uint32_t partial_color_id = 0;
+                                auto h = hashes.find(hash);
+                                if (h == hashes.cend()) {  // new partial color
+                                    partial_color_id = hashes.size();
+                                    hashes.insert({hash, partial_color_id});
+                                    colors_builder.process_colors(
+                                        partition_id, partial_color.data(), partial_color.size());
+                                } else {
+                                    partial_color_id = (*h).second;
+                                }
+                                ids.push_back(partial_color_id);
+                            }
+                            thread_partial_colors[thread_id][partition_id].clear();
+                        }
+                        num_lists_in_partition[partition_id] = hashes.size();
                     }
-                    assert(ref_id >= curr_partition.begin);
-                    partial_color.push_back(ref_id - curr_partition.begin);
+                };
+                std::vector<std::thread> threads(std::min(num_threads, num_partitions));
+                for (auto& t : threads) t = std::thread(merge);
+                for (auto& t : threads) {
+                    if (t.joinable()) t.join();
                 }
-                if (!partial_color.empty()) hash_and_compress();
-
-                num_integers_in_metacolors += meta_color_list_size;
-
-                /* write size of meta color list */
-                uint64_t current_pos = metacolors_out.tellp();
-                uint64_t num_bytes_in_meta_color_list =
-                    2 * meta_color_list_size * sizeof(uint32_t) + sizeof(uint32_t);
-                assert(current_pos >= num_bytes_in_meta_color_list);
-                uint64_t pos = current_pos - num_bytes_in_meta_color_list;
-                metacolors_out.seekp(pos);
-                metacolors_out.write(reinterpret_cast<char const*>(&meta_color_list_size),
-                                     sizeof(uint32_t));
-                metacolors_out.seekp(current_pos);
             }
 
-            metacolors_out.close();
-
             std::vector<uint64_t> num_partial_colors_before;
-            std::vector<uint32_t> num_lists_in_partition;
             num_partial_colors_before.reserve(num_partitions);
-            num_lists_in_partition.reserve(num_partitions);
-            num_partial_colors = 0;
-            for (partition_id = 0; partition_id != num_partitions; ++partition_id) {
+            uint64_t num_partial_colors = 0;
+            for (uint64_t partition_id = 0; partition_id != num_partitions; ++partition_id) {
                 num_partial_colors_before.push_back(num_partial_colors);
-                uint64_t num_partial_colors_in_partition = hashes[partition_id].size();
+                uint64_t num_partial_colors_in_partition = num_lists_in_partition[partition_id];
                 num_partial_colors += num_partial_colors_in_partition;
-                num_lists_in_partition.push_back(num_partial_colors_in_partition);
                 std::cout << "num_partial_colors_in_partition-" << partition_id << ": "
                           << num_partial_colors_in_partition << std::endl;
             }
 
             std::cout << "total num. partial colors = " << num_partial_colors << std::endl;
 
+            const uint64_t num_integers_in_metacolors =
+                std::accumulate(thread_num_integers_in_metacolors.begin(),
+                                thread_num_integers_in_metacolors.end(), uint64_t(0));
             colors_builder.init_meta_colors_builder(num_integers_in_metacolors + num_color_sets,
                                                     num_partial_colors, p.partition_size(),
                                                     num_lists_in_partition);
 
             std::vector<uint32_t> metacolors;
+            std::vector<std::pair<uint32_t, uint32_t>> meta_color_list;
             metacolors.reserve(num_partitions);  // at most
-
-            std::ifstream metacolors_in(m_build_config.tmp_dirname + "/metacolors.bin",
-                                        std::ios::binary);
-            if (!metacolors_in.is_open()) throw std::runtime_error("error in opening file");
-
-            for (uint64_t color_set_id = 0; color_set_id != num_color_sets;
-                 ++color_set_id) {
-                assert(metacolors.empty());
-                uint32_t meta_color_list_size = 0;
-                metacolors_in.read(reinterpret_cast<char*>(&meta_color_list_size),
-                                   sizeof(uint32_t));
-                for (uint32_t i = 0; i != meta_color_list_size; ++i) {
-                    uint32_t partition_id = 0;
-                    uint32_t partial_color_id = 0;
-                    metacolors_in.read(reinterpret_cast<char*>(&partition_id), sizeof(uint32_t));
-                    metacolors_in.read(reinterpret_cast<char*>(&partial_color_id),
-                                       sizeof(uint32_t));
-                    /* transform the partial_color_id into a global id */
-                    metacolors.push_back(partial_color_id +
-                                         num_partial_colors_before[partition_id]);
+            meta_color_list.reserve(num_partitions);
+
+            for (uint64_t thread_id = 0; thread_id != num_threads; ++thread_id) {
+                metacolors_reader metacolors_in(metacolors_filename(thread_id),
+                                                thread_meta_color_list_sizes[thread_id]);
+                while (metacolors_in.has_next()) {
+                    assert(metacolors.empty());
+                    metacolors_in.next(meta_color_list);
+                    for (auto [partition_id, partial_color_id] : meta_color_list) {
+                        /* transform the partial_color_id into a global id */
+                        metacolors.push_back(
+                            to_partition_id[thread_id][partition_id][partial_color_id] +
+                            num_partial_colors_before[partition_id]);
+                    }
+                    colors_builder.process_metacolors(metacolors.data(), metacolors.size());
+                    metacolors.clear();
                 }
-                colors_builder.process_metacolors(metacolors.data(), metacolors.size());
-                metacolors.clear();
+                metacolors_in.close();
+                std::remove(metacolors_filename(thread_id).c_str());
             }
 
-            metacolors_in.close();
-            std::remove((m_build_config.tmp_dirname + "/metacolors.bin").c_str());
             colors_builder.build(idx.m_ccs);
 
             timer.stop();
@@ -319,12 +567,13 @@ struct index<ColorClasses>::meta_builder {
         }
 
         {
-            essentials::logger("step 5. copy u2c and k2u");
+            essentials::logger("step 5. move u2c and k2u");
             timer.start();
-            idx.m_u2c = index.get_u2c();
-            idx.m_k2u = index.get_k2u();
+            /* the unitigs are not permuted: u2c and k2u stay the same */
+            idx.m_u2c = std::move(index.m_u2c);
+            idx.m_k2u = std::move(index.m_k2u);
             timer.stop();
-            std::cout << "** copying u2c and k2u took " << timer.elapsed() << " seconds / "
+            std::cout << "** moving u2c and k2u took " << timer.elapsed() << " seconds / "
                       << timer.elapsed() / 60 << " minutes" << std::endl;
             timer.reset();
         }
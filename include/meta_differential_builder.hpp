@@ -1,7 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <filesystem>
 #include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
 #include "index.hpp"
+#include "layered_index.hpp"
 #include "build_util.hpp"
 
 namespace fulgor {
@@ -18,7 +25,7 @@ struct index<ColorClasses>::meta_differential_builder {
 
         meta_index_type meta_index;
         essentials::logger("step 1. loading index to be partitioned");
-        essentials::load(meta_index, m_build_config.index_filename_to_partition.c_str());
+        load_index(meta_index, m_build_config.index_filename_to_partition);
         essentials::logger("DONE");
 
         const uint64_t num_color_sets = meta_index.num_color_sets();
@@ -35,36 +42,93 @@ struct index<ColorClasses>::meta_differential_builder {
             essentials::logger("step 2. building differential partial/meta colors");
             timer.start();
 
-            std::vector<hybrid> pc = meta_index.get_color_sets().partial_colors();
+            auto const& pc = meta_index.get_color_sets().partial_colors();
             assert(pc.size() == num_partitions);
 
-            for (uint64_t i = 0; i < num_partitions; i++) {
-                std::cout << " Partition " << i << " / " << num_partitions << std::endl;
-                differential_permuter dp(m_build_config);
-                dp.permute(pc[i]);
-
-                differential::builder diff_builder;
-                diff_builder.init_colors_builder(dp.num_docs());
-
-                auto const& permutation = dp.permutation();
-                auto const& references = dp.references();
-
-                partial_permutations[i].resize(permutation.size());
-                uint64_t original_id = 0;
-
-                for (auto& reference : references) {
-                    diff_builder.encode_representative(reference); }
-                for (auto& [cluster_id, color_id] : permutation) {
-                    auto it = pc[i].color_set(color_id);
-                    diff_builder.encode_list(
-                        cluster_id, references[cluster_id], it.size(), [&it]() -> void { ++it; },
-                        [&it]() -> uint64_t { return *it; });
-                    partial_permutations[i][color_id] = original_id++;
+            /*
+                Partitions are independent of each other: they are processed concurrently,
+                by at most num_threads workers that take the next unprocessed partition,
+                from the largest to the smallest. Each partition is permuted with its share
+                of the threads (at least one), quietly if there are several workers, and
+                sketches into its own temporary directory.
+            */
+            std::vector<uint64_t> schedule(num_partitions);
+            std::iota(schedule.begin(), schedule.end(), 0);
+            std::stable_sort(schedule.begin(), schedule.end(), [&](uint64_t x, uint64_t y) {
+                return pc[x].num_bits() > pc[y].num_bits();
+            });
+
+            const uint64_t num_threads =
+                std::min<uint64_t>(m_build_config.num_threads, num_partitions);
+            build_configuration partition_build_config = m_build_config;
+            if (num_threads > 1) {
+                partition_build_config.num_threads =
+                    std::max<uint64_t>(m_build_config.num_threads / num_threads, 1);
+            }
+
+            std::vector<differential> partial_colors(num_partitions);
+            std::atomic<uint64_t> next = 0;
+            std::mutex iomut;
+
+            auto exe = [&]() {
+                while (true) {
+                    const uint64_t j = next++;
+                    if (j >= num_partitions) break;
+                    const uint64_t i = schedule[j];
+                    iomut.lock();
+                    std::cout << " Partition " << i << " / " << num_partitions << std::endl;
+                    iomut.unlock();
+
+                    build_configuration build_config = partition_build_config;
+                    build_config.tmp_dirname =
+                        m_build_config.tmp_dirname + "/partition-" + std::to_string(i);
+                    essentials::create_directory(build_config.tmp_dirname);
+
+                    differential_permuter dp(build_config, num_threads == 1);
+                    dp.permute(pc[i]);
+
+                    differential::builder diff_builder;
+                    diff_builder.init_colors_builder(dp.num_docs());
+
+                    auto const& permutation = dp.permutation();
+                    auto const& references = dp.references();
+
+                    partial_permutations[i].resize(permutation.size());
+                    uint64_t original_id = 0;
+
+                    for (auto& reference : references) {
+                        diff_builder.encode_representative(reference);
+                    }
+                    for (auto& [cluster_id, color_id] : permutation) {
+                        auto it = pc[i].color_set(color_id);
+                        diff_builder.encode_list(
+                            cluster_id, references[cluster_id], it.size(),
+                            [&it]() -> void { ++it; }, [&it]() -> uint64_t { return *it; });
+                        partial_permutations[i][color_id] = original_id++;
+                    }
+                    diff_builder.build(partial_colors[i]);
+
+                    std::error_code ec;
+                    std::filesystem::remove_all(build_config.tmp_dirname, ec);
+                    if (ec) {
+                        std::lock_guard<std::mutex> lock(iomut);
+                        std::cerr << "Warning: cannot remove the temporary directory '"
+                                  << build_config.tmp_dirname << "': " << ec.message()
+                                  << std::endl;
+                    }
                 }
-                differential d;
-                diff_builder.build(d);
-                builder.process_partition(d);
-                d.print_stats();
+            };
+
+            std::vector<std::thread> threads(num_threads);
+            for (auto& t : threads) t = std::thread(exe);
+            for (auto& t : threads) {
+                if (t.joinable()) t.join();
+            }
+
+            /* assemble the partitions in order */
+            for (uint64_t i = 0; i < num_partitions; i++) {
+                partial_colors[i].print_stats();
+                builder.process_partition(std::move(partial_colors[i]));
             }
 
             timer.stop();
@@ -151,9 +215,6 @@ struct index<ColorClasses>::meta_differential_builder {
             std::ofstream out(permuted_unitigs_filename.c_str());
             if (!out.is_open()) throw std::runtime_error("cannot open output file");
 
-            pthash::darray1 d;  // for select_1 on index.u2c
-            d.build(meta_index.get_u2c());
-
             const uint64_t num_unitigs = meta_index.get_u2c().size();
             pthash::bit_vector_builder u2c_builder(num_unitigs + 1, 0);
 
@@ -163,14 +224,8 @@ struct index<ColorClasses>::meta_differential_builder {
             uint64_t pos = 0;
             for (uint64_t new_color_id = 0; new_color_id != num_color_sets; ++new_color_id) {
                 uint64_t old_color_id = permutation[new_color_id];
-                uint64_t old_unitig_id_end = num_unitigs;
-                if (old_color_id < num_color_sets - 1) {
-                    old_unitig_id_end = d.select(meta_index.get_u2c(), old_color_id) + 1;
-                }
-                uint64_t old_unitig_id_begin = 0;
-                if (old_color_id > 0) {
-                    old_unitig_id_begin = d.select(meta_index.get_u2c(), old_color_id - 1) + 1;
-                }
+                auto [old_unitig_id_begin, old_unitig_id_end] =
+                    meta_index.get_u2c().unitigs(old_color_id);
 
                 // num. unitigs that have the same color
                 pos += old_unitig_id_end - old_unitig_id_begin;
@@ -235,6 +290,7 @@ struct index<ColorClasses>::meta_differential_builder {
             auto exe = [&](uint64_t thread_id) {
                 uint64_t l = slice_size * thread_id;
                 uint64_t r = min(slice_size * (thread_id + 1), idx.m_k2u.num_contigs());
+                std::vector<uint32_t> expected(idx.num_docs()), got(idx.num_docs());
 
                 for (uint64_t unitig_id = l; unitig_id < r; ++unitig_id) {
                     auto it = idx.get_k2u().at_contig_id(unitig_id);
@@ -253,23 +309,9 @@ struct index<ColorClasses>::meta_differential_builder {
                         uint64_t new_color_id = idx.u2c(new_contig_id);
                         uint64_t old_color_id = meta_index.u2c(old_contig_id);
 
-                        auto exp_it = meta_index.color_set(old_color_id);
-                        auto res_it = idx.color_set(new_color_id);
-                        if (res_it.size() != exp_it.size()) {
-                            std::cout << "Error while checking color " << new_color_id
-                                      << ", different sizes: expected " << exp_it.size()
-                                      << " but got " << res_it.size() << std::endl;
-                            continue;
-                        }
-                        for (uint64_t j = 0; j < exp_it.size(); ++j, ++exp_it, ++res_it) {
-                            auto exp = *exp_it;
-                            auto got = *res_it;
-                            if (exp != got) {
-                                std::cout << "Error while checking color " << new_color_id
-                                          << ", mismatch at position " << j << ": expected " << exp
-                                          << " but got " << got << std::endl;
-                            }
-                        }
+                        util::check_color_set(meta_index.color_set(old_color_id),
+                                              idx.color_set(new_color_id), new_color_id,
+                                              expected, got);
                     }
                 }
             };
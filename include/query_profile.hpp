@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace fulgor {
+
+/*
+    Access statistics of a pseudoalignment run (see option --profile-out of pseudoalign):
+    the number of accesses to each unitig id and to each color set id, the outcomes of the
+    k-mer lookups, and the histograms of the number of iterators (i.e., of distinct color
+    sets) and of the size of the intersection per read. As in intersect_unitigs, a unitig
+    (resp. a color set) is accessed once per read it occurs in.
+
+    The access counts are stored sparsely, as the sorted ids that have been accessed with
+    their counts; the histograms in log2 buckets (see log_histogram).
+*/
+struct query_profile {
+    /*
+        A histogram in logarithmic buckets: bucket 0 holds the value 0, and bucket b > 0 the
+        values in [2^(b-1), 2^b). The number, sum, and maximum of the values are kept too.
+    */
+    struct log_histogram {
+        log_histogram() : m_count(0), m_sum(0), m_max(0) {}
+
+        void add(uint64_t value) {
+            const uint64_t b = value == 0 ? 0 : 64 - __builtin_clzll(value);
+            if (b >= m_buckets.size()) m_buckets.resize(b + 1, 0);
+            m_buckets[b] += 1;
+            m_count += 1;
+            m_sum += value;
+            m_max = std::max(m_max, value);
+        }
+
+        void merge(log_histogram const& other) {
+            if (other.m_buckets.size() > m_buckets.size()) {
+                m_buckets.resize(other.m_buckets.size(), 0);
+            }
+            for (uint64_t b = 0; b != other.m_buckets.size(); ++b) {
+                m_buckets[b] += other.m_buckets[b];
+            }
+            m_count += other.m_count;
+            m_sum += other.m_sum;
+            m_max = std::max(m_max, other.m_max);
+        }
+
+        std::vector<uint64_t> const& buckets() const { return m_buckets; }
+        uint64_t count() const { return m_count; }
+        uint64_t sum() const { return m_sum; }
+        uint64_t max() const { return m_max; }
+
+        template <typename Visitor>
+        void visit(Visitor& visitor) {
+            visitor.visit(m_buckets);
+            visitor.visit(m_count);
+            visitor.visit(m_sum);
+            visitor.visit(m_max);
+        }
+
+    private:
+        std::vector<uint64_t> m_buckets;
+        uint64_t m_count, m_sum, m_max;
+    };
+
+    struct builder;
+
+    /*
+        The number of accesses to each unitig id and to each color set id, counted by all the
+        threads in 64-bit counters: (num_unitigs + num_color_sets) * 8 bytes in total.
+    */
+    struct access_counters {
+        access_counters(uint64_t num_unitigs, uint64_t num_color_sets)
+            : m_unitig_accesses(num_unitigs, 0), m_color_set_accesses(num_color_sets, 0) {}
+
+        /* the counters of the accessed ids, in sparse form, in a profile without reads */
+        void build(query_profile& profile) const {
+            profile.m_num_unitigs = m_unitig_accesses.size();
+            profile.m_num_color_sets = m_color_set_accesses.size();
+            sparsify(m_unitig_accesses, profile.m_unitig_ids, profile.m_unitig_counts);
+            sparsify(m_color_set_accesses, profile.m_color_set_ids, profile.m_color_set_counts);
+        }
+
+    private:
+        friend struct builder;
+        std::mutex m_mutex;
+        std::vector<uint64_t> m_unitig_accesses;
+        std::vector<uint64_t> m_color_set_accesses;
+
+        static void sparsify(std::vector<uint64_t> const& accesses, std::vector<uint32_t>& ids,
+                             std::vector<uint64_t>& counts) {
+            ids.clear();
+            counts.clear();
+            for (uint64_t id = 0; id != accesses.size(); ++id) {
+                if (accesses[id] == 0) continue;
+                ids.push_back(id);
+                counts.push_back(accesses[id]);
+            }
+        }
+    };
+
+    /*
+        Collects the statistics of one thread. The ids accessed by its reads are buffered and
+        added to the shared access_counters in batches of batch_size ids, so that recording a
+        read takes no synchronization but once per batch.
+    */
+    struct builder {
+        static constexpr uint64_t batch_size = 1 << 16;
+
+        builder() : m_counters(nullptr) {}
+
+        builder(access_counters& counters) : m_counters(&counters) {}
+
+        /* num_kmers k-mers in the read, of which num_hits (resp. num_misses) were looked up
+           and found (resp. not found); the others were skipped */
+        void add_kmers(uint64_t num_kmers, uint64_t num_hits, uint64_t num_misses) {
+            m_num_kmers += num_kmers;
+            m_num_hits += num_hits;
+            m_num_misses += num_misses;
+        }
+
+        /* Deduplicate unitig_ids (in place) and record the accesses to the unitigs and to
+           their color sets. Return the number of distinct color sets. */
+        template <typename Index>
+        uint64_t add_unitigs(Index const& index, std::vector<uint64_t>& unitig_ids) {
+            assert(m_counters);
+            std::sort(unitig_ids.begin(), unitig_ids.end());
+            unitig_ids.erase(std::unique(unitig_ids.begin(), unitig_ids.end()), unitig_ids.end());
+            m_color_set_ids.clear();
+            for (uint64_t unitig_id : unitig_ids) {
+                assert(unitig_id < m_counters->m_unitig_accesses.size());
+                m_unitig_batch.push_back(unitig_id);
+                m_color_set_ids.push_back(index.u2c(unitig_id));
+            }
+            std::sort(m_color_set_ids.begin(), m_color_set_ids.end());
+            m_color_set_ids.erase(std::unique(m_color_set_ids.begin(), m_color_set_ids.end()),
+                                  m_color_set_ids.end());
+            for (uint64_t color_set_id : m_color_set_ids) {
+                assert(color_set_id < m_counters->m_color_set_accesses.size());
+                m_color_set_batch.push_back(color_set_id);
+            }
+            if (m_unitig_batch.size() >= batch_size or m_color_set_batch.size() >= batch_size) {
+                flush();
+            }
+            return m_color_set_ids.size();
+        }
+
+        void add_read(uint64_t num_iterators, uint64_t intersection_size) {
+            m_num_reads += 1;
+            m_num_iterators.add(num_iterators);
+            m_intersection_sizes.add(intersection_size);
+        }
+
+        /* add the buffered accesses to the shared counters */
+        void flush() {
+            if (m_unitig_batch.empty() and m_color_set_batch.empty()) return;
+            std::lock_guard<std::mutex> lock(m_counters->m_mutex);
+            for (uint32_t id : m_unitig_batch) m_counters->m_unitig_accesses[id] += 1;
+            for (uint32_t id : m_color_set_batch) m_counters->m_color_set_accesses[id] += 1;
+            m_unitig_batch.clear();
+            m_color_set_batch.clear();
+        }
+
+        /* the statistics of the thread, but the access counts: these are all in the
+           shared access_counters (see access_counters::build) once flushed */
+        void build(query_profile& profile) {
+            flush();
+            profile.m_num_reads = m_num_reads;
+            profile.m_num_kmers = m_num_kmers;
+            profile.m_num_hits = m_num_hits;
+            profile.m_num_misses = m_num_misses;
+            profile.m_num_unitigs = m_counters->m_unitig_accesses.size();
+            profile.m_num_color_sets = m_counters->m_color_set_accesses.size();
+            profile.m_num_iterators = m_num_iterators;
+            profile.m_intersection_sizes = m_intersection_sizes;
+        }
+
+    private:
+        access_counters* m_counters;
+        uint64_t m_num_reads = 0;
+        uint64_t m_num_kmers = 0;
+        uint64_t m_num_hits = 0;
+        uint64_t m_num_misses = 0;
+        std::vector<uint32_t> m_unitig_batch;
+        std::vector<uint32_t> m_color_set_batch;
+        log_histogram m_num_iterators;
+        log_histogram m_intersection_sizes;
+        std::vector<uint64_t> m_color_set_ids;  // of the current read
+    };
+
+    query_profile()
+        : m_num_reads(0)
+        , m_num_kmers(0)
+        , m_num_hits(0)
+        , m_num_misses(0)
+        , m_num_unitigs(0)
+        , m_num_color_sets(0) {}
+
+    /* add the statistics of other, collected on the same index, to this profile */
+    void merge(query_profile const& other) {
+        if (empty()) {
+            m_num_unitigs = other.m_num_unitigs;
+            m_num_color_sets = other.m_num_color_sets;
+        }
+        if (other.m_num_unitigs != m_num_unitigs or other.m_num_color_sets != m_num_color_sets) {
+            throw std::runtime_error("profiles of different indexes cannot be merged");
+        }
+        m_num_reads += other.m_num_reads;
+        m_num_kmers += other.m_num_kmers;
+        m_num_hits += other.m_num_hits;
+        m_num_misses += other.m_num_misses;
+        merge(m_unitig_ids, m_unitig_counts, other.m_unitig_ids, other.m_unitig_counts);
+        merge(m_color_set_ids, m_color_set_counts, other.m_color_set_ids,
+              other.m_color_set_counts);
+        m_num_iterators.merge(other.m_num_iterators);
+        m_intersection_sizes.merge(other.m_intersection_sizes);
+    }
+
+    bool empty() const { return m_num_reads == 0 and m_num_unitigs == 0; }
+
+    uint64_t num_reads() const { return m_num_reads; }
+    uint64_t num_kmers() const { return m_num_kmers; }
+    uint64_t num_hits() const { return m_num_hits; }
+    uint64_t num_misses() const { return m_num_misses; }
+
+    /* the k-mers that were not looked up: the kallisto heuristic might look a k-mer up
+       twice, hence the clamp */
+    uint64_t num_skipped() const {
+        return m_num_kmers - std::min(m_num_kmers, m_num_hits + m_num_misses);
+    }
+
+    uint64_t num_unitigs() const { return m_num_unitigs; }
+    uint64_t num_color_sets() const { return m_num_color_sets; }
+
+    std::vector<uint32_t> const& unitig_ids() const { return m_unitig_ids; }
+    std::vector<uint64_t> const& unitig_counts() const { return m_unitig_counts; }
+    std::vector<uint32_t> const& color_set_ids() const { return m_color_set_ids; }
+    std::vector<uint64_t> const& color_set_counts() const { return m_color_set_counts; }
+
+    /* the number of iterators, resp. the intersection size, of the reads */
+    log_histogram const& num_iterators() const { return m_num_iterators; }
+    log_histogram const& intersection_sizes() const { return m_intersection_sizes; }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_num_reads);
+        visitor.visit(m_num_kmers);
+        visitor.visit(m_num_hits);
+        visitor.visit(m_num_misses);
+        visitor.visit(m_num_unitigs);
+        visitor.visit(m_num_color_sets);
+        visitor.visit(m_unitig_ids);
+        visitor.visit(m_unitig_counts);
+        visitor.visit(m_color_set_ids);
+        visitor.visit(m_color_set_counts);
+        visitor.visit(m_num_iterators);
+        visitor.visit(m_intersection_sizes);
+    }
+
+private:
+    uint64_t m_num_reads;
+    uint64_t m_num_kmers;
+    uint64_t m_num_hits;
+    uint64_t m_num_misses;
+    uint64_t m_num_unitigs;
+    uint64_t m_num_color_sets;
+    std::vector<uint32_t> m_unitig_ids;
+    std::vector<uint64_t> m_unitig_counts;
+    std::vector<uint32_t> m_color_set_ids;
+    std::vector<uint64_t> m_color_set_counts;
+    log_histogram m_num_iterators;
+    log_histogram m_intersection_sizes;
+
+    static void merge(std::vector<uint32_t>& ids, std::vector<uint64_t>& counts,
+                      std::vector<uint32_t> const& other_ids,
+                      std::vector<uint64_t> const& other_counts) {
+        std::vector<uint32_t> merged_ids;
+        std::vector<uint64_t> merged_counts;
+        merged_ids.reserve(ids.size() + other_ids.size());
+        merged_counts.reserve(ids.size() + other_ids.size());
+        uint64_t i = 0, j = 0;
+        while (i != ids.size() or j != other_ids.size()) {
+            if (j == other_ids.size() or (i != ids.size() and ids[i] < other_ids[j])) {
+                merged_ids.push_back(ids[i]);
+                merged_counts.push_back(counts[i++]);
+            } else if (i == ids.size() or other_ids[j] < ids[i]) {
+                merged_ids.push_back(other_ids[j]);
+                merged_counts.push_back(other_counts[j++]);
+            } else {
+                merged_ids.push_back(ids[i]);
+                merged_counts.push_back(counts[i++] + other_counts[j++]);
+            }
+        }
+        ids.swap(merged_ids);
+        counts.swap(merged_counts);
+    }
+};
+
+}  // namespace fulgor
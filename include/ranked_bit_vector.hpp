@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdexcept>
 #include <vector>
 
 #include "external/sshash/external/pthash/external/essentials/include/essentials.hpp"
@@ -97,4 +98,138 @@ protected:
     std::vector<uint64_t> m_block_rank_pairs;
 };
 
+/*
+    A bit vector with rank and select, where the rank samples are interleaved
+    with the bits: every block is a 64-byte cache line made of one header word
+    and 7 words of bits. The header stores the number of ones before the block
+    (in its low 37 bits) and the number of ones in the block before its words
+    2, 4 and 6 (9 bits each). So a rank query touches a single cache line, and
+    takes at most two popcounts. (The layout of ranked_bit_vector instead needs
+    a line of bits and a line of rank samples.)
+
+    Select first jumps to the block of a sampled one, every select_sample_rate
+    ones, then binary searches the blocks by their header.
+*/
+struct interleaved_ranked_bit_vector {
+    static constexpr uint64_t words_per_block = 7;
+    static constexpr uint64_t bits_per_block = words_per_block * 64;
+    static constexpr uint64_t rank_bits = 37;
+    static constexpr uint64_t rank_mask = (uint64_t(1) << rank_bits) - 1;
+    static constexpr uint64_t select_sample_rate = 1024;
+
+    struct alignas(64) block {
+        uint64_t header;
+        uint64_t bits[words_per_block];
+    };
+
+    interleaved_ranked_bit_vector() : m_size(0), m_num_ones(0) {}
+
+    void build(pthash::bit_vector_builder* bvb) {
+        pthash::bit_vector bv;
+        bv.build(bvb);
+        auto const& words = bv.data();
+        m_size = bv.size();
+        m_num_ones = 0;
+
+        const uint64_t num_blocks = (words.size() + words_per_block - 1) / words_per_block;
+        std::vector<block> blocks(num_blocks);
+        std::vector<uint64_t> select_samples;
+        for (uint64_t b = 0; b != num_blocks; ++b) {
+            block& bl = blocks[b];
+            if (m_num_ones > rank_mask) {
+                throw std::runtime_error("interleaved_ranked_bit_vector: too many ones");
+            }
+            bl.header = m_num_ones;
+            uint64_t ones_in_block = 0;
+            for (uint64_t w = 0; w != words_per_block; ++w) {
+                const uint64_t i = b * words_per_block + w;
+                bl.bits[w] = i < words.size() ? words[i] : 0;
+                if (w != 0 and w % 2 == 0) {
+                    bl.header |= ones_in_block << (rank_bits + 9 * (w / 2 - 1));
+                }
+                const uint64_t pop = pthash::util::popcount(bl.bits[w]);
+                /* the block holds the (j * select_sample_rate)-th one, for some j */
+                uint64_t next_sample = select_samples.size() * select_sample_rate;
+                if (next_sample < m_num_ones + ones_in_block + pop) select_samples.push_back(b);
+                ones_in_block += pop;
+            }
+            m_num_ones += ones_in_block;
+        }
+        m_blocks.swap(blocks);
+        m_select_samples.swap(select_samples);
+    }
+
+    uint64_t size() const { return m_size; }
+    uint64_t num_ones() const { return m_num_ones; }
+    uint64_t num_zeros() const { return size() - num_ones(); }
+
+    /* return the number of ones in A[0..pos) */
+    inline uint64_t rank(uint64_t pos) const {
+        assert(pos <= size());
+        if (pos == size()) return num_ones();
+        block const& bl = m_blocks[pos / bits_per_block];
+        const uint64_t offset = pos % bits_per_block;
+        const uint64_t w = offset / 64;
+        uint64_t r = bl.header & rank_mask;
+        if (w >= 2) r += (bl.header >> (rank_bits + 9 * (w / 2 - 1))) & 0x1FF;
+        if (w & 1) r += pthash::util::popcount(bl.bits[w - 1]);
+        const uint64_t left = offset % 64;
+        if (left) r += pthash::util::popcount(bl.bits[w] << (64 - left));
+        return r;
+    }
+
+    /* return the position of the i-th one */
+    uint64_t select(uint64_t i) const {
+        assert(i < num_ones());
+        const uint64_t sample = i / select_sample_rate;
+        uint64_t lo = m_select_samples[sample];
+        uint64_t hi = sample + 1 < m_select_samples.size() ? m_select_samples[sample + 1] + 1
+                                                           : m_blocks.size();
+        /* the last block in [lo, hi) with less than i+1 ones before it */
+        while (hi - lo > 1) {
+            uint64_t mid = (lo + hi) / 2;
+            if ((m_blocks[mid].header & rank_mask) <= i) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        block const& bl = m_blocks[lo];
+        uint64_t k = i - (bl.header & rank_mask);
+        uint64_t w = 0;
+        for (uint64_t j = 3; j != 0; --j) {
+            const uint64_t sub_rank = (bl.header >> (rank_bits + 9 * (j - 1))) & 0x1FF;
+            if (sub_rank <= k) {
+                w = 2 * j;
+                k -= sub_rank;
+                break;
+            }
+        }
+        const uint64_t pop = pthash::util::popcount(bl.bits[w]);
+        if (k >= pop) {
+            k -= pop;
+            w += 1;
+        }
+        return lo * bits_per_block + w * 64 + pthash::util::select_in_word(bl.bits[w], k);
+    }
+
+    uint64_t bytes() const {
+        return sizeof(m_size) + sizeof(m_num_ones) + essentials::vec_bytes(m_blocks) +
+               essentials::vec_bytes(m_select_samples);
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_size);
+        visitor.visit(m_num_ones);
+        visitor.visit(m_blocks);
+        visitor.visit(m_select_samples);
+    }
+
+private:
+    uint64_t m_size, m_num_ones;
+    std::vector<block> m_blocks;  // 64-byte aligned, since block is
+    std::vector<uint64_t> m_select_samples;
+};
+
 }  // namespace fulgor
\ No newline at end of file
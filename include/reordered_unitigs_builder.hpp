@@ -0,0 +1,307 @@
+#pragma once
+
+#include <numeric>
+#include <thread>
+
+#include "index.hpp"
+
+namespace fulgor {
+
+/*
+    Rebuild an index renumbering its unitigs, so that unitigs that are adjacent in the
+    de Bruijn graph get close ids: then consecutive k-mers of a read, which often fall on
+    adjacent unitigs, hit nearby memory in the k2u and u2c maps.
+
+    The unitigs of a color set must have consecutive ids (u2c is a rank over the last
+    unitig of each color set), so the unitigs are visited in depth-first order over the
+    graph and each color set keeps its unitigs in order of visit. For hybrid color sets,
+    which can be stored in any order, also the color sets are renumbered in order of
+    first visit. The other color classes group the color sets by partition or cluster,
+    so their color set ids are kept and only the unitigs within each color set are sorted.
+*/
+template <typename ColorClasses>
+struct index<ColorClasses>::reordered_unitigs_builder {
+    reordered_unitigs_builder() {}
+
+    reordered_unitigs_builder(build_configuration const& build_config)
+        : m_build_config(build_config) {}
+
+    void build(index& from, index& idx) {
+        if (idx.m_k2u.size() != 0) throw std::runtime_error("index already built");
+
+        essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+
+        auto const& dict = from.get_k2u();
+        const uint64_t num_unitigs = from.num_unitigs();
+        const uint64_t num_color_sets = from.num_color_sets();
+        constexpr bool renumber_color_sets = std::is_same_v<ColorClasses, hybrid>;
+
+        std::vector<uint64_t> adjacency_offsets;
+        std::vector<uint32_t> adjacency;
+        {
+            essentials::logger("step 2. computing the adjacency of the unitigs");
+            timer.start();
+            compute_adjacency(dict, adjacency_offsets, adjacency);
+            timer.stop();
+            std::cout << "** computing the adjacency took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        /* old color set ids, in new order, and the old unitig ids, in new order */
+        std::vector<uint32_t> color_sets_order;
+        std::vector<uint32_t> unitigs_order;
+        {
+            essentials::logger("step 3. ordering the unitigs");
+            timer.start();
+
+            std::vector<uint32_t> visit_order;
+            visit_order.reserve(num_unitigs);
+            {
+                std::vector<bool> visited(num_unitigs, false);
+                std::vector<uint32_t> stack;
+                for (uint64_t root = 0; root != num_unitigs; ++root) {
+                    if (visited[root]) continue;
+                    stack.push_back(root);
+                    visited[root] = true;
+                    while (!stack.empty()) {
+                        uint32_t u = stack.back();
+                        stack.pop_back();
+                        visit_order.push_back(u);
+                        for (uint64_t i = adjacency_offsets[u + 1]; i != adjacency_offsets[u];) {
+                            uint32_t v = adjacency[--i];
+                            if (visited[v]) continue;
+                            visited[v] = true;
+                            stack.push_back(v);
+                        }
+                    }
+                }
+            }
+            std::vector<uint32_t>().swap(adjacency);
+            std::vector<uint64_t>().swap(adjacency_offsets);
+
+            std::vector<uint32_t> color_set_ids(num_unitigs);
+            std::vector<uint64_t> color_set_offsets(num_color_sets + 1, 0);
+            for (uint64_t unitig_id = 0; unitig_id != num_unitigs; ++unitig_id) {
+                color_set_ids[unitig_id] = from.u2c(unitig_id);
+                color_set_offsets[color_set_ids[unitig_id] + 1] += 1;
+            }
+            std::partial_sum(color_set_offsets.begin(), color_set_offsets.end(),
+                             color_set_offsets.begin());
+
+            /* the unitigs of each color set, in order of visit */
+            std::vector<uint32_t> unitigs_by_color_set(num_unitigs);
+            {
+                auto pos = color_set_offsets;  // copy
+                for (uint32_t u : visit_order) unitigs_by_color_set[pos[color_set_ids[u]]++] = u;
+            }
+
+            color_sets_order.reserve(num_color_sets);
+            if constexpr (renumber_color_sets) {
+                std::vector<bool> seen(num_color_sets, false);
+                for (uint32_t u : visit_order) {
+                    uint32_t color_set_id = color_set_ids[u];
+                    if (seen[color_set_id]) continue;
+                    seen[color_set_id] = true;
+                    color_sets_order.push_back(color_set_id);
+                }
+            } else {
+                for (uint64_t i = 0; i != num_color_sets; ++i) color_sets_order.push_back(i);
+            }
+            assert(color_sets_order.size() == num_color_sets);
+
+            unitigs_order.reserve(num_unitigs);
+            for (uint32_t color_set_id : color_sets_order) {
+                unitigs_order.insert(unitigs_order.end(),
+                                     unitigs_by_color_set.begin() + color_set_offsets[color_set_id],
+                                     unitigs_by_color_set.begin() +
+                                         color_set_offsets[color_set_id + 1]);
+            }
+            assert(unitigs_order.size() == num_unitigs);
+
+            timer.stop();
+            std::cout << "** ordering the unitigs took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        {
+            essentials::logger("step 4. permute unitigs and rebuild sshash");
+            timer.start();
+
+            const std::string permuted_unitigs_filename =
+                m_build_config.tmp_dirname + "/permuted_unitigs.fa";
+            std::ofstream out(permuted_unitigs_filename.c_str());
+            if (!out.is_open()) throw std::runtime_error("cannot open output file");
+
+            pthash::bit_vector_builder u2c_builder(num_unitigs + 1, 0);
+            const uint64_t k = dict.k();
+            for (uint64_t new_unitig_id = 0; new_unitig_id != num_unitigs; ++new_unitig_id) {
+                const uint32_t old_unitig_id = unitigs_order[new_unitig_id];
+                const bool last_of_color_set =
+                    new_unitig_id == num_unitigs - 1 or
+                    from.u2c(unitigs_order[new_unitig_id + 1]) != from.u2c(old_unitig_id);
+                if (last_of_color_set) u2c_builder.set(new_unitig_id, 1);
+
+                auto it = dict.at_contig_id(old_unitig_id);
+                out << ">\n";
+                auto [_, kmer] = it.next();
+                out << kmer;
+                while (it.has_next()) {
+                    auto [_, kmer] = it.next();
+                    out << kmer[k - 1];  // overlaps!
+                }
+                out << '\n';
+            }
+            out.close();
+            idx.m_u2c.build(&u2c_builder);
+
+            /* build a new sshash::dictionary on the permuted unitigs */
+            sshash::build_configuration sshash_config;
+            sshash_config.k = dict.k();
+            sshash_config.m = dict.m();
+            sshash_config.canonical_parsing = dict.canonicalized();
+            sshash_config.verbose = m_build_config.verbose;
+            sshash_config.tmp_dirname = m_build_config.tmp_dirname;
+            sshash_config.print();
+            idx.m_k2u.build(permuted_unitigs_filename, sshash_config);
+            assert(idx.get_k2u().size() == dict.size());
+            try {  // remove unitig file
+                std::remove(permuted_unitigs_filename.c_str());
+            } catch (std::exception const& e) { std::cerr << e.what() << std::endl; }
+
+            timer.stop();
+            std::cout << "** permuting unitigs and rebuilding sshash took " << timer.elapsed()
+                      << " seconds / " << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        {
+            essentials::logger("step 5. building colors");
+            timer.start();
+            if constexpr (renumber_color_sets) {
+                /* keep the thresholds of the index, which may have been calibrated */
+                typename ColorClasses::builder colors_builder(
+                    from.num_docs(), from.m_ccs.sparse_set_threshold_size(),
+                    from.m_ccs.very_dense_set_threshold_size());
+                std::vector<uint32_t> list;
+                for (uint32_t color_set_id : color_sets_order) {
+                    auto it = from.color_set(color_set_id);
+                    const uint64_t size = it.size();
+                    list.resize(size);
+                    it.decode(list.data());
+                    colors_builder.process(list.data(), list.size());
+                }
+                colors_builder.build(idx.m_ccs);
+                if (!from.m_ccs.sizes().empty()) idx.m_ccs.build_color_set_sizes();
+            } else {
+                idx.m_ccs = std::move(from.m_ccs);
+            }
+            idx.m_filenames = std::move(from.m_filenames);
+            timer.stop();
+            std::cout << "** building colors took " << timer.elapsed() << " seconds / "
+                      << timer.elapsed() / 60 << " minutes" << std::endl;
+            timer.reset();
+        }
+
+        if (m_build_config.check) {
+            essentials::logger("step 6. check correctness...");
+            std::vector<uint32_t> expected(from.num_docs()), got(from.num_docs());
+            for (uint64_t new_color_set_id = 0; new_color_set_id != num_color_sets;
+                 ++new_color_set_id) {
+                const uint32_t old_color_set_id = color_sets_order[new_color_set_id];
+                if (old_color_set_id == new_color_set_id) continue;  // not renumbered
+                util::check_color_set(from.color_set(old_color_set_id),
+                                      idx.color_set(new_color_set_id), new_color_set_id,
+                                      expected, got);
+            }
+            std::cout << " COLORS DONE." << std::endl;
+
+            for (uint64_t new_unitig_id = 0; new_unitig_id != num_unitigs; ++new_unitig_id) {
+                const uint32_t old_unitig_id = unitigs_order[new_unitig_id];
+                const uint64_t expected = from.u2c(old_unitig_id);
+                const uint64_t got = color_sets_order[idx.u2c(new_unitig_id)];
+                if (expected != got) {
+                    std::cout << "Error while checking unitig " << new_unitig_id
+                              << ": expected color set " << expected << " but got " << got
+                              << std::endl;
+                }
+            }
+            std::cout << " UNITIGS DONE." << std::endl;
+        }
+    }
+
+private:
+    build_configuration m_build_config;
+
+    /*
+        Two unitigs are adjacent if the last k-mer of one overlaps the first k-mer of the
+        other by k-1 symbols, in any orientation. The k-mers that could follow the last
+        k-mer and precede the first k-mer of each unitig are looked up in the dictionary.
+    */
+    void compute_adjacency(sshash::dictionary const& dict, std::vector<uint64_t>& offsets,
+                           std::vector<uint32_t>& adjacency) const {
+        const uint64_t num_unitigs = dict.num_contigs();
+        const uint64_t k = dict.k();
+        const uint64_t num_threads =
+            std::max<uint64_t>(1, std::min<uint64_t>(m_build_config.num_threads, num_unitigs));
+        constexpr char bases[] = {'A', 'C', 'G', 'T'};
+
+        /* at most 8 neighbors per unitig */
+        constexpr uint64_t max_degree = 8;
+        std::vector<uint32_t> slots(num_unitigs * max_degree);
+        std::vector<uint8_t> degrees(num_unitigs, 0);
+        auto exe = [&](uint64_t begin, uint64_t end) {
+            std::string first, last, kmer;
+            for (uint64_t u = begin; u != end; ++u) {
+                auto it = dict.at_contig_id(u);
+                {
+                    auto x = it.next();
+                    first = x.second.substr(0, k);
+                }
+                last = first;
+                while (it.has_next()) {
+                    auto x = it.next();
+                    last.swap(x.second);
+                }
+                uint32_t* n = slots.data() + u * max_degree;
+                uint64_t degree = 0;
+                auto add = [&](std::string const& kmer) {
+                    auto answer = dict.lookup_advanced(kmer.c_str());
+                    if (answer.kmer_id == sshash::constants::invalid_uint64) return;
+                    if (answer.contig_id == u) return;
+                    if (std::find(n, n + degree, answer.contig_id) != n + degree) return;
+                    n[degree++] = answer.contig_id;
+                };
+                for (char c : bases) {
+                    kmer.assign(last, 1, k - 1);
+                    kmer.push_back(c);
+                    add(kmer);
+                    kmer.assign(1, c);
+                    kmer.append(first, 0, k - 1);
+                    add(kmer);
+                }
+                std::sort(n, n + degree);
+                degrees[u] = degree;
+            }
+        };
+        std::vector<std::thread> threads(num_threads);
+        const uint64_t num_unitigs_per_thread = (num_unitigs + num_threads - 1) / num_threads;
+        for (uint64_t t = 0; t != num_threads; ++t) {
+            uint64_t begin = std::min(t * num_unitigs_per_thread, num_unitigs);
+            uint64_t end = std::min(begin + num_unitigs_per_thread, num_unitigs);
+            threads[t] = std::thread(exe, begin, end);
+        }
+        for (auto& t : threads) t.join();
+
+        offsets.assign(num_unitigs + 1, 0);
+        for (uint64_t u = 0; u != num_unitigs; ++u) offsets[u + 1] = offsets[u] + degrees[u];
+        adjacency.resize(offsets.back());
+        for (uint64_t u = 0; u != num_unitigs; ++u) {
+            std::copy(slots.begin() + u * max_degree, slots.begin() + u * max_degree + degrees[u],
+                      adjacency.begin() + offsets[u]);
+        }
+    }
+};
+
+}  // namespace fulgor
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <type_traits>
+
+#include "index.hpp"
+#include "layered_index.hpp"
+
+namespace fulgor {
+
+/*
+    The manifest of a sharded index: the filenames of N independent Fulgor indexes,
+    built over disjoint sets of references, and the mapping from global doc ids
+    to (shard, local doc id). Shard i holds the global doc ids in the range
+    [doc_offset(i), doc_offset(i+1)), in the same order as its local doc ids.
+*/
+struct shards_manifest {
+    void build(std::vector<std::string> const& shard_filenames,
+               std::vector<uint32_t> const& num_docs_in_shards) {
+        assert(shard_filenames.size() == num_docs_in_shards.size());
+        m_shard_filenames.build(shard_filenames);
+        m_doc_offsets.clear();
+        m_doc_offsets.reserve(num_docs_in_shards.size() + 1);
+        m_doc_offsets.push_back(0);
+        for (auto n : num_docs_in_shards) m_doc_offsets.push_back(m_doc_offsets.back() + n);
+    }
+
+    std::string_view shard_filename(uint64_t shard_id) const {
+        assert(shard_id < num_shards());
+        return m_shard_filenames.filename(shard_id);
+    }
+
+    uint32_t doc_offset(uint64_t shard_id) const {
+        assert(shard_id <= num_shards());
+        return m_doc_offsets[shard_id];
+    }
+
+    uint32_t num_docs_in_shard(uint64_t shard_id) const {
+        return doc_offset(shard_id + 1) - doc_offset(shard_id);
+    }
+
+    /* from global doc_id to (shard_id, local doc_id) */
+    std::pair<uint64_t, uint64_t> locate(uint64_t doc_id) const {
+        assert(doc_id < num_docs());
+        auto it = std::upper_bound(m_doc_offsets.begin(), m_doc_offsets.end(), doc_id);
+        uint64_t shard_id = std::distance(m_doc_offsets.begin(), it) - 1;
+        return {shard_id, doc_id - m_doc_offsets[shard_id]};
+    }
+
+    uint64_t num_shards() const { return m_shard_filenames.num_docs(); }
+    uint64_t num_docs() const { return m_doc_offsets.back(); }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_shard_filenames);
+        visitor.visit(m_doc_offsets);
+    }
+
+private:
+    filenames m_shard_filenames;
+    std::vector<uint32_t> m_doc_offsets;
+};
+
+/*
+    A set of indexes of the same type, queried as a single index over the union of
+    their references. Only the manifest is serialized: the shards are loaded from
+    their own files, so that each shard can be rebuilt independently of the others.
+*/
+template <typename Index>
+struct sharded_index {
+    typedef Index shard_type;
+
+    void pseudoalign_full_intersection(std::string const& sequence,
+                                       std::vector<uint32_t>& results) const;
+    void pseudoalign_threshold_union(std::string const& sequence, std::vector<uint32_t>& results,
+                                     const double threshold) const;
+
+    std::string_view filename(uint64_t doc_id) const {
+        auto [shard_id, local_doc_id] = m_manifest.locate(doc_id);
+        return m_shards[shard_id].filename(local_doc_id);
+    }
+
+    void print_stats() const {
+        std::cout << "num. shards: " << num_shards() << '\n';
+        std::cout << "num. references: " << num_docs() << '\n';
+        for (uint64_t i = 0; i != num_shards(); ++i) {
+            std::cout << "=== shard " << i << ": '" << m_manifest.shard_filename(i)
+                      << "' (doc ids " << m_manifest.doc_offset(i) << ".."
+                      << m_manifest.doc_offset(i + 1) << ")\n";
+            m_shards[i].print_stats();
+        }
+    }
+
+    uint64_t k() const { return m_shards.front().k(); }
+    uint64_t num_docs() const { return m_manifest.num_docs(); }
+    uint64_t num_shards() const { return m_manifest.num_shards(); }
+
+    Index const& shard(uint64_t shard_id) const {
+        assert(shard_id < num_shards());
+        return m_shards[shard_id];
+    }
+    shards_manifest const& manifest() const { return m_manifest; }
+
+    /* load the manifest and then each shard from its own file */
+    void load(std::string const& manifest_filename) {
+        essentials::load(m_manifest, manifest_filename.c_str());
+        load_shards();
+    }
+
+    uint64_t num_bits() const {
+        uint64_t n = 0;
+        for (auto const& s : m_shards) n += s.num_bits();
+        return n;
+    }
+
+private:
+    shards_manifest m_manifest;
+    std::vector<Index> m_shards;
+
+    void load_shards() {
+        m_shards.resize(num_shards());
+        for (uint64_t i = 0; i != num_shards(); ++i) {
+            std::string shard_filename(m_manifest.shard_filename(i));
+            essentials::logger("loading shard '" + shard_filename + "'...");
+            load_index(m_shards[i], shard_filename);
+            if (m_shards[i].num_docs() != m_manifest.num_docs_in_shard(i)) {
+                throw std::runtime_error("shard '" + shard_filename +
+                                         "' does not match the manifest: was it rebuilt over "
+                                         "a different set of references?");
+            }
+            if (m_shards[i].k() != m_shards.front().k()) {
+                throw std::runtime_error("all shards must be built with the same k");
+            }
+        }
+    }
+};
+
+template <typename Index>
+void load_index(sharded_index<Index>& index, std::string const& filename) {
+    index.load(filename);
+}
+
+template <typename T>
+struct is_sharded_index : std::false_type {};
+
+template <typename Index>
+struct is_sharded_index<sharded_index<Index>> : std::true_type {};
+
+}  // namespace fulgor
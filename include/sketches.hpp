@@ -0,0 +1,151 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "clustering.hpp"
+
+namespace fulgor {
+
+namespace constants {
+constexpr uint64_t sketch_matrix_magic = 0x314d4b5453474c46;  // "FLGSTKM1" in little endian
+constexpr uint64_t sketch_matrix_row_alignment = 64;          // a cache line
+constexpr uint64_t sketch_matrix_data_alignment = 4096;       // a page
+}  // namespace constants
+
+/*
+    A matrix of num_points sketches of num_bytes_per_point bytes each.
+    The file stores the header, then num_ids 64-bit ids (e.g., the color set
+    ids of the sketches, or none), then the sketches starting at data_offset,
+    one every stride bytes. Both data_offset and stride are aligned, so that
+    the sketches can be read in place from a memory-mapped file.
+*/
+struct sketch_matrix_header {
+    sketch_matrix_header() {}
+
+    sketch_matrix_header(uint64_t num_bytes_per_point, uint64_t num_points, uint64_t num_ids)
+        : magic(constants::sketch_matrix_magic)
+        , num_bytes_per_point(num_bytes_per_point)
+        , num_points(num_points)
+        , num_ids(num_ids) {
+        stride = align(num_bytes_per_point, constants::sketch_matrix_row_alignment);
+        data_offset = align(sizeof(sketch_matrix_header) + num_ids * sizeof(uint64_t),
+                            constants::sketch_matrix_data_alignment);
+    }
+
+    uint64_t file_size() const { return data_offset + num_points * stride; }
+
+    uint64_t magic = 0;
+    uint64_t num_bytes_per_point = 0;
+    uint64_t num_points = 0;
+    uint64_t num_ids = 0;
+    uint64_t stride = 0;
+    uint64_t data_offset = 0;
+
+private:
+    static uint64_t align(uint64_t x, uint64_t alignment) {
+        return (x + alignment - 1) / alignment * alignment;
+    }
+};
+
+/* Write the sketches one after the other, after the ids (if any). */
+struct sketch_matrix_writer {
+    sketch_matrix_writer(std::string const& filename, uint64_t num_bytes_per_point,
+                         uint64_t num_points, std::vector<uint64_t> const& ids = {})
+        : m_header(num_bytes_per_point, num_points, ids.size())
+        , m_num_written_points(0)
+        , m_out(filename, std::ios::binary) {
+        if (!m_out.is_open()) throw std::runtime_error("cannot open file '" + filename + "'");
+        assert(ids.empty() or ids.size() == num_points);
+        m_out.write(reinterpret_cast<char const*>(&m_header), sizeof(sketch_matrix_header));
+        m_out.write(reinterpret_cast<char const*>(ids.data()), ids.size() * sizeof(uint64_t));
+        pad(m_header.data_offset - sizeof(sketch_matrix_header) - ids.size() * sizeof(uint64_t));
+    }
+
+    void write(uint8_t const* point) {
+        assert(m_num_written_points < m_header.num_points);
+        m_out.write(reinterpret_cast<char const*>(point), m_header.num_bytes_per_point);
+        pad(m_header.stride - m_header.num_bytes_per_point);
+        m_num_written_points += 1;
+    }
+
+    void close() {
+        if (m_num_written_points != m_header.num_points) {
+            throw std::runtime_error("sketch matrix: wrong number of sketches written");
+        }
+        m_out.close();
+    }
+
+private:
+    sketch_matrix_header m_header;
+    uint64_t m_num_written_points;
+    std::ofstream m_out;
+
+    void pad(uint64_t num_bytes) {
+        static const char zeros[constants::sketch_matrix_data_alignment] = {0};
+        assert(num_bytes <= constants::sketch_matrix_data_alignment);
+        m_out.write(zeros, num_bytes);
+    }
+};
+
+/* A read-only memory mapping of a sketch matrix file. */
+struct mmapped_sketch_matrix {
+    mmapped_sketch_matrix(std::string const& filename) : m_data(nullptr), m_size(0) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1) throw std::runtime_error("cannot open file '" + filename + "'");
+        struct stat st;
+        if (::fstat(fd, &st) == -1 or st.st_size < (off_t)sizeof(sketch_matrix_header)) {
+            ::close(fd);
+            throw std::runtime_error("'" + filename + "' is not a sketch matrix");
+        }
+        m_size = st.st_size;
+        void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // the mapping stays valid
+        if (data == MAP_FAILED) throw std::runtime_error("cannot mmap file '" + filename + "'");
+        m_data = static_cast<uint8_t const*>(data);
+
+        m_header = *reinterpret_cast<sketch_matrix_header const*>(m_data);
+        if (m_header.magic != constants::sketch_matrix_magic or
+            m_header.file_size() != m_size) {
+            ::munmap(const_cast<uint8_t*>(m_data), m_size);
+            throw std::runtime_error("'" + filename + "' is not a sketch matrix");
+        }
+        /* the clustering scans all the sketches several times */
+        ::madvise(const_cast<uint8_t*>(m_data), m_size, MADV_WILLNEED);
+    }
+
+    ~mmapped_sketch_matrix() {
+        if (m_data) ::munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+
+    mmapped_sketch_matrix(mmapped_sketch_matrix const&) = delete;
+    mmapped_sketch_matrix& operator=(mmapped_sketch_matrix const&) = delete;
+
+    uint64_t num_points() const { return m_header.num_points; }
+    uint64_t num_bytes_per_point() const { return m_header.num_bytes_per_point; }
+    uint64_t num_ids() const { return m_header.num_ids; }
+
+    uint64_t id(uint64_t i) const {
+        assert(i < num_ids());
+        return reinterpret_cast<uint64_t const*>(m_data + sizeof(sketch_matrix_header))[i];
+    }
+
+    points_view points() const {
+        return points_view(m_data + m_header.data_offset, m_header.num_points,
+                           m_header.num_bytes_per_point, m_header.stride);
+    }
+
+private:
+    uint8_t const* m_data;
+    uint64_t m_size;
+    sketch_matrix_header m_header;
+};
+
+}  // namespace fulgor
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "ranked_bit_vector.hpp"
+#include "util.hpp"
+#include "external/sshash/external/pthash/include/encoders/darray.hpp"
+
+namespace fulgor {
+
+/*
+    Elias-Fano representation of the positions of the ones of a bit vector,
+    with rank and select. Select takes one select on the high bits; rank takes
+    one select on the high bits, plus a scan of the elements with the same high
+    part (about two, given the choice of the number of low bits).
+*/
+struct ranked_elias_fano {
+    ranked_elias_fano() : m_universe(0), m_size(0), m_num_low_bits(0) {}
+
+    void encode(std::vector<uint64_t> const& positions, uint64_t universe) {
+        m_universe = universe;
+        m_size = positions.size();
+        m_num_low_bits = 1;
+        if (m_size != 0 and universe / m_size > 1) {
+            m_num_low_bits = std::max<uint64_t>(1, util::msbll(universe / m_size));
+        }
+
+        const uint64_t num_high_bits = m_size + (universe >> m_num_low_bits) + 1;
+        pthash::bit_vector_builder high_bits(num_high_bits, 0);
+        pthash::compact_vector::builder low_bits(m_size, m_num_low_bits);
+        const uint64_t low_mask = (uint64_t(1) << m_num_low_bits) - 1;
+        for (uint64_t i = 0; i != m_size; ++i) {
+            const uint64_t x = positions[i];
+            assert(x < universe);
+            assert(i == 0 or x > positions[i - 1]);
+            high_bits.set((x >> m_num_low_bits) + i, 1);
+            low_bits.set(i, x & low_mask);
+        }
+        m_high_bits.build(&high_bits);
+        low_bits.build(m_low_bits);
+        m_high_bits_d1.build(m_high_bits);
+        m_high_bits_d0.build(m_high_bits);
+    }
+
+    /* the i-th element */
+    uint64_t select(uint64_t i) const {
+        assert(i < size());
+        const uint64_t high = m_high_bits_d1.select(m_high_bits, i) - i;
+        return (high << m_num_low_bits) | m_low_bits.access(i);
+    }
+
+    /* the number of elements smaller than x */
+    uint64_t rank(uint64_t x) const {
+        assert(x <= universe());
+        if (x == universe()) return size();
+        const uint64_t high = x >> m_num_low_bits;
+        const uint64_t low = x & ((uint64_t(1) << m_num_low_bits) - 1);
+        /* elements with high part < high */
+        uint64_t r = high == 0 ? 0 : m_high_bits_d0.select(m_high_bits, high - 1) - (high - 1);
+        /* position in m_high_bits of the first element with high part >= high */
+        uint64_t pos = r + high;
+        while (pos < m_high_bits.size() and m_high_bits[pos] and m_low_bits.access(r) < low) {
+            ++r;
+            ++pos;
+        }
+        return r;
+    }
+
+    uint64_t universe() const { return m_universe; }
+    uint64_t size() const { return m_size; }
+
+    uint64_t num_bits() const {
+        return 8 * (sizeof(m_universe) + sizeof(m_size) + sizeof(m_num_low_bits) +
+                    m_high_bits.bytes() + m_low_bits.bytes()) +
+               m_high_bits_d1.num_bits() + m_high_bits_d0.num_bits();
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_universe);
+        visitor.visit(m_size);
+        visitor.visit(m_num_low_bits);
+        visitor.visit(m_high_bits);
+        visitor.visit(m_low_bits);
+        visitor.visit(m_high_bits_d1);
+        visitor.visit(m_high_bits_d0);
+    }
+
+private:
+    uint64_t m_universe, m_size, m_num_low_bits;
+    pthash::bit_vector m_high_bits;
+    pthash::compact_vector m_low_bits;
+    pthash::darray1 m_high_bits_d1;
+    pthash::darray0 m_high_bits_d0;
+};
+
+/*
+    The map from unitig ids to color set ids: the unitigs of a color set have
+    consecutive ids, so the map is a bit vector with a one at the last unitig of
+    each color set, and the color set id of a unitig is the rank of its position.
+    The bit vector is stored either as is, with interleaved rank and select
+    samples (so that a lookup touches a single cache line), or, if smaller
+    (i.e., when there are many unitigs per color set), as the Elias-Fano
+    sequence of the positions of its ones.
+*/
+struct u2c_map {
+    enum representation : uint64_t { bit_vector = 0, elias_fano = 1 };
+
+    u2c_map() : m_representation(representation::bit_vector) {}
+
+    void build(pthash::bit_vector_builder* bvb) {
+        m_bits = interleaved_ranked_bit_vector();
+        m_ef = ranked_elias_fano();
+        m_bits.build(bvb);
+
+        std::vector<uint64_t> positions;
+        positions.reserve(m_bits.num_ones());
+        for (uint64_t i = 0; i != m_bits.num_ones(); ++i) positions.push_back(m_bits.select(i));
+        m_ef.encode(positions, m_bits.size());
+
+        if (m_ef.num_bits() < m_bits.bytes() * 8) {
+            m_representation = representation::elias_fano;
+            m_bits = interleaved_ranked_bit_vector();
+        } else {
+            m_representation = representation::bit_vector;
+            m_ef = ranked_elias_fano();
+        }
+    }
+
+    /* the color set id of unitig_id, i.e., the number of ones before position unitig_id */
+    uint64_t rank(uint64_t unitig_id) const {
+        if (m_representation == representation::elias_fano) return m_ef.rank(unitig_id);
+        return m_bits.rank(unitig_id);
+    }
+
+    /* the last unitig id of color_set_id, i.e., the position of the color_set_id-th one */
+    uint64_t select(uint64_t color_set_id) const {
+        assert(color_set_id < num_ones());
+        if (m_representation == representation::elias_fano) return m_ef.select(color_set_id);
+        return m_bits.select(color_set_id);
+    }
+
+    /* the unitig ids [begin, end) of color_set_id */
+    std::pair<uint64_t, uint64_t> unitigs(uint64_t color_set_id) const {
+        const uint64_t begin = color_set_id == 0 ? 0 : select(color_set_id - 1) + 1;
+        return {begin, select(color_set_id) + 1};
+    }
+
+    uint64_t size() const {
+        return m_representation == representation::elias_fano ? m_ef.universe() : m_bits.size();
+    }
+    uint64_t num_ones() const {
+        return m_representation == representation::elias_fano ? m_ef.size() : m_bits.num_ones();
+    }
+    uint64_t num_zeros() const { return size() - num_ones(); }
+
+    representation type() const { return m_representation; }
+
+    uint64_t bytes() const {
+        return sizeof(m_representation) + m_bits.bytes() + m_ef.num_bits() / 8;
+    }
+
+    template <typename Visitor>
+    void visit(Visitor& visitor) {
+        visitor.visit(m_representation);
+        visitor.visit(m_bits);
+        visitor.visit(m_ef);
+    }
+
+private:
+    representation m_representation;
+    interleaved_ranked_bit_vector m_bits;
+    ranked_elias_fano m_ef;
+};
+
+}  // namespace fulgor
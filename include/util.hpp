@@ -7,13 +7,24 @@
 #include <sstream>
 #include <chrono>
 #include <algorithm>  // for std::set_intersection
+#include <stdexcept>
 
 #include "external/smhasher/src/City.h"
 #include "external/smhasher/src/City.cpp"
 
 namespace fulgor {
 
-enum list_type { delta_gaps, bitmap, complement_delta_gaps, differential_list };
+enum list_type {
+    delta_gaps,
+    bitmap,
+    complement_delta_gaps,
+    differential_list,
+    run_lengths,
+    uncompressed
+};
+
+/* what the thresholds of hybrid are calibrated for: none keeps the default thresholds */
+enum class optimize_target : uint8_t { none, space, speed, balanced };
 
 namespace constants {
 constexpr double invalid_threshold = -1.0;
@@ -23,6 +34,20 @@ static const std::string fulgor_filename_extension("fur");
 static const std::string meta_colored_fulgor_filename_extension("mfur");
 static const std::string diff_colored_fulgor_filename_extension("dfur");
 static const std::string meta_diff_colored_fulgor_filename_extension("mdfur");
+static const std::string sharded_fulgor_filename_extension("sfur");
+static const std::string roaring_colored_fulgor_filename_extension("rfur");
+
+/* Written first in every index file (see index::visit and layered_index_header), and checked
+   before anything else is read, so that an index in an older format is rejected when loaded,
+   instead of being misread. Bump the version at every change of the serialized index:
+   1: the size at the head of each hybrid list carries the flag of run-length coding
+   2: the hot section of hybrid, the partition ends of meta, and the optional color set
+      sizes and partition bitmaps */
+constexpr uint64_t index_format_magic = 0x31544d4652474c46;  // "FLGRFMT1" in little endian
+constexpr uint64_t index_format_version = 2;
+
+/* partition bitmaps of at most 4 cache lines per meta color set */
+constexpr uint64_t max_num_partitions_for_bitmaps = 2048;
 }  // namespace constants
 
 struct build_configuration {
@@ -35,7 +60,12 @@ struct build_configuration {
         , tmp_dirname(constants::default_tmp_dirname)
         , verbose(false)
         , canonical_parsing(true)
-        , check(false) {}
+        , check(false)
+        , optimize(optimize_target::none)
+        , max_representatives(1)
+        , store_color_set_sizes(false)
+        , store_partition_bitmaps(false)
+        , sketch_sampling_rate(1.0) {}
 
     uint32_t k;            // kmer length
     uint32_t m;            // minimizer length
@@ -52,10 +82,41 @@ struct build_configuration {
     bool verbose;
     bool canonical_parsing;
     bool check;
+    optimize_target optimize;
+
+    /* differential coloring: the maximum number of representatives per cluster,
+       and what weighs the color sets when choosing them: empty (no weights),
+       "unitigs" (their number of unitigs), or a FASTA/FASTQ file of sample reads */
+    uint32_t max_representatives;
+    std::string query_weights;
+
+    bool store_color_set_sizes;  // see with_color_set_sizes
+
+    /* meta coloring: store the partitions of each color set as a bitmap, if there are at
+       most constants::max_num_partitions_for_bitmaps partitions (see partition_bitmaps) */
+    bool store_partition_bitmaps;
+
+    /* meta coloring: the fraction of the unitigs sketched to cluster the references */
+    double sketch_sampling_rate;
 };
 
 namespace util {
 
+/* throw if an index file is not in the current format (see constants::index_format_version) */
+static void check_index_format(uint64_t magic, uint64_t version) {
+    if (magic != constants::index_format_magic) {
+        throw std::runtime_error(
+            "the index was built with an older version of Fulgor, whose format is no longer "
+            "supported: rebuild it");
+    }
+    if (version != constants::index_format_version) {
+        throw std::runtime_error("the index has format version " + std::to_string(version) +
+                                 ", but version " +
+                                 std::to_string(constants::index_format_version) +
+                                 " is expected: rebuild it");
+    }
+}
+
 static void print_cmd(int argc, char** argv) {
     for (int i = 0; i != argc; ++i) std::cout << argv[i] << ' ';
     std::cout << std::endl;
@@ -64,22 +125,23 @@ static void print_cmd(int argc, char** argv) {
 /* return the number of 64-bit words for num_bits */
 static uint64_t num_64bit_words_for(uint64_t num_bits) { return (num_bits + 64 - 1) / 64; }
 
+/*
+    The iterators of all the color classes decode their color set with
+    - decode(out): the whole color set into out[0..size()), and
+    - decode_range(lo, hi, out): its elements in [lo, hi), into out,
+    whatever the position of the iterator, and return the number of decoded elements
+    (so out of num_docs() ints is always enough).
+*/
+
 template <typename ForwardIterator>
 bool check_intersection(std::vector<ForwardIterator>& iterators, std::vector<uint32_t> const& got) {
     if (iterators.empty()) return true;
 
-    for (auto& it : iterators) it.rewind();
-
     const uint32_t num_docs = iterators[0].num_docs();
     std::vector<std::vector<uint32_t>> sets(iterators.size());
     for (uint64_t i = 0; i != iterators.size(); ++i) {
-        auto& it = iterators[i];
-        uint32_t val = it.value();
-        while (val < num_docs) {
-            sets[i].push_back(val);
-            it.next();
-            val = it.value();
-        }
+        sets[i].resize(num_docs);
+        sets[i].resize(iterators[i].decode(sets[i].data()));
     }
 
     std::vector<uint32_t> expected;
@@ -114,6 +176,34 @@ bool check_intersection(std::vector<ForwardIterator>& iterators, std::vector<uin
     return true;
 }
 
+/*
+    Check that the iterators expected_it and got_it hold the same color set, decoding them into
+    the buffers expected and got (of num_docs() ints each). Print the first difference, as one
+    of the color set color_set_id, and return false if they differ.
+*/
+template <typename ExpectedIterator, typename GotIterator>
+bool check_color_set(ExpectedIterator const& expected_it, GotIterator const& got_it,
+                     uint64_t color_set_id, std::vector<uint32_t>& expected,
+                     std::vector<uint32_t>& got) {
+    assert(expected.size() >= expected_it.num_docs() and got.size() >= got_it.num_docs());
+    const uint64_t expected_size = expected_it.decode(expected.data());
+    const uint64_t got_size = got_it.decode(got.data());
+    if (expected_size != got_size) {
+        std::cout << "Error while checking color set " << color_set_id << ": expected size "
+                  << expected_size << " but got " << got_size << std::endl;
+        return false;
+    }
+    for (uint64_t i = 0; i != expected_size; ++i) {
+        if (expected[i] != got[i]) {
+            std::cout << "Error while checking color set " << color_set_id
+                      << ", mismatch at position " << i << ": expected " << expected[i]
+                      << " but got " << got[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
 /*
     Good reference for built-in functions:
     http://gcc.gnu.org/onlinedocs/gcc/Other-Builtins.html
@@ -9,12 +9,26 @@
 // use:  match(s,l,idx,v)
 // pre:  v is initialized
 // post: v contains all equiv classes for the k-mers in s
+//
+// If num_lookup_hits (resp. num_lookup_misses) is not null, the number of
+// lookups into the index that found (resp. did not find) the k-mer is added to it.
 
 template <typename FulgorIndex>
 void match(const std::string& s, int l, FulgorIndex const* idx,
-           std::vector<std::pair<projected_hits, int>>& v) {
+           std::vector<std::pair<projected_hits, int>>& v, uint64_t* num_lookup_hits = nullptr,
+           uint64_t* num_lookup_misses = nullptr) {
     sshash::dictionary const& kmap = idx->get_k2u();
     int64_t k = kmap.k();
+    uint64_t num_hits = 0, num_misses = 0;
+    auto lookup = [&](uint64_t kmer) {
+        auto answer = kmap.lookup_advanced_uint(kmer);
+        if (answer.kmer_id != sshash::constants::invalid_uint64) {
+            num_hits += 1;
+        } else {
+            num_misses += 1;
+        }
+        return answer;
+    };
     // NOTE: have to set this first, before starting any iterator or anything that
     // uses k-mers!!
     CanonicalKmer::k(k);
@@ -41,7 +55,7 @@ void match(const std::string& s, int l, FulgorIndex const* idx,
     int nextPos = 0;  // nextPosition to check
     for (int i = 0; kit != kit_end; ++i, ++kit) {
         // need to check it
-        auto search = kmap.lookup_advanced_uint(kit->first.fwWord());
+        auto search = lookup(kit->first.fwWord());
 
         int pos = kit->second;
 
@@ -76,7 +90,7 @@ void match(const std::string& s, int l, FulgorIndex const* idx,
                 pufferfish::CanonicalKmerIterator kit2(kit);
                 kit2.jumpTo(nextPos);
                 if (kit2 != kit_end) {
-                    auto search2 = kmap.lookup_advanced_uint(kit2->first.fwWord());
+                    auto search2 = lookup(kit2->first.fwWord());
                     bool found2 = false;
                     int found2pos = pos + dist;
                     if (search2.kmer_id == sshash::constants::invalid_uint64) {
@@ -106,7 +120,7 @@ void match(const std::string& s, int l, FulgorIndex const* idx,
                             kit3.jumpTo(middlePos);
                             projected_hits val3;
                             if (kit3 != kit_end) {
-                                auto search3 = kmap.lookup_advanced_uint(kit3->first.fwWord());
+                                auto search3 = lookup(kit3->first.fwWord());
                                 if (search3.kmer_id != sshash::constants::invalid_uint64) {
                                     val3.globalPos_ =
                                         search3.kmer_id + (search3.contig_id * (k - 1));
@@ -160,7 +174,7 @@ void match(const std::string& s, int l, FulgorIndex const* idx,
                 if (j == skip) { j = 0; }
                 if (j == 0) {
                     // need to check it
-                    auto search = kmap.lookup_advanced_uint(kit->first.fwWord());
+                    auto search = lookup(kit->first.fwWord());
                     if (search.kmer_id != sshash::constants::invalid_uint64) {
                         projected_hits tmpval;
                         tmpval.globalPos_ = search.kmer_id + (search.contig_id * (k - 1));
@@ -182,4 +196,7 @@ void match(const std::string& s, int l, FulgorIndex const* idx,
             }
         }
     }
+
+    if (num_lookup_hits) *num_lookup_hits += num_hits;
+    if (num_lookup_misses) *num_lookup_misses += num_misses;
 }
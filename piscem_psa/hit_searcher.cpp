@@ -99,6 +99,7 @@ struct SkipContext {
             obtained_confirmatory_hit = false;
             auto lookup = qc.lookup_advanced(kit1.seq().data() + kit1->second);
             if (lookup.kmer_id != sshash::constants::invalid_uint64) {
+                num_lookup_hits += 1;
                 // local for this function
                 found_match = true;
                 // global for this read
@@ -110,6 +111,7 @@ struct SkipContext {
                 phits.contigOrientation_ =
                     (lookup.kmer_orientation == sshash::constants::forward_orientation);
             } else {
+                num_lookup_misses += 1;
                 phits.contigIdx_ = sshash::constants::invalid_uint64;
             }
             last_lookup_offset = kit1->second;
@@ -504,6 +506,12 @@ struct SkipContext {
     // the amount by which we should move forward on a miss
     // (1 if no hit is found yet, else altSkip).
     bool hit_found;
+    // the number of explicit lookups into the index
+    // that found (resp. did not find) the k-mer; the
+    // k-mers of the read that were not looked up were
+    // either skipped or matched by a fast hit.
+    uint32_t num_lookup_hits{0};
+    uint32_t num_lookup_misses{0};
 };
 
 // This method performs k-mer / hit collection
@@ -656,6 +664,8 @@ bool hit_searcher<FulgorIndex>::get_raw_hits_sketch(std::string const& read,
         }
     }
 
+    num_lookup_hits_ += skip_ctx.num_lookup_hits;
+    num_lookup_misses_ += skip_ctx.num_lookup_misses;
     return raw_hits.size() != 0;
 }
 
@@ -26,11 +26,17 @@ public:
     void clear() {
         left_rawHits.clear();
         right_rawHits.clear();
+        num_lookup_hits_ = 0;
+        num_lookup_misses_ = 0;
     }
 
     void setAltSkip(uint32_t as) { altSkip = as; }
     inline std::vector<std::pair<int, projected_hits>>& get_left_hits() { return left_rawHits; }
     inline std::vector<std::pair<int, projected_hits>>& get_right_hits() { return right_rawHits; }
+    // number of k-mer lookups into the index that found (resp. did not find)
+    // the k-mer, since the last call to clear().
+    inline uint64_t get_num_lookup_hits() const { return num_lookup_hits_; }
+    inline uint64_t get_num_lookup_misses() const { return num_lookup_misses_; }
 
 private:
     FulgorIndex const* pfi_;
@@ -38,6 +44,8 @@ private:
     uint32_t altSkip{5};
     std::vector<std::pair<int, projected_hits>> left_rawHits;
     std::vector<std::pair<int, projected_hits>> right_rawHits;
+    uint64_t num_lookup_hits_{0};
+    uint64_t num_lookup_misses_{0};
 };
 
 }  // namespace piscem_psa
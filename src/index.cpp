@@ -25,17 +25,24 @@ void index<ColorClasses>::print_stats() const {
               << (other_bits * 100.0) / total_bits << "%)\n";
     std::cout << "    U2C: " << u2c.bytes() << " bytes / "
               << essentials::convert(u2c.bytes(), essentials::GB) << " GB ("
-              << (u2c.bytes() * 8 * 100.0) / total_bits << "%)\n";
+              << (u2c.bytes() * 8 * 100.0) / total_bits << "%, "
+              << (u2c.type() == u2c_map::elias_fano ? "Elias-Fano" : "bit vector") << ")\n";
     std::cout << "    filenames: " << filenames.num_bits() / 8 << " bytes / "
               << essentials::convert(filenames.num_bits() / 8, essentials::GB) << " GB ("
               << (filenames.num_bits() * 100.0) / total_bits << "%)\n";
+    if (!ccs.sizes().empty()) {
+        const uint64_t sizes_bits = ccs.sizes().num_bits();
+        std::cout << "  (of which CCs sizes: " << sizes_bits / 8 << " bytes / "
+                  << essentials::convert(sizes_bits / 8, essentials::GB) << " GB ("
+                  << (sizes_bits * 100.0) / total_bits << "%))\n";
+    }
 
     uint64_t num_ints_in_ccs = 0;
     uint64_t num_ccs = ccs.num_color_sets();
     std::cout << "Color id range 0.." << num_docs() - 1 << '\n';
     std::cout << "Number of distinct color classes: " << num_ccs << '\n';
     for (uint64_t color_set_id = 0; color_set_id != num_ccs; ++color_set_id) {
-        uint64_t list_size = ccs.color_set(color_set_id).size();
+        uint64_t list_size = ccs.color_set_size(color_set_id);
         num_ints_in_ccs += list_size;
     }
     std::cout << "Number of ints in distinct color classes: " << num_ints_in_ccs << " ("
@@ -90,13 +97,12 @@ void index<ColorClasses>::dump(std::string const& basename) const {
     if (!colors.is_open()) throw std::runtime_error("cannot open output file");
     auto const& ccs = get_color_sets();
     const uint64_t n = num_color_sets();
+    std::vector<uint32_t> color_set(num_docs());
     for (uint64_t color_id = 0; color_id != n; ++color_id) {
-        auto it = ccs.color_set(color_id);
-        const uint32_t size = it.size();
+        const uint32_t size = ccs.color_set(color_id).decode(color_set.data());
         colors << "color_id=" << color_id << " size=" << size << ' ';
         for (uint32_t j = 0; j != size; ++j) {
-            colors << it.value();
-            it.next();
+            colors << color_set[j];
             if (j != size - 1) colors << ' ';
         }
         colors << '\n';
@@ -1,91 +1,391 @@
+#include <numeric>
+#include <thread>
+
 #include "include/index.hpp"
 #include "external/sshash/include/query/streaming_query_canonical_parsing.hpp"
 
 namespace fulgor {
 
-template <typename Iterator>
-void intersect(std::vector<Iterator>& iterators, std::vector<uint32_t>& colors,
+/*
+    Intersection kernels for hybrid lists, specialized by list type.
+    The candidates are the elements of the shortest sparse or uncompressed
+    list, filtered by each other sparse or uncompressed list (with next_geq),
+    then by each bitmap (with a bit
+    test), then by each run-length list (with a cursor on the runs), then by
+    each complemented list (with a cursor on the complement).
+*/
+static void intersect_sparse(std::vector<hybrid::delta_gaps_iterator>& sparse,
+                             std::vector<hybrid::uncompressed_iterator>& arrays,
+                             std::vector<hybrid::bitmap_iterator> const& bitmaps,
+                             std::vector<hybrid::run_lengths_iterator>& runs,
+                             std::vector<hybrid::complement_delta_gaps_iterator>& complements,
+                             std::vector<uint32_t>& colors) {
+    assert(!sparse.empty() or !arrays.empty());
+    auto by_size = [](auto const& x, auto const& y) { return x.size() < y.size(); };
+    std::sort(sparse.begin(), sparse.end(), by_size);
+    std::sort(arrays.begin(), arrays.end(), by_size);
+
+    uint64_t first_sparse = 0, first_array = 0;  // the lists that filter the candidates
+    if (!arrays.empty() and (sparse.empty() or arrays.front().size() < sparse.front().size())) {
+        colors.resize(arrays.front().size());
+        colors.resize(arrays.front().decode(colors.data()));
+        first_array = 1;
+    } else {
+        colors.resize(sparse.front().size());
+        colors.resize(sparse.front().decode(colors.data()));
+        first_sparse = 1;
+    }
+
+    auto filter = [&](auto&& keep) {
+        uint64_t n = 0;
+        for (uint32_t candidate : colors) {
+            if (keep(candidate)) colors[n++] = candidate;
+        }
+        colors.resize(n);
+    };
+    for (uint64_t i = first_sparse; i < sparse.size() and !colors.empty(); ++i) {
+        auto& it = sparse[i];
+        filter([&](uint32_t candidate) {
+            it.next_geq(candidate);
+            return it.value() == candidate;
+        });
+    }
+    for (uint64_t i = first_array; i < arrays.size() and !colors.empty(); ++i) {
+        auto& it = arrays[i];
+        filter([&](uint32_t candidate) {
+            it.next_geq(candidate);
+            return it.value() == candidate;
+        });
+    }
+    for (auto const& it : bitmaps) {
+        if (colors.empty()) return;
+        filter([&](uint32_t candidate) { return it.contains(candidate); });
+    }
+    for (auto& it : runs) {
+        if (colors.empty()) return;
+        filter([&](uint32_t candidate) { return it.contains(candidate); });
+    }
+    for (auto& it : complements) {
+        if (colors.empty()) return;
+        filter([&](uint32_t candidate) { return it.contains(candidate); });
+    }
+}
+
+/* the bits [from, to) of a word */
+static uint64_t range_mask(uint64_t from, uint64_t to) {
+    assert(from < to and to <= 64);
+    return (to - from == 64 ? ~uint64_t(0) : (uint64_t(1) << (to - from)) - 1) << from;
+}
+
+/*
+    AND of the bitmaps, 64 docs at a time, and of the runs of the run-length
+    lists, minus the complements of the complemented lists
+*/
+static void intersect_bitmaps(std::vector<hybrid::bitmap_iterator> const& bitmaps,
+                              std::vector<hybrid::run_lengths_iterator>& runs,
+                              std::vector<hybrid::complement_delta_gaps_iterator>& complements,
+                              std::vector<uint32_t>& colors) {
+    assert(!bitmaps.empty());
+    const uint64_t num_docs = bitmaps.front().num_docs();
+    for (uint64_t base = 0; base < num_docs; base += 64) {
+        const uint64_t end = std::min<uint64_t>(base + 64, num_docs);
+        uint64_t word = bitmaps.front().word(base);
+        for (uint64_t i = 1; i != bitmaps.size() and word; ++i) word &= bitmaps[i].word(base);
+        for (auto& it : runs) {
+            uint64_t mask = 0;
+            for (; it.start() < end; it.next_run()) {
+                const uint64_t from = std::max<uint64_t>(it.start(), base);
+                const uint64_t to = std::min<uint64_t>(it.last() + 1, end);
+                if (from < to) mask |= range_mask(from - base, to - base);
+                if (it.last() + 1 >= end) break;  // the run continues in the next word
+            }
+            word &= mask;
+        }
+        for (auto& it : complements) {
+            for (; it.comp_value() < end; it.next_comp()) {
+                assert(it.comp_value() >= base);
+                word &= ~(uint64_t(1) << (it.comp_value() - base));
+            }
+        }
+        while (word) {
+            colors.push_back(base + util::lsbll(word));
+            word &= word - 1;
+        }
+    }
+}
+
+/*
+    Intersection at the granularity of runs: the runs of the run-length lists
+    are intersected as intervals, and the ints of the resulting intervals are
+    filtered by the complemented lists.
+*/
+static void intersect_runs(std::vector<hybrid::run_lengths_iterator>& runs,
+                           std::vector<hybrid::complement_delta_gaps_iterator>& complements,
+                           std::vector<uint32_t>& colors) {
+    assert(!runs.empty());
+    std::sort(runs.begin(), runs.end(),
+              [](auto const& x, auto const& y) { return x.num_runs() < y.num_runs(); });
+
+    std::vector<std::pair<uint32_t, uint32_t>> intervals, tmp;  // closed intervals
+    auto& first = runs.front();
+    for (; first.start() < first.num_docs(); first.next_run()) {
+        intervals.emplace_back(first.start(), first.last());
+    }
+    for (uint64_t i = 1; i != runs.size() and !intervals.empty(); ++i) {
+        auto& it = runs[i];
+        tmp.clear();
+        for (uint64_t x = 0; x != intervals.size() and it.start() < it.num_docs();) {
+            const uint32_t start = std::max(intervals[x].first, it.start());
+            const uint32_t last = std::min(intervals[x].second, it.last());
+            if (start <= last) tmp.emplace_back(start, last);
+            if (intervals[x].second < it.last()) {
+                ++x;
+            } else {
+                it.next_run();
+            }
+        }
+        intervals.swap(tmp);
+    }
+
+    for (auto [start, last] : intervals) {
+        for (uint64_t x = start; x <= last; ++x) {
+            bool keep = true;
+            for (auto& it : complements) keep = keep and it.contains(x);
+            if (keep) colors.push_back(x);
+        }
+    }
+}
+
+/* the complement of the union of the complements */
+static void intersect_complements(
+    std::vector<hybrid::complement_delta_gaps_iterator>& complements,
+    std::vector<uint32_t>& colors, std::vector<uint32_t>& complement_set) {
+    assert(!complements.empty());
+
+    /* step 1: take the union of complementary sets */
+    uint32_t candidate = (*std::min_element(complements.begin(), complements.end(),
+                                            [](auto const& x, auto const& y) {
+                                                return x.comp_value() < y.comp_value();
+                                            }))
+                             .comp_value();
+
+    const uint32_t num_docs = complements[0].num_docs();
+    complement_set.reserve(num_docs);
+    while (candidate < num_docs) {
+        uint32_t next_candidate = num_docs;
+        for (uint64_t i = 0; i != complements.size(); ++i) {
+            if (complements[i].comp_value() == candidate) complements[i].next_comp();
+            /* compute next minimum */
+            if (complements[i].comp_value() < next_candidate) {
+                next_candidate = complements[i].comp_value();
+            }
+        }
+        complement_set.push_back(candidate);
+        assert(next_candidate > candidate);
+        candidate = next_candidate;
+    }
+
+    /* step 2: compute the intersection by scanning complement_set */
+    candidate = 0;
+    for (uint32_t i = 0; i != complement_set.size(); ++i) {
+        while (candidate < complement_set[i]) {
+            colors.push_back(candidate);
+            candidate += 1;
+        }
+        candidate += 1;  // skip the candidate because it is equal to complement_set[i]
+    }
+    while (candidate < num_docs) {
+        colors.push_back(candidate);
+        candidate += 1;
+    }
+}
+
+/*
+    Group the iterators by list type and dispatch to the kernel for the
+    combination of types: if there is at least one sparse (or hot uncompressed)
+    list, its elements drive the intersection; otherwise, if there is at least one bitmap, the
+    bitmaps are intersected word by word; otherwise, if there is at least one
+    run-length list, the runs are intersected; otherwise, all lists are very
+    dense.
+*/
+void intersect(std::vector<hybrid::iterator_type>& iterators, std::vector<uint32_t>& colors,
                std::vector<uint32_t>& complement_set) {
     assert(colors.empty());
     assert(complement_set.empty());
 
     if (iterators.empty()) return;
 
-    bool all_very_dense = true;
+    std::vector<hybrid::delta_gaps_iterator> sparse;
+    std::vector<hybrid::bitmap_iterator> bitmaps;
+    std::vector<hybrid::uncompressed_iterator> arrays;
+    std::vector<hybrid::run_lengths_iterator> runs;
+    std::vector<hybrid::complement_delta_gaps_iterator> complements;
     for (auto const& it : iterators) {
-        if (it.type() != list_type::complement_delta_gaps) {
-            all_very_dense = false;
-            break;
+        if (it.type() == list_type::delta_gaps) {
+            sparse.push_back(it.as_delta_gaps());
+        } else if (it.type() == list_type::uncompressed) {
+            arrays.push_back(it.as_uncompressed());
+        } else if (it.type() == list_type::bitmap) {
+            bitmaps.push_back(it.as_bitmap());
+        } else if (it.type() == list_type::run_lengths) {
+            runs.push_back(it.as_run_lengths());
+        } else {
+            assert(it.type() == list_type::complement_delta_gaps);
+            complements.push_back(it.as_complement_delta_gaps());
         }
     }
 
-    if (all_very_dense) {
-        /* step 1: take the union of complementary sets */
-        for (auto& it : iterators) it.reinit_for_complemented_set_iteration();
-
-        uint32_t candidate = (*std::min_element(iterators.begin(), iterators.end(),
-                                                [](auto const& x, auto const& y) {
-                                                    return x.comp_value() < y.comp_value();
-                                                }))
-                                 .comp_value();
-
-        const uint32_t num_docs = iterators[0].num_docs();
-        complement_set.reserve(num_docs);
-        while (candidate < num_docs) {
-            uint32_t next_candidate = num_docs;
-            for (uint64_t i = 0; i != iterators.size(); ++i) {
-                if (iterators[i].comp_value() == candidate) iterators[i].next_comp();
-                /* compute next minimum */
-                if (iterators[i].comp_value() < next_candidate) {
-                    next_candidate = iterators[i].comp_value();
+    if (!sparse.empty() or !arrays.empty()) {
+        intersect_sparse(sparse, arrays, bitmaps, runs, complements, colors);
+    } else if (!bitmaps.empty()) {
+        intersect_bitmaps(bitmaps, runs, complements, colors);
+    } else if (!runs.empty()) {
+        intersect_runs(runs, complements, colors);
+    } else {
+        intersect_complements(complements, colors, complement_set);
+    }
+}
+
+/*
+    Intersection of roaring color sets, one chunk at a time: the chunks are
+    those of the color set with the fewest containers, and only the chunks
+    where all the color sets have a container are intersected, with a kernel
+    chosen by the types of the containers.
+*/
+static void intersect_containers(std::vector<roaring::container const*>& containers,
+                                 std::vector<uint32_t>& colors) {
+    const uint64_t base = containers.front()->base();
+
+    /* an array container drives: filter its values by the other containers */
+    auto array_it = std::min_element(containers.begin(), containers.end(), [](auto x, auto y) {
+        if ((x->type == roaring::array_container) != (y->type == roaring::array_container)) {
+            return x->type == roaring::array_container;
+        }
+        return x->cardinality < y->cardinality;
+    });
+    if ((*array_it)->type == roaring::array_container) {
+        std::swap(*array_it, containers.front());
+        const uint64_t begin = colors.size();
+        uint16_t const* values = containers.front()->values();
+        for (uint64_t i = 0; i != containers.front()->cardinality; ++i) {
+            colors.push_back(base + values[i]);
+        }
+        for (uint64_t i = 1; i != containers.size() and colors.size() != begin; ++i) {
+            auto const& c = *containers[i];
+            uint64_t n = begin;
+            uint64_t pos = 0;  // in the array, or runs, of c: the candidates are increasing
+            for (uint64_t j = begin; j != colors.size(); ++j) {
+                const uint64_t low = colors[j] - base;
+                bool found = false;
+                if (c.type == roaring::bitmap_container) {
+                    found = c.contains(low);
+                } else if (c.type == roaring::array_container) {
+                    pos = std::lower_bound(c.values() + pos, c.values() + c.cardinality, low) -
+                          c.values();
+                    found = pos != c.cardinality and c.values()[pos] == low;
+                } else {
+                    while (pos != c.num_runs and c.run_last(pos) < low) ++pos;
+                    found = pos != c.num_runs and c.run_start(pos) <= low;
                 }
+                if (found) colors[n++] = colors[j];
             }
-            complement_set.push_back(candidate);
-            assert(next_candidate > candidate);
-            candidate = next_candidate;
+            colors.resize(n);
         }
+        return;
+    }
 
-        /* step 2: compute the intersection by scanning complement_set */
-        candidate = 0;
-        for (uint32_t i = 0; i != complement_set.size(); ++i) {
-            while (candidate < complement_set[i]) {
-                colors.push_back(candidate);
-                candidate += 1;
+    /* only runs: intersect the runs, as closed intervals */
+    bool all_runs = std::all_of(containers.begin(), containers.end(),
+                                [](auto c) { return c->type == roaring::run_container; });
+    if (all_runs) {
+        std::vector<std::pair<uint32_t, uint32_t>> runs, tmp;
+        auto const& first = *containers.front();
+        for (uint64_t i = 0; i != first.num_runs; ++i) {
+            runs.emplace_back(first.run_start(i), first.run_last(i));
+        }
+        for (uint64_t i = 1; i != containers.size() and !runs.empty(); ++i) {
+            auto const& c = *containers[i];
+            tmp.clear();
+            for (uint64_t x = 0, y = 0; x != runs.size() and y != c.num_runs;) {
+                const uint32_t start = std::max(runs[x].first, c.run_start(y));
+                const uint32_t last = std::min(runs[x].second, c.run_last(y));
+                if (start <= last) tmp.emplace_back(start, last);
+                if (runs[x].second < c.run_last(y)) {
+                    ++x;
+                } else {
+                    ++y;
+                }
             }
-            candidate += 1;  // skip the candidate because it is equal to complement_set[i]
+            runs.swap(tmp);
         }
-        while (candidate < num_docs) {
-            colors.push_back(candidate);
-            candidate += 1;
+        for (auto [start, last] : runs) {
+            for (uint64_t x = start; x <= last; ++x) colors.push_back(base + x);
         }
-
         return;
     }
 
-    /* traditional intersection code based on next_geq() and next() */
+    /* bitmaps and runs: AND the bitmaps, then clear the gaps between the runs */
+    uint64_t words[roaring::bitmap_words];
+    bool first = true;
+    for (auto c : containers) {
+        if (c->type != roaring::bitmap_container) continue;
+        for (uint64_t i = 0; i != roaring::bitmap_words; ++i) {
+            words[i] = first ? c->data[i] : words[i] & c->data[i];
+        }
+        first = false;
+    }
+    auto clear = [&](uint64_t from, uint64_t to) {  // clear the bits in [from, to)
+        for (; from < to and from % 64 != 0; ++from) {
+            words[from / 64] &= ~(uint64_t(1) << (from % 64));
+        }
+        for (; from + 64 <= to; from += 64) words[from / 64] = 0;
+        for (; from < to; ++from) words[from / 64] &= ~(uint64_t(1) << (from % 64));
+    };
+    for (auto c : containers) {
+        if (c->type != roaring::run_container) continue;
+        uint64_t from = 0;
+        for (uint64_t i = 0; i != c->num_runs; ++i) {
+            clear(from, c->run_start(i));
+            from = c->run_last(i) + 1;
+        }
+        clear(from, roaring::chunk_size);
+    }
+    for (uint64_t i = 0; i != roaring::bitmap_words; ++i) {
+        uint64_t word = words[i];
+        while (word) {
+            colors.push_back(base + i * 64 + util::lsbll(word));
+            word &= word - 1;
+        }
+    }
+}
 
-    std::sort(iterators.begin(), iterators.end(),
-              [](auto const& x, auto const& y) { return x.size() < y.size(); });
+void intersect(std::vector<roaring::iterator_type>& iterators, std::vector<uint32_t>& colors,
+               std::vector<uint32_t>& /* complement_set */) {
+    assert(colors.empty());
+    if (iterators.empty()) return;
 
-    const uint32_t num_docs = iterators[0].num_docs();
-    uint32_t candidate = iterators[0].value();
-    uint64_t i = 1;
-    while (candidate < num_docs) {
-        for (; i != iterators.size(); ++i) {
-            iterators[i].next_geq(candidate);
-            uint32_t val = iterators[i].value();
-            if (val != candidate) {
-                candidate = val;
-                i = 0;
+    std::vector<roaring::container_iterator> containers;
+    containers.reserve(iterators.size());
+    for (auto const& it : iterators) containers.push_back(it.containers());
+    std::sort(containers.begin(), containers.end(), [](auto const& x, auto const& y) {
+        return x.num_containers() < y.num_containers();
+    });
+
+    std::vector<roaring::container const*> matching(containers.size());
+    for (auto& driver = containers.front(); driver.has_next(); driver.next()) {
+        const uint64_t chunk = driver->chunk;
+        bool all_match = true;
+        for (uint64_t i = 1; i != containers.size(); ++i) {
+            containers[i].next_geq(chunk);
+            if (!containers[i].has_next()) return;
+            if (containers[i]->chunk != chunk) {
+                all_match = false;
                 break;
             }
         }
-        if (i == iterators.size()) {
-            colors.push_back(candidate);
-            iterators[0].next();
-            candidate = iterators[0].value();
-            i = 1;
-        }
+        if (!all_match) continue;
+        for (uint64_t i = 0; i != containers.size(); ++i) matching[i] = &(*containers[i]);
+        intersect_containers(matching, colors);
     }
 }
 
@@ -178,60 +478,29 @@ void diff_intersect(std::vector<Iterator>& iterators, std::vector<uint32_t>& col
     }
 }
 
+/*
+    Intersect the partial color sets of the iterators in the partitions
+    partition_ids[begin..end), appending the result to colors. The iterators
+    must have been rewound before a partition smaller than partition_ids[begin].
+*/
 template <typename Iterator>
-void meta_intersect(std::vector<Iterator>& iterators, std::vector<uint32_t>& colors,
-                    std::vector<uint32_t>& partition_ids) {
-    assert(colors.empty());
-    assert(partition_ids.empty());
-
-    if (iterators.empty()) return;
-
-    std::sort(iterators.begin(), iterators.end(), [](auto const& x, auto const& y) {
-        return x.meta_color_list_size() < y.meta_color_list_size();
-    });
-
-    /* step 1: determine partitions in common */
-    const uint32_t num_partitions = iterators[0].num_partitions();
-    partition_ids.reserve(num_partitions);  // at most
-
-    uint32_t candidate = iterators[0].partition_id();
-    uint64_t i = 1;
-    while (candidate < num_partitions) {
-        for (; i != iterators.size(); ++i) {
-            iterators[i].next_geq_partition_id(candidate);
-            uint32_t val = iterators[i].partition_id();
-            if (val != candidate) {
-                candidate = val;
-                i = 0;
-                break;
-            }
-        }
-        if (i == iterators.size()) {
-            partition_ids.push_back(candidate);
-            iterators[0].next_partition_id();
-            candidate = iterators[0].partition_id();
-            i = 1;
-        }
-    }
-
-    /* step 2: intersect partial colors in the same partitions only */
-    for (auto& it : iterators) {
-        it.init();
-        it.change_partition();
-    }
-    for (auto partition_id : partition_ids) {
+static void meta_intersect_partitions(std::vector<Iterator>& iterators,
+                                      std::vector<uint32_t> const& partition_ids,
+                                      uint64_t begin, uint64_t end,
+                                      std::vector<uint32_t>& colors) {
+    for (uint64_t p = begin; p != end; ++p) {
+        const uint32_t partition_id = partition_ids[p];
         bool same_meta_color = true;
-        auto& front_it = iterators.front();
-        front_it.next_geq_partition_id(partition_id);
-        front_it.update_partition();
-        uint32_t meta_color = front_it.meta_color();
-
-        for (uint32_t i = 1; i != iterators.size(); ++i) {
+        uint64_t smallest = 0;  // the iterator with the smallest partial color set
+        for (uint32_t i = 0; i != iterators.size(); ++i) {
             auto& it = iterators[i];
             it.next_geq_partition_id(partition_id);
             it.update_partition();
-            if (it.meta_color() != meta_color) same_meta_color = false;
+            if (it.meta_color() != iterators.front().meta_color()) same_meta_color = false;
+            if (it.partition_size() < iterators[smallest].partition_size()) smallest = i;
         }
+        std::swap(iterators.front(), iterators[smallest]);
+        auto& front_it = iterators.front();
 
         if (same_meta_color) {  // do not intersect, just write the whole partial color once
             while (front_it.has_next()) {
@@ -264,36 +533,222 @@ void meta_intersect(std::vector<Iterator>& iterators, std::vector<uint32_t>& col
     }
 }
 
-void stream_through(sshash::dictionary const& k2u, std::string const& sequence,
-                    std::vector<uint64_t>& unitig_ids) {
+/* minimum number of partitions in common per thread to intersect them in parallel */
+static const uint64_t min_partitions_per_thread = 64;
+
+/*
+    Step 1 determines the partitions in common to all the color sets: as the AND of their
+    partition bitmaps, if stored, or by intersecting their lists of partitions otherwise.
+    Step 2 intersects the partial color sets in each partition in common: with
+    num_threads > 1 and enough partitions in common (e.g., for long sequences), the
+    partitions are split among threads, each with its own copy of the iterators.
+*/
+template <typename Iterator>
+void meta_intersect(std::vector<Iterator>& iterators, std::vector<uint32_t>& colors,
+                    std::vector<uint32_t>& partition_ids, uint64_t num_threads = 1) {
+    assert(colors.empty());
+    assert(partition_ids.empty());
+
+    if (iterators.empty()) return;
+
+    std::sort(iterators.begin(), iterators.end(), [](auto const& x, auto const& y) {
+        return x.meta_color_list_size() < y.meta_color_list_size();
+    });
+
+    /* step 1: determine partitions in common */
+    const uint32_t num_partitions = iterators[0].num_partitions();
+    partition_ids.reserve(num_partitions);  // at most
+
+    if (iterators[0].partition_bitmap() != nullptr) {
+        const uint64_t num_words = (num_partitions + 63) / 64;
+        for (uint64_t w = 0; w != num_words; ++w) {
+            uint64_t word = iterators[0].partition_bitmap()[w];
+            for (uint64_t i = 1; i != iterators.size() and word; ++i) {
+                word &= iterators[i].partition_bitmap()[w];
+            }
+            while (word) {
+                partition_ids.push_back(w * 64 + util::lsbll(word));
+                word &= word - 1;
+            }
+        }
+    } else {
+        uint32_t candidate = iterators[0].partition_id();
+        uint64_t i = 1;
+        while (candidate < num_partitions) {
+            for (; i != iterators.size(); ++i) {
+                iterators[i].next_geq_partition_id(candidate);
+                uint32_t val = iterators[i].partition_id();
+                if (val != candidate) {
+                    candidate = val;
+                    i = 0;
+                    break;
+                }
+            }
+            if (i == iterators.size()) {
+                partition_ids.push_back(candidate);
+                iterators[0].next_partition_id();
+                candidate = iterators[0].partition_id();
+                i = 1;
+            }
+        }
+    }
+
+    /* step 2: intersect partial colors in the same partitions only */
+    for (auto& it : iterators) {
+        it.init();
+        it.change_partition();
+    }
+
+    num_threads = std::min(num_threads, partition_ids.size() / min_partitions_per_thread);
+    if (num_threads <= 1) {
+        meta_intersect_partitions(iterators, partition_ids, 0, partition_ids.size(), colors);
+        return;
+    }
+
+    /* the threads take consecutive slices of the partitions, so that their results are
+       concatenated in order */
+    std::vector<std::vector<uint32_t>> thread_colors(num_threads);
+    std::vector<std::thread> threads(num_threads);
+    const uint64_t slice_size = (partition_ids.size() + num_threads - 1) / num_threads;
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads[t] = std::thread([&, t]() {
+            const uint64_t begin = std::min(t * slice_size, partition_ids.size());
+            const uint64_t end = std::min(begin + slice_size, partition_ids.size());
+            std::vector<Iterator> thread_iterators = iterators;
+            meta_intersect_partitions(thread_iterators, partition_ids, begin, end,
+                                      thread_colors[t]);
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (auto const& c : thread_colors) colors.insert(colors.end(), c.begin(), c.end());
+}
+
+/* Append to unitig_ids the unitigs of the positive k-mers of sequence (without repeating the
+   unitig of consecutive k-mers) and return the number of positive k-mers. */
+uint64_t stream_through(sshash::dictionary const& k2u, std::string const& sequence,
+                        std::vector<uint64_t>& unitig_ids) {
     sshash::streaming_query_canonical_parsing query(&k2u);
     query.start();
     const uint64_t num_kmers = sequence.length() - k2u.k() + 1;
+    uint64_t num_positive_kmers_in_sequence = 0;
     for (uint64_t i = 0, prev_unitig_id = -1; i != num_kmers; ++i) {
         char const* kmer = sequence.data() + i;
         auto answer = query.lookup_advanced(kmer);
         if (answer.kmer_id != sshash::constants::invalid_uint64) {  // kmer is positive
+            num_positive_kmers_in_sequence += 1;
             if (answer.contig_id != prev_unitig_id) {
                 unitig_ids.push_back(answer.contig_id);
                 prev_unitig_id = answer.contig_id;
             }
         }
     }
+    return num_positive_kmers_in_sequence;
+}
+
+/*
+    As stream_through, but with num_threads threads, each streaming a chunk of the k-mers of
+    sequence. The chunks overlap by k - 1 bases, so that each k-mer is in one chunk only, and
+    their unitigs are appended in order (a unitig spanning two chunks is repeated, which
+    intersect_unitigs deduplicates).
+*/
+uint64_t stream_through(sshash::dictionary const& k2u, std::string const& sequence,
+                        std::vector<uint64_t>& unitig_ids, uint64_t num_threads) {
+    const uint64_t k = k2u.k();
+    assert(sequence.length() >= k);
+    const uint64_t num_kmers = sequence.length() - k + 1;
+    num_threads = std::min(num_threads, num_kmers);
+    if (num_threads <= 1) return stream_through(k2u, sequence, unitig_ids);
+
+    const uint64_t num_kmers_per_chunk = (num_kmers + num_threads - 1) / num_threads;
+    std::vector<std::vector<uint64_t>> thread_unitig_ids(num_threads);
+    std::vector<uint64_t> thread_num_positive_kmers(num_threads, 0);
+    std::vector<std::thread> threads(num_threads);
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        threads[t] = std::thread([&, t]() {
+            const uint64_t begin = std::min(t * num_kmers_per_chunk, num_kmers);
+            const uint64_t end = std::min(begin + num_kmers_per_chunk, num_kmers);
+            if (begin == end) return;
+            std::string chunk = sequence.substr(begin, end - begin + k - 1);
+            thread_num_positive_kmers[t] = stream_through(k2u, chunk, thread_unitig_ids[t]);
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    uint64_t num_positive_kmers_in_sequence = 0;
+    for (uint64_t t = 0; t != num_threads; ++t) {
+        num_positive_kmers_in_sequence += thread_num_positive_kmers[t];
+        unitig_ids.insert(unitig_ids.end(), thread_unitig_ids[t].begin(),
+                          thread_unitig_ids[t].end());
+    }
+    return num_positive_kmers_in_sequence;
+}
+
+/* minimum number of color sets per thread to intersect them in parallel */
+static const uint64_t min_color_sets_per_thread = 4;
+
+/*
+    Intersect the color sets with num_threads threads, as a reduction tree: each thread
+    intersects a group of the color sets with intersect_group, then the partial intersections
+    are intersected pairwise, in parallel, until one is left. The color sets are dealt to the
+    groups in order of size, so that each group has one of the smallest color sets and the
+    partial intersections stay small.
+*/
+template <typename Iterator, typename IntersectGroup>
+static void parallel_intersect(std::vector<Iterator> const& iterators,
+                               std::vector<uint32_t>& colors, uint64_t num_threads,
+                               IntersectGroup intersect_group) {
+    assert(colors.empty());
+    const uint64_t num_groups = std::min(num_threads, iterators.size() / min_color_sets_per_thread);
+    assert(num_groups > 1);
+
+    std::vector<uint64_t> by_size(iterators.size());
+    std::iota(by_size.begin(), by_size.end(), 0);
+    std::sort(by_size.begin(), by_size.end(), [&](uint64_t x, uint64_t y) {
+        return iterators[x].size() < iterators[y].size();
+    });
+    std::vector<std::vector<Iterator>> groups(num_groups);
+    for (uint64_t i = 0; i != by_size.size(); ++i) {
+        groups[i % num_groups].push_back(iterators[by_size[i]]);
+    }
+
+    std::vector<std::vector<uint32_t>> partial(num_groups);
+    std::vector<std::thread> threads(num_groups);
+    for (uint64_t g = 0; g != num_groups; ++g) {
+        threads[g] = std::thread([&, g]() { intersect_group(groups[g], partial[g]); });
+    }
+    for (auto& t : threads) t.join();
+
+    for (uint64_t step = 1; step < num_groups; step *= 2) {
+        threads.clear();
+        for (uint64_t g = 0; g + step < num_groups; g += 2 * step) {
+            threads.push_back(std::thread([&, g, step]() {
+                std::vector<uint32_t> out;
+                std::set_intersection(partial[g].begin(), partial[g].end(),
+                                      partial[g + step].begin(), partial[g + step].end(),
+                                      std::back_inserter(out));
+                partial[g].swap(out);
+            }));
+        }
+        for (auto& t : threads) t.join();
+    }
+    colors.swap(partial[0]);
 }
 
 template <typename ColorClasses>
 void index<ColorClasses>::pseudoalign_full_intersection(std::string const& sequence,
-                                                        std::vector<uint32_t>& colors) const {
+                                                        std::vector<uint32_t>& colors,
+                                                        uint64_t num_threads) const {
     if (sequence.length() < m_k2u.k()) return;
     colors.clear();
     std::vector<uint64_t> unitig_ids;
-    stream_through(m_k2u, sequence, unitig_ids);
-    intersect_unitigs(unitig_ids, colors);
+    stream_through(m_k2u, sequence, unitig_ids, num_threads);
+    intersect_unitigs(unitig_ids, colors, num_threads);
 }
 
 template <typename ColorClasses>
 void index<ColorClasses>::intersect_unitigs(std::vector<uint64_t>& unitig_ids,
-                                            std::vector<uint32_t>& colors) const {
+                                            std::vector<uint32_t>& colors,
+                                            uint64_t num_threads) const {
     /* here we use it to hold the color class ids;
        in meta_intersect we use it to hold the partition ids */
     std::vector<uint32_t> tmp;
@@ -321,7 +776,16 @@ void index<ColorClasses>::intersect_unitigs(std::vector<uint64_t>& unitig_ids,
 
     tmp.clear();  // don't need color class ids anymore
     if constexpr (ColorClasses::meta_colored) {
-        meta_intersect(iterators, colors, tmp);
+        meta_intersect(iterators, colors, tmp, num_threads);
+    } else if (num_threads > 1 and iterators.size() >= 2 * min_color_sets_per_thread) {
+        parallel_intersect(iterators, colors, num_threads, [](auto& group, auto& group_colors) {
+            if constexpr (ColorClasses::differential_colored) {
+                diff_intersect(group, group_colors);
+            } else {
+                std::vector<uint32_t> group_tmp;
+                intersect(group, group_colors, group_tmp);
+            }
+        });
     } else if constexpr (ColorClasses::differential_colored) {
         diff_intersect(iterators, colors);
     } else {
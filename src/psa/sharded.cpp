@@ -0,0 +1,132 @@
+#include "include/sharded_index.hpp"
+
+namespace fulgor {
+
+/* As stream_through, but also marks the positions of the positive k-mers in positive_kmers
+   and returns the number of positive k-mers. */
+uint64_t stream_through(sshash::dictionary const& k2u, std::string const& sequence,
+                        std::vector<uint64_t>& unitig_ids, std::vector<uint64_t>& positive_kmers) {
+    sshash::streaming_query_canonical_parsing query(&k2u);
+    query.start();
+    const uint64_t num_kmers = sequence.length() - k2u.k() + 1;
+    uint64_t num_positive_kmers_in_sequence = 0;
+    for (uint64_t i = 0, prev_unitig_id = -1; i != num_kmers; ++i) {
+        char const* kmer = sequence.data() + i;
+        auto answer = query.lookup_advanced(kmer);
+        if (answer.kmer_id != sshash::constants::invalid_uint64) {  // kmer is positive
+            num_positive_kmers_in_sequence += 1;
+            positive_kmers[i / 64] |= uint64_t(1) << (i % 64);
+            if (answer.contig_id != prev_unitig_id) {
+                unitig_ids.push_back(answer.contig_id);
+                prev_unitig_id = answer.contig_id;
+            }
+        }
+    }
+    return num_positive_kmers_in_sequence;
+}
+
+uint64_t stream_through_with_multiplicities(sshash::dictionary const& k2u,
+                                            std::string const& sequence,
+                                            std::vector<scored_id>& unitig_ids,
+                                            std::vector<uint64_t>& positive_kmers) {
+    sshash::streaming_query_canonical_parsing query(&k2u);
+    query.start();
+    const uint64_t num_kmers = sequence.length() - k2u.k() + 1;
+    uint64_t num_positive_kmers_in_sequence = 0;
+    for (uint64_t i = 0, prev_unitig_id = -1; i != num_kmers; ++i) {
+        char const* kmer = sequence.data() + i;
+        auto answer = query.lookup_advanced(kmer);
+        if (answer.kmer_id != sshash::constants::invalid_uint64) {  // kmer is positive
+            num_positive_kmers_in_sequence += 1;
+            positive_kmers[i / 64] |= uint64_t(1) << (i % 64);
+            if (answer.contig_id != prev_unitig_id) {
+                unitig_ids.push_back({answer.contig_id, 1});
+                prev_unitig_id = answer.contig_id;
+            } else {
+                assert(!unitig_ids.empty());
+                unitig_ids.back().score += 1;
+            }
+        }
+    }
+    return num_positive_kmers_in_sequence;
+}
+
+static uint64_t num_ones(std::vector<uint64_t> const& bits) {
+    uint64_t n = 0;
+    for (uint64_t w : bits) n += __builtin_popcountll(w);
+    return n;
+}
+
+/*
+    A k-mer is positive for the sharded index if it is positive in at least one shard.
+    Since the shards index disjoint sets of references, a reference of shard s contains
+    all the positive k-mers of the sequence only if shard s sees all of them as positive:
+    the shards that miss some positive k-mer cannot contribute to the result and are not
+    intersected at all. The results of the other shards are exact and are mapped to global
+    doc ids by adding the doc offset of the shard, which keeps them sorted.
+*/
+template <typename Index>
+void sharded_index<Index>::pseudoalign_full_intersection(std::string const& sequence,
+                                                         std::vector<uint32_t>& colors) const {
+    if (sequence.length() < k()) return;
+    colors.clear();
+
+    const uint64_t num_kmers = sequence.length() - k() + 1;
+    std::vector<uint64_t> positive_kmers((num_kmers + 63) / 64, 0);  // union over the shards
+    std::vector<std::vector<uint64_t>> unitig_ids(num_shards());
+    std::vector<uint64_t> num_positive_kmers(num_shards());
+    for (uint64_t i = 0; i != num_shards(); ++i) {
+        num_positive_kmers[i] = stream_through(m_shards[i].get_k2u(), sequence, unitig_ids[i],
+                                               positive_kmers);
+    }
+
+    const uint64_t num_positive_kmers_in_sequence = num_ones(positive_kmers);
+    if (num_positive_kmers_in_sequence == 0) return;
+
+    std::vector<uint32_t> shard_colors;
+    for (uint64_t i = 0; i != num_shards(); ++i) {
+        if (num_positive_kmers[i] != num_positive_kmers_in_sequence) continue;
+        m_shards[i].intersect_unitigs(unitig_ids[i], shard_colors);
+        const uint32_t doc_offset = m_manifest.doc_offset(i);
+        for (uint32_t c : shard_colors) colors.push_back(doc_offset + c);
+        shard_colors.clear();
+    }
+}
+
+/*
+    The score of a reference only depends on the k-mers of its own shard,
+    so it is computed exactly by the shard. Instead, the minimum score depends on
+    the number of k-mers that are positive in any shard.
+*/
+template <typename Index>
+void sharded_index<Index>::pseudoalign_threshold_union(std::string const& sequence,
+                                                       std::vector<uint32_t>& colors,
+                                                       const double threshold) const {
+    if (sequence.length() < k()) return;
+    colors.clear();
+
+    const uint64_t num_kmers = sequence.length() - k() + 1;
+    std::vector<uint64_t> positive_kmers((num_kmers + 63) / 64, 0);  // union over the shards
+    std::vector<std::vector<scored_id>> unitig_ids(num_shards());
+    for (uint64_t i = 0; i != num_shards(); ++i) {
+        stream_through_with_multiplicities(m_shards[i].get_k2u(), sequence, unitig_ids[i],
+                                           positive_kmers);
+    }
+
+    const uint64_t num_positive_kmers_in_sequence = num_ones(positive_kmers);
+    if (num_positive_kmers_in_sequence == 0) return;
+
+    /* as Themisto does */
+    uint64_t min_score = static_cast<double>(num_positive_kmers_in_sequence) * threshold;
+
+    std::vector<uint32_t> shard_colors;
+    for (uint64_t i = 0; i != num_shards(); ++i) {
+        if (unitig_ids[i].empty()) continue;
+        threshold_union(m_shards[i], unitig_ids[i], min_score, shard_colors);
+        const uint32_t doc_offset = m_manifest.doc_offset(i);
+        for (uint32_t c : shard_colors) colors.push_back(doc_offset + c);
+        shard_colors.clear();
+    }
+}
+
+}  // namespace fulgor
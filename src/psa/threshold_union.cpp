@@ -67,24 +67,13 @@ uint64_t stream_through_with_multiplicities(sshash::dictionary const& k2u,
     return num_positive_kmers_in_sequence;
 }
 
-template <typename ColorClasses>
-void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequence,
-                                                      std::vector<uint32_t>& colors,
-                                                      const double threshold) const {
-    if (sequence.length() < m_k2u.k()) return;
-    colors.clear();
-
-    std::vector<scored_id> unitig_ids;
-    uint64_t num_positive_kmers_in_sequence =
-        stream_through_with_multiplicities(m_k2u, sequence, unitig_ids);
-
-    /* num_positive_kmers_in_sequence must be equal to the sum of the scores  */
-    assert(num_positive_kmers_in_sequence ==
-           std::accumulate(unitig_ids.begin(), unitig_ids.end(), uint64_t(0),
-                           [](uint64_t curr_sum, auto const& u) { return curr_sum + u.score; }));
-
+/* Unites the color sets of the given unitigs, weighted by the scores of the unitigs,
+   and keeps the colors whose total score is at least min_score. */
+template <typename Index>
+void threshold_union(Index const& index, std::vector<scored_id>& unitig_ids,
+                     const uint64_t min_score, std::vector<uint32_t>& colors) {
     std::vector<scored_id> color_set_ids;
-    std::vector<scored<typename ColorClasses::iterator_type>> iterators;
+    std::vector<scored<typename Index::color_classes_type::iterator_type>> iterators;
 
     /* deduplicate unitig_ids */
     std::sort(unitig_ids.begin(), unitig_ids.end(),
@@ -93,7 +82,7 @@ void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequenc
     for (uint64_t i = 0; i != unitig_ids.size(); ++i) {
         uint32_t unitig_id = unitig_ids[i].item;
         if (unitig_id != prev_unitig_id) {
-            uint32_t color_set_id = u2c(unitig_id);
+            uint32_t color_set_id = index.u2c(unitig_id);
             color_set_ids.push_back({color_set_id, unitig_ids[i].score});
             prev_unitig_id = unitig_id;
         } else {
@@ -109,7 +98,7 @@ void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequenc
     for (uint64_t i = 0; i != color_set_ids.size(); ++i) {
         uint64_t color_set_id = color_set_ids[i].item;
         if (color_set_id != prev_color_set_id) {
-            auto fwd_it = m_ccs.color_set(color_set_id);
+            auto fwd_it = index.color_set(color_set_id);
             iterators.push_back({fwd_it, color_set_ids[i].score});
             prev_color_set_id = color_set_id;
         } else {
@@ -118,6 +107,25 @@ void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequenc
         }
     }
 
+    merge(iterators, colors, min_score);
+}
+
+template <typename ColorClasses>
+void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequence,
+                                                      std::vector<uint32_t>& colors,
+                                                      const double threshold) const {
+    if (sequence.length() < m_k2u.k()) return;
+    colors.clear();
+
+    std::vector<scored_id> unitig_ids;
+    uint64_t num_positive_kmers_in_sequence =
+        stream_through_with_multiplicities(m_k2u, sequence, unitig_ids);
+
+    /* num_positive_kmers_in_sequence must be equal to the sum of the scores  */
+    assert(num_positive_kmers_in_sequence ==
+           std::accumulate(unitig_ids.begin(), unitig_ids.end(), uint64_t(0),
+                           [](uint64_t curr_sum, auto const& u) { return curr_sum + u.score; }));
+
     /* as Themisto does */
     uint64_t min_score = static_cast<double>(num_positive_kmers_in_sequence) * threshold;
 
@@ -125,7 +133,7 @@ void index<ColorClasses>::pseudoalign_threshold_union(std::string const& sequenc
     // uint64_t num_kmers_in_sequence = sequence.length() - m_k2u.k() + 1;
     // uint64_t min_score = static_cast<double>(num_kmers_in_sequence) * threshold;
 
-    merge(iterators, colors, min_score);
+    threshold_union(*this, unitig_ids, min_score, colors);
 }
 
 }  // namespace fulgor
@@ -0,0 +1,128 @@
+using namespace fulgor;
+
+/*
+    Run the rank queries, returning the time in nanoseconds per query.
+    If dependent, every query position is mixed with the result of the previous
+    query, so that the queries cannot overlap and the latency of each is measured
+    (as when a u2c lookup is followed by the access to the color set).
+*/
+template <typename RankedBitVector>
+static double time_ranks(RankedBitVector const& bits, std::vector<uint64_t> const& queries,
+                         bool dependent, uint64_t& checksum) {
+    essentials::timer<std::chrono::high_resolution_clock, std::chrono::nanoseconds> timer;
+    uint64_t sum = 0;
+    timer.start();
+    if (dependent) {
+        uint64_t prev = 0;
+        for (auto pos : queries) {
+            prev = bits.rank((pos ^ prev) % bits.size());
+            sum += prev;
+        }
+    } else {
+        for (auto pos : queries) sum += bits.rank(pos);
+    }
+    timer.stop();
+    checksum = sum;
+    return static_cast<double>(timer.elapsed()) / queries.size();
+}
+
+template <typename FulgorIndex>
+void bench_u2c(std::string const& index_filename, uint64_t num_queries, uint64_t seed) {
+    FulgorIndex index;
+    essentials::logger("loading index from disk...");
+    load_index(index, index_filename);
+    essentials::logger("DONE");
+
+    auto const& u2c = index.get_u2c();
+    const uint64_t num_unitigs = u2c.size();
+    const uint64_t num_color_sets = u2c.num_ones();
+
+    /* the bit vector of the u2c map, with a one at the last unitig of each color set */
+    ranked_bit_vector current;
+    interleaved_ranked_bit_vector interleaved;
+    auto build = [&](auto& bits) {
+        pthash::bit_vector_builder bvb(num_unitigs, 0);
+        for (uint64_t i = 0; i != num_color_sets; ++i) bvb.set(u2c.select(i), 1);
+        bits.build(&bvb);
+    };
+    build(current);
+    build(interleaved);
+    if (current.num_ones() != num_color_sets or interleaved.num_ones() != num_color_sets) {
+        throw std::runtime_error("wrong number of ones in the u2c bit vector");
+    }
+
+    std::cout << "u2c: " << num_unitigs << " unitigs, " << num_color_sets << " color sets"
+              << std::endl;
+    auto print_space = [&](std::string const& name, uint64_t bytes) {
+        std::cout << "  " << name << ": " << bytes << " bytes ("
+                  << (bytes * 8.0) / num_unitigs << " bits/unitig)" << std::endl;
+    };
+    print_space("ranked_bit_vector", current.bytes());
+    print_space("interleaved_ranked_bit_vector", interleaved.bytes());
+    print_space(std::string("u2c map (") +
+                    (u2c.type() == u2c_map::elias_fano ? "Elias-Fano" : "bit vector") + ")",
+                u2c.bytes());
+
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> random_queries(num_queries);
+    for (auto& pos : random_queries) pos = rng() % num_unitigs;
+    std::vector<uint64_t> sequential_queries(num_queries);
+    for (uint64_t i = 0; i != num_queries; ++i) sequential_queries[i] = i % num_unitigs;
+
+    auto run = [&](std::string const& name, std::vector<uint64_t> const& queries,
+                   bool dependent) {
+        uint64_t expected = 0, got = 0;
+        const double current_ns = time_ranks(current, queries, dependent, expected);
+        const double interleaved_ns = time_ranks(interleaved, queries, dependent, got);
+        if (got != expected) throw std::runtime_error("interleaved rank is wrong");
+        const double u2c_ns = time_ranks(u2c, queries, dependent, got);
+        if (got != expected) throw std::runtime_error("u2c rank is wrong");
+        std::cout << name << " rank queries (" << num_queries << "):\n"
+                  << "  ranked_bit_vector: " << current_ns << " ns/query\n"
+                  << "  interleaved_ranked_bit_vector: " << interleaved_ns << " ns/query\n"
+                  << "  u2c map: " << u2c_ns << " ns/query" << std::endl;
+    };
+    run("random", random_queries, false);
+    run("random dependent", random_queries, true);
+    run("sequential", sequential_queries, false);
+}
+
+int bench_u2c(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("index_filename", "The Fulgor index filename.", "-i", true);
+    parser.add("num_queries", "Number of rank queries per run (default is 10000000).", "-n",
+               false);
+    parser.add("seed", "Seed of the random queries (default is 0).", "--seed", false);
+    if (!parser.parse()) return 1;
+    util::print_cmd(argc, argv);
+
+    auto index_filename = parser.get<std::string>("index_filename");
+    uint64_t num_queries = 10000000;
+    if (parser.parsed("num_queries")) num_queries = parser.get<uint64_t>("num_queries");
+    uint64_t seed = 0;
+    if (parser.parsed("seed")) seed = parser.get<uint64_t>("seed");
+    if (num_queries == 0) {
+        std::cerr << "Error: the number of queries must be positive." << std::endl;
+        return 1;
+    }
+
+    if (is_sharded(index_filename)) {
+        std::cerr << "Error: '" << index_filename << "' is a sharded index: run on its shards."
+                  << std::endl;
+        return 1;
+    } else if (is_meta_diff(index_filename)) {
+        bench_u2c<meta_differential_index_type>(index_filename, num_queries, seed);
+    } else if (is_meta(index_filename)) {
+        bench_u2c<meta_index_type>(index_filename, num_queries, seed);
+    } else if (is_diff(index_filename)) {
+        bench_u2c<differential_index_type>(index_filename, num_queries, seed);
+    } else if (is_roaring(index_filename)) {
+        bench_u2c<roaring_index_type>(index_filename, num_queries, seed);
+    } else if (is_hybrid(index_filename)) {
+        bench_u2c<index_type>(index_filename, num_queries, seed);
+    } else {
+        std::cerr << "Wrong filename supplied." << std::endl;
+        return 1;
+    }
+    return 0;
+}
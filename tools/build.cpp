@@ -1,12 +1,46 @@
 using namespace fulgor;
 
-void partition(build_configuration const& build_config) {
+/* store the partition bitmaps of a meta-colored index, if it has few enough partitions */
+template <typename Index>
+void build_partition_bitmaps(Index& index) {
+    const uint64_t num_partitions = index.get_color_sets().num_partitions();
+    if (num_partitions > constants::max_num_partitions_for_bitmaps) {
+        std::cerr << "Warning: the partition bitmaps are not built: " << num_partitions
+                  << " partitions, but at most " << constants::max_num_partitions_for_bitmaps
+                  << " are supported." << std::endl;
+        return;
+    }
+    index.build_partition_bitmaps();
+}
+
+/* option '--store-sizes', shared by the tools that build an index */
+void add_store_sizes_option(cmd_line_parser::parser& parser) {
+    parser.add("store_sizes",
+               "Store the size of each color set apart from it, so that sizes are read without "
+               "decoding the color sets (a few bits per color set).",
+               "--store-sizes", false, true);
+}
+
+/* option '--partition-bitmaps', shared by the tools that build a meta-colored index */
+void add_partition_bitmaps_option(cmd_line_parser::parser& parser, std::string const& usage = "") {
+    parser.add("partition_bitmaps",
+               "Store the partitions of each meta color set as a bitmap, to intersect them word "
+               "by word (if there are at most " +
+                   std::to_string(constants::max_num_partitions_for_bitmaps) + " partitions" +
+                   usage + ").",
+               "--partition-bitmaps", false, true);
+}
+
+/* if layered, the index references the k2u and u2c maps of the partitioned index */
+void partition(build_configuration const& build_config, bool layered) {
     essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
     timer.start();
 
     meta_index_type index;
     typename meta_index_type::meta_builder builder(build_config);
     builder.build(index);
+    if (build_config.store_color_set_sizes) index.build_color_set_sizes();
+    if (build_config.store_partition_bitmaps) build_partition_bitmaps(index);
     index.print_stats();
 
     timer.stop();
@@ -19,7 +53,11 @@ void partition(build_configuration const& build_config) {
                                              constants::fulgor_filename_extension.length() - 1) +
                                   "." + constants::meta_colored_fulgor_filename_extension;
     essentials::logger("saving index to disk...");
-    essentials::save(index, output_filename.c_str());
+    if (layered) {
+        save_layered(index, build_config.index_filename_to_partition, output_filename);
+    } else {
+        essentials::save(index, output_filename.c_str());
+    }
     essentials::logger("DONE");
 }
 
@@ -30,6 +68,7 @@ void differential_coloring(build_configuration const& build_config) {
     differential_index_type index;
     typename differential_index_type::differential_builder builder(build_config);
     builder.build(index);
+    if (build_config.store_color_set_sizes) index.build_color_set_sizes();
     index.print_stats();
 
     timer.stop();
@@ -53,6 +92,8 @@ void meta_differential_coloring(build_configuration const& build_config) {
     meta_differential_index_type index;
     typename meta_differential_index_type::meta_differential_builder builder(build_config);
     builder.build(index);
+    if (build_config.store_color_set_sizes) index.build_color_set_sizes();
+    if (build_config.store_partition_bitmaps) build_partition_bitmaps(index);
     index.print_stats();
 
     timer.stop();
@@ -70,6 +111,27 @@ void meta_differential_coloring(build_configuration const& build_config) {
     essentials::logger("DONE");
 }
 
+template <typename FulgorIndex>
+void build(build_configuration const& build_config, std::string const& output_filename) {
+    essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+    timer.start();
+
+    FulgorIndex index;
+    typename FulgorIndex::builder builder(build_config);
+    builder.build(index);
+    if (build_config.store_color_set_sizes) index.build_color_set_sizes();
+    index.print_stats();
+
+    timer.stop();
+    essentials::logger("DONE");
+    std::cout << "** building the index took " << timer.elapsed() << " seconds / "
+              << timer.elapsed() / 60 << " minutes" << std::endl;
+
+    essentials::logger("saving index to disk...");
+    essentials::save(index, output_filename.c_str());
+    essentials::logger("DONE");
+}
+
 int build(int argc, char** argv) {
     cmd_line_parser::parser parser(argc, argv);
     parser.add("filenames_list", "Filenames list.", "-l", true);
@@ -94,17 +156,97 @@ int build(int argc, char** argv) {
                "--force", false, true);
     parser.add("meta", "Build a meta-colored index.", "--meta", false, true);
     parser.add("diff", "Build a differential-colored index.", "--diff", false, true);
+    parser.add("roaring",
+               "Build an index whose color sets are coded with roaring-style containers, with "
+               "extension \"." +
+                   constants::roaring_colored_fulgor_filename_extension + "\".",
+               "--roaring", false, true);
+    parser.add("optimize",
+               "Calibrate the list thresholds of the color sets on a sample of them, for 'space', "
+               "'speed', or 'balanced'. By default, the lists with less than 0.25 (resp. at "
+               "least 0.75) times the number of references are coded sparse (resp. as "
+               "complements).",
+               "--optimize", false);
+    parser.add("layered",
+               "Do not store the k2u and u2c maps in the meta-colored index, but reference those "
+               "of the built index (used with '--meta').",
+               "--layered", false, true);
+    parser.add("max_representatives",
+               "Maximum number of representatives per cluster of color sets (used with '--diff'; "
+               "default is 1).",
+               "--max-representatives", false);
+    parser.add("query_weights",
+               "Choose the representatives weighing each color set by its number of unitigs "
+               "('unitigs') or by the number of reads of a FASTA/FASTQ sample that hit it (the "
+               "sample filename), instead of by majority vote (used with '--diff', but not with "
+               "'--meta').",
+               "--query-weights", false);
+    add_store_sizes_option(parser);
+    add_partition_bitmaps_option(parser, "; used with '--meta'");
+    parser.add("sketch_sampling_rate",
+               "Fraction of the unitigs that are sketched to cluster the references, in (0,1] "
+               "(used with '--meta'; default is 1).",
+               "--sketch-sampling-rate", false);
 
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
 
     build_configuration build_config;
     build_config.file_base_name = parser.get<std::string>("file_base_name");
-    std::string output_filename =
-        build_config.file_base_name + "." + constants::fulgor_filename_extension;
     bool force = parser.get<bool>("force");
     bool meta_colored = parser.get<bool>("meta");
     bool diff_colored = parser.get<bool>("diff");
+    bool roaring_colored = parser.get<bool>("roaring");
+    std::string output_filename =
+        build_config.file_base_name + "." +
+        (roaring_colored ? constants::roaring_colored_fulgor_filename_extension
+                         : constants::fulgor_filename_extension);
+
+    if (parser.parsed("optimize")) {
+        auto target = parser.get<std::string>("optimize");
+        if (target == "space") {
+            build_config.optimize = optimize_target::space;
+        } else if (target == "speed") {
+            build_config.optimize = optimize_target::speed;
+        } else if (target == "balanced") {
+            build_config.optimize = optimize_target::balanced;
+        } else {
+            std::cerr << "Error: '--optimize' must be 'space', 'speed', or 'balanced'."
+                      << std::endl;
+            return 1;
+        }
+        if (roaring_colored) {
+            std::cerr << "Error: option '--optimize' cannot be used with '--roaring'." << std::endl;
+            return 1;
+        }
+    }
+
+    if (parser.parsed("max_representatives")) {
+        build_config.max_representatives = parser.get<uint32_t>("max_representatives");
+    }
+    if (parser.parsed("query_weights")) {
+        build_config.query_weights = parser.get<std::string>("query_weights");
+        if (meta_colored) {
+            std::cerr << "Error: option '--query-weights' cannot be used with '--meta'."
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (parser.parsed("sketch_sampling_rate")) {
+        build_config.sketch_sampling_rate = parser.get<double>("sketch_sampling_rate");
+        if (!(build_config.sketch_sampling_rate > 0.0 and
+              build_config.sketch_sampling_rate <= 1.0)) {
+            std::cerr << "Error: '--sketch-sampling-rate' must be in (0,1]." << std::endl;
+            return 1;
+        }
+    }
+
+    if (roaring_colored and (meta_colored or diff_colored)) {
+        std::cerr << "Error: option '--roaring' cannot be used with '--meta' or '--diff'."
+                  << std::endl;
+        return 1;
+    }
 
     if (parser.parsed("tmp_dirname")) {
         build_config.tmp_dirname = parser.get<std::string>("tmp_dirname");
@@ -132,34 +274,25 @@ int build(int argc, char** argv) {
     build_config.m = m;
     build_config.verbose = parser.get<bool>("verbose");
     build_config.check = parser.get<bool>("check");
+    build_config.store_color_set_sizes = parser.get<bool>("store_sizes");
+    build_config.store_partition_bitmaps = parser.get<bool>("partition_bitmaps");
     build_config.filenames_list = parser.get<std::string>("filenames_list");
     if (parser.get<uint64_t>("RAM")) {
         build_config.ram_limit_in_GiB = parser.get<uint64_t>("RAM");
     }
 
-    essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
-    timer.start();
-
-    index_type index;
-    typename index_type::builder builder(build_config);
-    builder.build(index);
-    index.print_stats();
-
-    timer.stop();
-    essentials::logger("DONE");
-    std::cout << "** building the index took " << timer.elapsed() << " seconds / "
-              << timer.elapsed() / 60 << " minutes" << std::endl;
-
-    essentials::logger("saving index to disk...");
-    essentials::save(index, output_filename.c_str());
-    essentials::logger("DONE");
+    if (roaring_colored) {
+        build<roaring_index_type>(build_config, output_filename);
+        return 0;
+    }
+    build<index_type>(build_config, output_filename);
 
     if (meta_colored && diff_colored) {
         build_config.index_filename_to_partition = output_filename;
         meta_differential_coloring(build_config);
     } else if (meta_colored) {
         build_config.index_filename_to_partition = output_filename;
-        partition(build_config);
+        partition(build_config, parser.get<bool>("layered"));
     } else if (diff_colored) {
         build_config.index_filename_to_partition = output_filename;
         differential_coloring(build_config);
@@ -179,6 +312,16 @@ int partition(int argc, char** argv) {
     parser.add("num_threads", "Number of threads (default is 1).", "-t", false);
     parser.add("check", "Check correctness after index construction (it might take some time).",
                "--check", false, true);
+    parser.add("layered",
+               "Do not store the k2u and u2c maps in the meta-colored index, but reference those "
+               "of the index to partition, which must then be kept.",
+               "--layered", false, true);
+    add_store_sizes_option(parser);
+    add_partition_bitmaps_option(parser);
+    parser.add("sketch_sampling_rate",
+               "Fraction of the unitigs that are sketched to cluster the references, in (0,1] "
+               "(default is 1).",
+               "--sketch-sampling-rate", false);
 
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
@@ -193,6 +336,14 @@ int partition(int argc, char** argv) {
                   << std::endl;
         return 1;
     }
+    if (parser.parsed("sketch_sampling_rate")) {
+        build_config.sketch_sampling_rate = parser.get<double>("sketch_sampling_rate");
+        if (!(build_config.sketch_sampling_rate > 0.0 and
+              build_config.sketch_sampling_rate <= 1.0)) {
+            std::cerr << "Error: '--sketch-sampling-rate' must be in (0,1]." << std::endl;
+            return 1;
+        }
+    }
 
     if (parser.parsed("tmp_dirname")) {
         build_config.tmp_dirname = parser.get<std::string>("tmp_dirname");
@@ -202,8 +353,10 @@ int partition(int argc, char** argv) {
         build_config.num_threads = parser.get<uint64_t>("num_threads");
     }
     build_config.check = parser.get<bool>("check");
+    build_config.store_color_set_sizes = parser.get<bool>("store_sizes");
+    build_config.store_partition_bitmaps = parser.get<bool>("partition_bitmaps");
 
-    partition(build_config);
+    partition(build_config, parser.get<bool>("layered"));
 
     return 0;
 }
@@ -219,6 +372,15 @@ int diff(int argc, char** argv) {
     parser.add("num_threads", "Number of threads (default is 1).", "-t", false);
     parser.add("check", "Check correctness after index construction (it might take some time).",
                "--check", false, true);
+    parser.add("max_representatives",
+               "Maximum number of representatives per cluster of color sets (default is 1).",
+               "--max-representatives", false);
+    parser.add("query_weights",
+               "Choose the representatives weighing each color set by its number of unitigs "
+               "('unitigs') or by the number of reads of a FASTA/FASTQ sample that hit it (the "
+               "sample filename), instead of by majority vote.",
+               "--query-weights", false);
+    add_store_sizes_option(parser);
 
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
@@ -242,6 +404,13 @@ int diff(int argc, char** argv) {
         build_config.num_threads = parser.get<uint64_t>("num_threads");
     }
     build_config.check = parser.get<bool>("check");
+    build_config.store_color_set_sizes = parser.get<bool>("store_sizes");
+    if (parser.parsed("max_representatives")) {
+        build_config.max_representatives = parser.get<uint32_t>("max_representatives");
+    }
+    if (parser.parsed("query_weights")) {
+        build_config.query_weights = parser.get<std::string>("query_weights");
+    }
 
     differential_coloring(build_config);
 
@@ -259,6 +428,11 @@ int meta_diff(int argc, char** argv) {
     parser.add("num_threads", "Number of threads (default is 1).", "-t", false);
     parser.add("check", "Check correctness after index construction (it might take some time).",
                "--check", false, true);
+    parser.add("max_representatives",
+               "Maximum number of representatives per cluster of color sets (default is 1).",
+               "--max-representatives", false);
+    add_store_sizes_option(parser);
+    add_partition_bitmaps_option(parser);
 
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
@@ -282,6 +456,11 @@ int meta_diff(int argc, char** argv) {
         build_config.num_threads = parser.get<uint64_t>("num_threads");
     }
     build_config.check = parser.get<bool>("check");
+    build_config.store_color_set_sizes = parser.get<bool>("store_sizes");
+    build_config.store_partition_bitmaps = parser.get<bool>("partition_bitmaps");
+    if (parser.parsed("max_representatives")) {
+        build_config.max_representatives = parser.get<uint32_t>("max_representatives");
+    }
 
     meta_differential_coloring(build_config);
 
@@ -9,6 +9,11 @@
 #include "build.cpp"
 #include "permute.cpp"
 #include "pseudoalign.cpp"
+#include "shard.cpp"
+#include "reorder_unitigs.cpp"
+#include "bench_u2c.cpp"
+#include "hot_layout.cpp"
+#include "profile_report.cpp"
 
 int help(char* arg0) {
     std::cout << "== Fulgor: a colored de Bruijn graph index "
@@ -32,6 +37,11 @@ int help(char* arg0) {
         << "  meta               partition a Fulgor index and build a meta-colored Fulgor index\n"
         << "  differential       partition a Fulgor index and build a differential-colored Fulgor index\n"
         << "  meta-differential  partition a Fulgor index and build a meta-differential-colored Fulgor index\n"
+        << "  shard              build the manifest of a sharded index over Fulgor indexes of disjoint references\n"
+        << "  reorder-unitigs    renumber the unitigs of a Fulgor index following the de Bruijn graph\n"
+        << "  bench-u2c          benchmark the rank queries of the unitig-to-color-set map\n"
+        << "  hot-layout         store the most accessed color sets of a Fulgor index uncompressed\n"
+        << "  profile-report     print the statistics of a profile written by pseudoalign\n"
         << "  dump               write unitigs and colors to output files in text format\n";
     // << "  dump-colors        write colors to an output file in text format" << std::endl;
 
@@ -63,6 +73,16 @@ int main(int argc, char** argv) {
         return diff(argc - 1, argv + 1);
     } else if (tool == "meta-differential") {
         return meta_diff(argc - 1, argv + 1);
+    } else if (tool == "shard") {
+        return shard(argc - 1, argv + 1);
+    } else if (tool == "reorder-unitigs") {
+        return reorder_unitigs(argc - 1, argv + 1);
+    } else if (tool == "bench-u2c") {
+        return bench_u2c(argc - 1, argv + 1);
+    } else if (tool == "hot-layout") {
+        return hot_layout(argc - 1, argv + 1);
+    } else if (tool == "profile-report") {
+        return profile_report(argc - 1, argv + 1);
     } else if (tool == "dump") {
         return dump(argc - 1, argv + 1);
     }
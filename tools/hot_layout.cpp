@@ -0,0 +1,101 @@
+using namespace fulgor;
+
+/*
+    Read the number of accesses to each color set id from a profile in text format:
+    one line "color_set_id num_accesses" per accessed color set (the color sets that
+    do not appear have no accesses; repeated ids are summed).
+*/
+static std::vector<uint64_t> read_color_set_accesses(std::string const& filename,
+                                                      uint64_t num_color_sets) {
+    std::ifstream in(filename.c_str());
+    if (!in.is_open()) throw std::runtime_error("cannot open file '" + filename + "'");
+    std::vector<uint64_t> accesses(num_color_sets, 0);
+    uint64_t color_set_id = 0, num_accesses = 0;
+    while (in >> color_set_id >> num_accesses) {
+        if (color_set_id >= num_color_sets) {
+            throw std::runtime_error("color set id " + std::to_string(color_set_id) +
+                                     " out of range in '" + filename + "'");
+        }
+        accesses[color_set_id] += num_accesses;
+    }
+    if (!in.eof()) throw std::runtime_error("malformed profile '" + filename + "'");
+    return accesses;
+}
+
+int hot_layout(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("index_filename",
+               "The Fulgor index filename whose hot color sets are stored uncompressed.", "-i",
+               true);
+    parser.add("profile_filename",
+               "The number of accesses to the color sets in a sample run: one line "
+               "\"color_set_id num_accesses\" per color set.",
+               "-p", true);
+    parser.add("output_filename",
+               "Output filename of the index (it can be the input index itself).", "-o", true);
+    parser.add("fraction",
+               "Maximum fraction of the color sets that are stored uncompressed (default is "
+               "0.01).",
+               "-f", false);
+    parser.add("check", "Check correctness after index construction (it might take some time).",
+               "--check", false, true);
+    if (!parser.parse()) return 1;
+    util::print_cmd(argc, argv);
+
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto output_filename = parser.get<std::string>("output_filename");
+    for (auto const& filename : {index_filename, output_filename}) {
+        if (!sshash::util::ends_with(filename, "." + constants::fulgor_filename_extension)) {
+            std::cerr << "Error: '" << filename << "' must have extension \"."
+                      << constants::fulgor_filename_extension << "\"." << std::endl;
+            return 1;
+        }
+    }
+    double fraction = 0.01;
+    if (parser.parsed("fraction")) fraction = parser.get<double>("fraction");
+    if (fraction < 0 or fraction > 1) {
+        std::cerr << "Error: the fraction must be in [0, 1]." << std::endl;
+        return 1;
+    }
+
+    essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+    timer.start();
+
+    index_type index;
+    essentials::logger("step 1. loading index...");
+    essentials::load(index, index_filename.c_str());
+    essentials::logger("DONE");
+
+    essentials::logger("step 2. reading the profile...");
+    auto accesses = read_color_set_accesses(parser.get<std::string>("profile_filename"),
+                                            index.num_color_sets());
+    essentials::logger("DONE");
+
+    essentials::logger("step 3. storing the hot color sets uncompressed...");
+    index_type hot_index;
+    typename index_type::hot_color_sets_builder builder;
+    builder.build(index, accesses, fraction, hot_index);
+    essentials::logger("DONE");
+
+    if (parser.get<bool>("check")) {
+        essentials::logger("step 4. check correctness...");
+        std::vector<uint32_t> expected(index.num_docs()), got(index.num_docs());
+        for (uint64_t color_set_id = 0; color_set_id != index.num_color_sets(); ++color_set_id) {
+            util::check_color_set(index.color_set(color_set_id),
+                                  hot_index.color_set(color_set_id), color_set_id, expected, got);
+        }
+        essentials::logger("DONE");
+    }
+
+    hot_index.print_stats();
+
+    essentials::logger("saving index to disk...");
+    essentials::save(hot_index, output_filename.c_str());
+    essentials::logger("DONE");
+
+    timer.stop();
+    std::cout << "** storing the hot color sets took " << timer.elapsed() << " seconds / "
+              << timer.elapsed() / 60 << " minutes" << std::endl;
+
+    return 0;
+}
@@ -1,5 +1,70 @@
 using namespace fulgor;
 
+/* intersect the color sets of the queries, returning the time in microseconds */
+static double time_intersections(index_type const& index,
+                                 std::vector<std::vector<uint64_t>> const& queries,
+                                 std::vector<std::vector<uint32_t>>& results) {
+    essentials::timer<std::chrono::high_resolution_clock, std::chrono::microseconds> timer;
+    results.resize(queries.size());
+    timer.start();
+    for (uint64_t i = 0; i != queries.size(); ++i) {
+        auto unitig_ids = queries[i];  // copy
+        results[i].clear();
+        index.intersect_unitigs(unitig_ids, results[i]);
+    }
+    timer.stop();
+    return timer.elapsed();
+}
+
+static double bits_per_int(index_type const& index) {
+    uint64_t num_ints = 0;
+    for (uint64_t color_set_id = 0; color_set_id != index.num_color_sets(); ++color_set_id) {
+        num_ints += index.color_set(color_set_id).size();
+    }
+    return static_cast<double>(index.get_color_sets().num_bits()) / num_ints;
+}
+
+/*
+    Rebuild the index with doc i renamed as permutation[i], reporting the space
+    of the color sets and the time of intersections before and after.
+*/
+void rebuild(index_type& index, std::vector<uint32_t> const& permutation,
+             std::string const& output_filename) {
+    essentials::logger("step 4. rebuilding the index with the permuted references");
+
+    constexpr uint64_t num_queries = 10000;
+    std::mt19937_64 rng(0);
+    std::vector<std::vector<uint64_t>> queries(num_queries);
+    for (auto& q : queries) q = {rng() % index.num_unitigs(), rng() % index.num_unitigs()};
+
+    std::vector<std::vector<uint32_t>> expected, got;
+    const double bits_per_int_before = bits_per_int(index);
+    const double time_before = time_intersections(index, queries, expected);
+
+    index_type permuted_index;
+    typename index_type::permuted_references_builder builder;
+    builder.build(index, permutation, permuted_index);
+
+    const double bits_per_int_after = bits_per_int(permuted_index);
+    const double time_after = time_intersections(permuted_index, queries, got);
+    for (uint64_t i = 0; i != num_queries; ++i) {
+        for (auto& doc : expected[i]) doc = permutation[doc];
+        std::sort(expected[i].begin(), expected[i].end());
+        if (expected[i] != got[i]) throw std::runtime_error("wrong intersection after permuting");
+    }
+
+    std::cout << "color sets: " << bits_per_int_before << " bits/int before, "
+              << bits_per_int_after << " bits/int after" << std::endl;
+    std::cout << "intersections of " << num_queries << " random pairs of unitigs: "
+              << time_before / num_queries << " musec/query before, "
+              << time_after / num_queries << " musec/query after (speedup "
+              << time_before / time_after << "x)" << std::endl;
+
+    essentials::logger("saving index to disk...");
+    essentials::save(permuted_index, output_filename.c_str());
+    essentials::logger("DONE");
+}
+
 int permute(int argc, char** argv) {
     cmd_line_parser::parser parser(argc, argv);
     parser.add("index_filename",
@@ -10,6 +75,15 @@ int permute(int argc, char** argv) {
             constants::default_tmp_dirname + "'.",
         "-d", false);
     parser.add("output_filename", "Output file where to save the permuted filenames.", "-o", true);
+    parser.add("num_threads", "Number of threads (default is 1).", "-t", false);
+    parser.add("bp",
+               "Order the references to minimize the space of the color sets, by recursive graph "
+               "bisection, instead of clustering the sketches of the references.",
+               "--bp", false, true);
+    parser.add("rebuild",
+               "Rebuild the index with the permuted references and save it to this filename "
+               "(it can be the input index itself).",
+               "-r", false);
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
 
@@ -18,6 +92,9 @@ int permute(int argc, char** argv) {
         build_config.tmp_dirname = parser.get<std::string>("tmp_dirname");
         essentials::create_directory(build_config.tmp_dirname);
     }
+    if (parser.parsed("num_threads")) {
+        build_config.num_threads = parser.get<uint64_t>("num_threads");
+    }
 
     auto index_filename = parser.get<std::string>("index_filename");
 
@@ -37,9 +114,19 @@ int permute(int argc, char** argv) {
     essentials::load(index, index_filename.c_str());
     essentials::logger("DONE");
 
-    permuter p(build_config);
-    p.permute(index);
-    auto const& filenames = p.filenames();
+    std::vector<uint32_t> permutation;
+    std::vector<std::string> filenames;
+    if (parser.get<bool>("bp")) {
+        bp_reorderer p(build_config);
+        p.permute(index);
+        permutation = p.permutation();
+        filenames = p.filenames();
+    } else {
+        permuter p(build_config);
+        p.permute(index);
+        permutation = p.permutation();
+        filenames = p.filenames();
+    }
 
     std::ofstream out(parser.get<std::string>("output_filename").c_str());
     if (!out.is_open()) {
@@ -49,6 +136,8 @@ int permute(int argc, char** argv) {
     for (auto const& fn : filenames) out << fn << '\n';
     out.close();
 
+    if (parser.parsed("rebuild")) rebuild(index, permutation, parser.get<std::string>("rebuild"));
+
     timer.stop();
     essentials::logger("DONE");
     std::cout << "** permuting the reference names took " << timer.elapsed() << " seconds / "
@@ -0,0 +1,126 @@
+using namespace fulgor;
+
+/* percentage of x over total, 0 if total is 0 */
+static double percentage(uint64_t x, uint64_t total) {
+    return total == 0 ? 0.0 : (x * 100.0) / total;
+}
+
+/* the buckets of a query_profile::log_histogram */
+static void print_log_histogram(std::vector<uint64_t> const& buckets) {
+    const uint64_t total = std::accumulate(buckets.begin(), buckets.end(), uint64_t(0));
+    for (uint64_t b = 0; b != buckets.size(); ++b) {
+        if (buckets[b] == 0) continue;
+        const uint64_t lo = b == 0 ? 0 : uint64_t(1) << (b - 1);
+        const uint64_t hi = b == 0 ? 0 : (uint64_t(1) << b) - 1;
+        std::cout << "    [" << lo << ", " << hi << "]: " << buckets[b] << " ("
+                  << percentage(buckets[b], total) << "%)" << std::endl;
+    }
+}
+
+/* number of reads, mean, and histogram of a per-read quantity */
+static void print_per_read(std::string const& name,
+                           query_profile::log_histogram const& histogram) {
+    const uint64_t num_reads = histogram.count();
+    std::cout << name << " per read: mean "
+              << (num_reads == 0 ? 0.0 : double(histogram.sum()) / num_reads) << ", max "
+              << histogram.max() << std::endl;
+    print_log_histogram(histogram.buckets());
+}
+
+/*
+    Print the number of ids accessed, the histogram of their number of accesses, the share of
+    the accesses that go to the most accessed ids, and the top_n most accessed ids.
+*/
+static void print_accesses(std::string const& name, std::vector<uint32_t> const& ids,
+                           std::vector<uint64_t> const& counts, uint64_t num_ids,
+                           uint64_t top_n) {
+    assert(ids.size() == counts.size());
+    const uint64_t num_accesses = std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+    std::cout << name << ": " << ids.size() << "/" << num_ids << " accessed ("
+              << percentage(ids.size(), num_ids) << "%), " << num_accesses << " accesses"
+              << std::endl;
+    if (ids.empty()) return;
+
+    std::vector<uint64_t> by_count(ids.size());
+    std::iota(by_count.begin(), by_count.end(), 0);
+    std::sort(by_count.begin(), by_count.end(), [&](uint64_t x, uint64_t y) {
+        return counts[x] > counts[y] or (counts[x] == counts[y] and ids[x] < ids[y]);
+    });
+
+    std::cout << "  number of accesses:" << std::endl;
+    query_profile::log_histogram histogram;
+    for (uint64_t c : counts) histogram.add(c);
+    print_log_histogram(histogram.buckets());
+
+    /* e.g., to choose the fraction of hot color sets of hot-layout */
+    std::cout << "  share of the accesses to the most accessed " << name << ":" << std::endl;
+    for (double fraction : {0.001, 0.01, 0.1}) {
+        const uint64_t n = std::min<uint64_t>(ids.size(), std::ceil(fraction * num_ids));
+        uint64_t n_accesses = 0;
+        for (uint64_t i = 0; i != n; ++i) n_accesses += counts[by_count[i]];
+        std::cout << "    " << fraction * 100.0 << "% (" << n << "): "
+                  << percentage(n_accesses, num_accesses) << "%" << std::endl;
+    }
+
+    std::cout << "  top-" << top_n << " (id: accesses):" << std::endl;
+    for (uint64_t i = 0; i != std::min<uint64_t>(top_n, ids.size()); ++i) {
+        const uint64_t j = by_count[i];
+        std::cout << "    " << ids[j] << ": " << counts[j] << " ("
+                  << percentage(counts[j], num_accesses) << "%)" << std::endl;
+    }
+}
+
+int profile_report(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("profile_filename", "A profile written by pseudoalign with option --profile-out.",
+               "-p", true);
+    parser.add("top_n", "Number of most accessed unitigs and color sets to print (default is 10).",
+               "-n", false);
+    parser.add("color_sets_filename",
+               "Write the number of accesses to each accessed color set to this file, one line "
+               "\"color_set_id num_accesses\" per color set, as read by hot-layout.",
+               "-o", false);
+    if (!parser.parse()) return 1;
+    util::print_cmd(argc, argv);
+
+    uint64_t top_n = 10;
+    if (parser.parsed("top_n")) top_n = parser.get<uint64_t>("top_n");
+
+    query_profile profile;
+    auto profile_filename = parser.get<std::string>("profile_filename");
+    essentials::logger("loading profile from '" + profile_filename + "'...");
+    essentials::load(profile, profile_filename.c_str());
+    essentials::logger("DONE");
+
+    std::cout << "reads: " << profile.num_reads() << std::endl;
+    const uint64_t num_kmers = profile.num_kmers();
+    std::cout << "k-mers: " << num_kmers << std::endl;
+    std::cout << "  looked up, hit: " << profile.num_hits() << " ("
+              << percentage(profile.num_hits(), num_kmers) << "%)" << std::endl;
+    std::cout << "  looked up, miss: " << profile.num_misses() << " ("
+              << percentage(profile.num_misses(), num_kmers) << "%)" << std::endl;
+    std::cout << "  skipped: " << profile.num_skipped() << " ("
+              << percentage(profile.num_skipped(), num_kmers) << "%)" << std::endl;
+
+    print_per_read("iterators", profile.num_iterators());
+    print_per_read("intersection size", profile.intersection_sizes());
+    print_accesses("unitigs", profile.unitig_ids(), profile.unitig_counts(),
+                   profile.num_unitigs(), top_n);
+    print_accesses("color sets", profile.color_set_ids(), profile.color_set_counts(),
+                   profile.num_color_sets(), top_n);
+
+    if (parser.parsed("color_sets_filename")) {
+        auto color_sets_filename = parser.get<std::string>("color_sets_filename");
+        std::ofstream out(color_sets_filename.c_str());
+        if (!out.is_open()) {
+            std::cerr << "Error: cannot open file '" << color_sets_filename << "'." << std::endl;
+            return 1;
+        }
+        auto const& ids = profile.color_set_ids();
+        auto const& counts = profile.color_set_counts();
+        for (uint64_t i = 0; i != ids.size(); ++i) out << ids[i] << ' ' << counts[i] << '\n';
+        essentials::logger("written the color set accesses to '" + color_sets_filename + "'");
+    }
+
+    return 0;
+}
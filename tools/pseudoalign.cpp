@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <condition_variable>
 
 #include "external/CLI11.hpp"
 #include "external/sshash/include/gz/zip_stream.hpp"
@@ -11,6 +12,8 @@
 #include "kallisto_psa/psa.cpp"
 #include "src/psa/full_intersection.cpp"
 #include "src/psa/threshold_union.cpp"
+#include "src/psa/sharded.cpp"
+#include "include/query_profile.hpp"
 
 using namespace fulgor;
 
@@ -30,6 +33,47 @@ void write_output(std::vector<uint32_t> const& vec, std::ostream& os) {
     os << '\n';
 }
 
+/*
+    With option --long-sequences: a long sequence runs with all the worker threads, one long
+    sequence at a time, while the other workers wait before their next read; a short read
+    waits while a long sequence runs or waits to run. So no more threads work than without
+    the option.
+*/
+struct long_sequence_gate {
+    void enter_short() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() { return m_num_long == 0; });
+        m_num_short += 1;
+    }
+
+    void exit_short() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_num_short -= 1;
+        if (m_num_short == 0) m_cv.notify_all();
+    }
+
+    void enter_long() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_num_long += 1;  // the short reads wait from now on
+        m_cv.wait(lock, [&]() { return m_num_short == 0 and !m_long_running; });
+        m_long_running = true;
+    }
+
+    void exit_long() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_long_running = false;
+        m_num_long -= 1;
+        m_cv.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    uint64_t m_num_short = 0;  // short reads being processed
+    uint64_t m_num_long = 0;   // long sequences being processed or waiting
+    bool m_long_running = false;
+};
+
 enum class pseudoalignment_algorithm : uint8_t {
     FULL_INTERSECTION,
     THRESHOLD_UNION,
@@ -56,105 +100,191 @@ std::string to_string(pseudoalignment_algorithm algo, double threshold) {
     return o;
 }
 
+/* As index.pseudoalign_full_intersection and index.pseudoalign_threshold_union, but also
+   records the k-mer lookups and the accesses of the read in profiler. */
+template <typename FulgorIndex>
+void pseudoalign_and_profile(FulgorIndex const& index, std::string const& sequence,
+                             pseudoalignment_algorithm algo, const double threshold,
+                             std::vector<uint32_t>& colors, std::vector<uint64_t>& unitig_ids,
+                             query_profile::builder& profiler) {
+    const uint64_t k = index.get_k2u().k();
+    if (sequence.length() < k) {
+        profiler.add_read(0, 0);
+        return;
+    }
+    const uint64_t num_kmers = sequence.length() - k + 1;
+    uint64_t num_iterators = 0;
+    if (algo == pseudoalignment_algorithm::THRESHOLD_UNION) {
+        std::vector<scored_id> scored_unitig_ids;
+        uint64_t num_positive_kmers_in_sequence =
+            stream_through_with_multiplicities(index.get_k2u(), sequence, scored_unitig_ids);
+        profiler.add_kmers(num_kmers, num_positive_kmers_in_sequence,
+                           num_kmers - num_positive_kmers_in_sequence);
+        for (auto const& u : scored_unitig_ids) unitig_ids.push_back(u.item);
+        num_iterators = profiler.add_unitigs(index, unitig_ids);
+        uint64_t min_score = static_cast<double>(num_positive_kmers_in_sequence) * threshold;
+        threshold_union(index, scored_unitig_ids, min_score, colors);
+    } else {
+        uint64_t num_positive_kmers_in_sequence =
+            stream_through(index.get_k2u(), sequence, unitig_ids);
+        profiler.add_kmers(num_kmers, num_positive_kmers_in_sequence,
+                           num_kmers - num_positive_kmers_in_sequence);
+        num_iterators = profiler.add_unitigs(index, unitig_ids);
+        index.intersect_unitigs(unitig_ids, colors);
+    }
+    profiler.add_read(num_iterators, colors.size());
+}
+
 template <typename FulgorIndex>
 int do_map(FulgorIndex const& index, fastx_parser::FastxParser<fastx_parser::ReadSeq>& rparser,
            std::atomic<uint64_t>& num_reads, std::atomic<uint64_t>& num_mapped_reads,
            pseudoalignment_algorithm algo, const double threshold, std::ofstream& out_file,
-           std::mutex& iomut, std::mutex& ofile_mut) {
+           std::mutex& iomut, std::mutex& ofile_mut, query_profile::builder* profiler,
+           uint64_t long_sequence_length, long_sequence_gate& gate, uint64_t num_threads) {
     std::vector<uint32_t> colors;  // result of pseudo-alignment
     std::stringstream ss;
     uint64_t buff_size = 0;
     constexpr uint64_t buff_thresh = 50;
 
-    if ((algo == pseudoalignment_algorithm::SKIPPING or
-         algo == pseudoalignment_algorithm::SKIPPING_KALLISTO) and
-        (index.get_k2u().canonicalized())) {
-        std::vector<uint64_t> unitig_ids;                           // for use with skipping
-        std::vector<std::pair<projected_hits, int>> kallisto_hits;  // for use with kallisto psa
-
-        piscem_psa::hit_searcher<FulgorIndex> hs(&index);
-        sshash::streaming_query_canonical_parsing qc(&index.get_k2u());
-
-        auto get_hits_piscem_psa = [&qc, &hs](const std::string& seq,
-                                              std::vector<uint64_t>& unitig_ids) -> void {
-            hs.clear();
-            auto had_hits = hs.get_raw_hits_sketch(seq, qc, true, false);
-            if (had_hits) {
-                for (auto& h : hs.get_left_hits()) {
-                    if (!h.second.empty()) { unitig_ids.push_back(h.second.contigIdx_); }
+    /* skipping needs the k2u map of a single index: not available for sharded indexes */
+    bool skipping = false;
+    if constexpr (!is_sharded_index<FulgorIndex>::value) {
+        skipping = (algo == pseudoalignment_algorithm::SKIPPING or
+                    algo == pseudoalignment_algorithm::SKIPPING_KALLISTO) and
+                   (index.get_k2u().canonicalized());
+        if (skipping) {
+            std::vector<uint64_t> unitig_ids;                           // for use with skipping
+            std::vector<std::pair<projected_hits, int>> kallisto_hits;  // for use with kallisto psa
+
+            piscem_psa::hit_searcher<FulgorIndex> hs(&index);
+            sshash::streaming_query_canonical_parsing qc(&index.get_k2u());
+
+            uint64_t num_lookup_hits = 0, num_lookup_misses = 0;  // for use with profiler
+
+            auto get_hits_piscem_psa = [&qc, &hs, &num_lookup_hits, &num_lookup_misses](
+                                           const std::string& seq,
+                                           std::vector<uint64_t>& unitig_ids) -> void {
+                hs.clear();
+                auto had_hits = hs.get_raw_hits_sketch(seq, qc, true, false);
+                if (had_hits) {
+                    for (auto& h : hs.get_left_hits()) {
+                        if (!h.second.empty()) { unitig_ids.push_back(h.second.contigIdx_); }
+                    }
                 }
-            }
-        };
-
-        auto get_hits_kallisto_psa = [&index, &kallisto_hits](
-                                         const std::string& seq,
-                                         std::vector<uint64_t>& unitig_ids) -> void {
-            kallisto_hits.clear();
-            match(seq, seq.length(), &index, kallisto_hits);
-            if (!kallisto_hits.empty()) {
-                for (auto& h : kallisto_hits) { unitig_ids.push_back(h.first.contigIdx_); }
-            }
-        };
-        // Get the read group by which this thread will
-        // communicate with the parser (*once per-thread*)
-        auto rg = rparser.getReadGroup();
-        while (rparser.refill(rg)) {
-            // Here, rg will contain a chunk of read pairs we can process.
-            for (auto const& record : rg) {
-                switch (algo) {
-                    case pseudoalignment_algorithm::SKIPPING:
-                        get_hits_piscem_psa(record.seq, unitig_ids);
-                        break;
-                    case pseudoalignment_algorithm::SKIPPING_KALLISTO:
-                        get_hits_kallisto_psa(record.seq, unitig_ids);
-                        break;
-                    default:
-                        break;
-                }
-
-                num_reads += 1;
-                index.intersect_unitigs(unitig_ids, colors);
-                if (!colors.empty()) {
-                    num_mapped_reads += 1;
-                    ss << record.name << '\t' << colors.size() << '\t';
-                    for (auto c : colors) { ss << "\t" << c; }
-                    ss << '\n';
-                    // write_output(colors, ss);
-                } else {
-                    ss << record.name << "\t0\n";
-                }
-                colors.clear();
-                unitig_ids.clear();
-
-                buff_size += 1;
-                if (num_reads > 0 and num_reads % 1000000 == 0) {
-                    iomut.lock();
-                    std::cout << "mapped " << num_reads << " reads" << std::endl;
-                    iomut.unlock();
+                num_lookup_hits = hs.get_num_lookup_hits();
+                num_lookup_misses = hs.get_num_lookup_misses();
+            };
+
+            auto get_hits_kallisto_psa = [&index, &kallisto_hits, &num_lookup_hits,
+                                          &num_lookup_misses](
+                                             const std::string& seq,
+                                             std::vector<uint64_t>& unitig_ids) -> void {
+                kallisto_hits.clear();
+                num_lookup_hits = num_lookup_misses = 0;
+                match(seq, seq.length(), &index, kallisto_hits, &num_lookup_hits,
+                      &num_lookup_misses);
+                if (!kallisto_hits.empty()) {
+                    for (auto& h : kallisto_hits) { unitig_ids.push_back(h.first.contigIdx_); }
                 }
-                if (buff_size > buff_thresh) {
-                    std::string outs = ss.str();
-                    ss.str("");
-                    ofile_mut.lock();
-                    out_file.write(outs.data(), outs.size());
-                    ofile_mut.unlock();
-                    buff_size = 0;
+            };
+            // Get the read group by which this thread will
+            // communicate with the parser (*once per-thread*)
+            auto rg = rparser.getReadGroup();
+            while (rparser.refill(rg)) {
+                // Here, rg will contain a chunk of read pairs we can process.
+                for (auto const& record : rg) {
+                    switch (algo) {
+                        case pseudoalignment_algorithm::SKIPPING:
+                            get_hits_piscem_psa(record.seq, unitig_ids);
+                            break;
+                        case pseudoalignment_algorithm::SKIPPING_KALLISTO:
+                            get_hits_kallisto_psa(record.seq, unitig_ids);
+                            break;
+                        default:
+                            break;
+                    }
+
+                    num_reads += 1;
+                    if (profiler) {
+                        const uint64_t k = index.get_k2u().k();
+                        profiler->add_kmers(
+                            record.seq.length() < k ? 0 : record.seq.length() - k + 1,
+                            num_lookup_hits, num_lookup_misses);
+                        const uint64_t num_iterators = profiler->add_unitigs(index, unitig_ids);
+                        index.intersect_unitigs(unitig_ids, colors);
+                        profiler->add_read(num_iterators, colors.size());
+                    } else {
+                        index.intersect_unitigs(unitig_ids, colors);
+                    }
+                    if (!colors.empty()) {
+                        num_mapped_reads += 1;
+                        ss << record.name << '\t' << colors.size() << '\t';
+                        for (auto c : colors) { ss << "\t" << c; }
+                        ss << '\n';
+                        // write_output(colors, ss);
+                    } else {
+                        ss << record.name << "\t0\n";
+                    }
+                    colors.clear();
+                    unitig_ids.clear();
+
+                    buff_size += 1;
+                    if (num_reads > 0 and num_reads % 1000000 == 0) {
+                        iomut.lock();
+                        std::cout << "mapped " << num_reads << " reads" << std::endl;
+                        iomut.unlock();
+                    }
+                    if (buff_size > buff_thresh) {
+                        std::string outs = ss.str();
+                        ss.str("");
+                        ofile_mut.lock();
+                        out_file.write(outs.data(), outs.size());
+                        ofile_mut.unlock();
+                        buff_size = 0;
+                    }
                 }
             }
         }
-    } else {
+    }
+
+    if (!skipping) {
+        std::vector<uint64_t> unitig_ids;  // for use with profiler
         auto rg = rparser.getReadGroup();
         while (rparser.refill(rg)) {
             for (auto const& record : rg) {
-                switch (algo) {
-                    case pseudoalignment_algorithm::FULL_INTERSECTION:
-                        index.pseudoalign_full_intersection(record.seq, colors);
-                        break;
-                    case pseudoalignment_algorithm::THRESHOLD_UNION:
-                        index.pseudoalign_threshold_union(record.seq, colors, threshold);
-                        break;
-                    default:
-                        break;
+                if constexpr (!is_sharded_index<FulgorIndex>::value) {
+                    if (profiler) {
+                        pseudoalign_and_profile(index, record.seq, algo, threshold, colors,
+                                                unitig_ids, *profiler);
+                        unitig_ids.clear();
+                    }
+                }
+                if (!profiler) {
+                    switch (algo) {
+                        case pseudoalignment_algorithm::FULL_INTERSECTION:
+                            if constexpr (!is_sharded_index<FulgorIndex>::value) {
+                                if (long_sequence_length != 0) {
+                                    if (record.seq.length() >= long_sequence_length) {
+                                        gate.enter_long();
+                                        index.pseudoalign_full_intersection(record.seq, colors,
+                                                                            num_threads);
+                                        gate.exit_long();
+                                    } else {
+                                        gate.enter_short();
+                                        index.pseudoalign_full_intersection(record.seq, colors);
+                                        gate.exit_short();
+                                    }
+                                    break;
+                                }
+                            }
+                            index.pseudoalign_full_intersection(record.seq, colors);
+                            break;
+                        case pseudoalignment_algorithm::THRESHOLD_UNION:
+                            index.pseudoalign_threshold_union(record.seq, colors, threshold);
+                            break;
+                        default:
+                            break;
+                    }
                 }
                 buff_size += 1;
                 if (!colors.empty()) {
@@ -201,10 +331,11 @@ int do_map(FulgorIndex const& index, fastx_parser::FastxParser<fastx_parser::Rea
 template <typename FulgorIndex>
 int pseudoalign(std::string const& index_filename, std::string const& query_filename,
                 std::string const& output_filename, uint64_t num_threads, double threshold,
-                pseudoalignment_algorithm algo) {
+                pseudoalignment_algorithm algo, std::string const& profile_filename,
+                uint64_t long_sequence_length) {
     FulgorIndex index;
     essentials::logger("loading index from disk...");
-    essentials::load(index, index_filename.c_str());
+    load_index(index, index_filename);
     essentials::logger("DONE");
 
     // if not a skipping variant and no threshold set, then set the algorithm
@@ -215,11 +346,28 @@ int pseudoalign(std::string const& index_filename, std::string const& query_file
 
     std::cerr << "query mode : " << to_string(algo, threshold) << "\n";
 
-    if (((algo == pseudoalignment_algorithm::SKIPPING) or
-         (algo == pseudoalignment_algorithm::SKIPPING_KALLISTO)) and
-        !(index.get_k2u().canonicalized())) {
-        std::cout << "==> Warning: skipping is only supported for canonicalized indexes. <=="
-                  << std::endl;
+    if constexpr (is_sharded_index<FulgorIndex>::value) {
+        if ((algo == pseudoalignment_algorithm::SKIPPING) or
+            (algo == pseudoalignment_algorithm::SKIPPING_KALLISTO)) {
+            std::cout << "==> Warning: skipping is not supported for sharded indexes. <=="
+                      << std::endl;
+        }
+        if (!profile_filename.empty()) {
+            std::cout << "==> Warning: profiling is not supported for sharded indexes. <=="
+                      << std::endl;
+        }
+        if (long_sequence_length != 0) {
+            std::cout << "==> Warning: long sequences are not processed in parallel with "
+                         "sharded indexes. <=="
+                      << std::endl;
+        }
+    } else {
+        if (((algo == pseudoalignment_algorithm::SKIPPING) or
+             (algo == pseudoalignment_algorithm::SKIPPING_KALLISTO)) and
+            !(index.get_k2u().canonicalized())) {
+            std::cout << "==> Warning: skipping is only supported for canonicalized indexes. <=="
+                      << std::endl;
+        }
     }
 
     std::ifstream is(query_filename.c_str());
@@ -248,6 +396,7 @@ int pseudoalign(std::string const& index_filename, std::string const& query_file
     std::vector<std::thread> workers;
     std::mutex iomut;
     std::mutex ofile_mut;
+    long_sequence_gate gate;
 
     std::ofstream out_file;
     out_file.open(output_filename, std::ios::out | std::ios::trunc);
@@ -256,11 +405,24 @@ int pseudoalign(std::string const& index_filename, std::string const& query_file
         return 1;
     }
 
+    /* one profiler per thread, sharing the access counters, merged at the end */
+    std::unique_ptr<query_profile::access_counters> access_counters;
+    std::vector<query_profile::builder> profilers;
+    if constexpr (!is_sharded_index<FulgorIndex>::value) {
+        if (!profile_filename.empty()) {
+            access_counters = std::make_unique<query_profile::access_counters>(
+                index.num_unitigs(), index.num_color_sets());
+            profilers.resize(num_threads - 1, query_profile::builder(*access_counters));
+        }
+    }
+
     for (uint64_t i = 1; i != num_threads; ++i) {
+        query_profile::builder* profiler = profilers.empty() ? nullptr : &profilers[i - 1];
         workers.push_back(std::thread([&index, &rparser, &num_reads, &num_mapped_reads, algo,
-                                       threshold, &out_file, &iomut, &ofile_mut]() {
+                                       threshold, &out_file, &iomut, &ofile_mut, profiler,
+                                       long_sequence_length, &gate, num_threads]() {
             do_map(index, rparser, num_reads, num_mapped_reads, algo, threshold, out_file, iomut,
-                   ofile_mut);
+                   ofile_mut, profiler, long_sequence_length, gate, num_threads - 1);
         }));
     }
 
@@ -270,6 +432,22 @@ int pseudoalign(std::string const& index_filename, std::string const& query_file
     t.stop();
     essentials::logger("DONE");
 
+    if (!profilers.empty()) {
+        query_profile profile;
+        for (auto& profiler : profilers) {
+            query_profile thread_profile;
+            profiler.build(thread_profile);
+            profile.merge(thread_profile);
+        }
+        query_profile accesses;
+        access_counters->build(accesses);
+        access_counters.reset();
+        profile.merge(accesses);
+        essentials::logger("saving profile to '" + profile_filename + "'...");
+        essentials::save(profile, profile_filename.c_str());
+        essentials::logger("DONE");
+    }
+
     std::cout << "mapped " << num_reads << " reads" << std::endl;
     std::cout << "elapsed = " << t.elapsed() << " millisec / ";
     std::cout << t.elapsed() / 1000 << " sec / ";
@@ -285,7 +463,9 @@ int pseudoalign(int argc, char** argv) {
     std::string index_filename;
     std::string query_filename;
     std::string output_filename;
+    std::string profile_filename;
     uint64_t num_threads = 1;
+    uint64_t long_sequence_length = 0;
     double threshold = constants::invalid_threshold;
     pseudoalignment_algorithm algo = pseudoalignment_algorithm::FULL_INTERSECTION;
 
@@ -301,6 +481,17 @@ int pseudoalign(int argc, char** argv) {
     app.add_option("-t,--threads", num_threads, "Number of threads.")->default_val(1);
     app.add_option("--threshold", threshold, "Threshold for threshold_union algorithm.")
         ->check(CLI::Range(0.0, 1.0));
+    app.add_option("--profile-out", profile_filename,
+                   "Record the accesses to unitigs and color sets, the k-mer lookups, and the "
+                   "number of iterators and intersection size per read, and write them to this "
+                   "file (see the tool profile-report). The access counters take 8 bytes "
+                   "per unitig and per color set, shared by all the threads.");
+    app.add_option("--long-sequences", long_sequence_length,
+                   "Stream the k-mers and intersect the color sets of each sequence of at least "
+                   "this length with all the threads, rather than with one, one such sequence at "
+                   "a time: the other threads wait meanwhile, so that no more than '-t' threads "
+                   "run (e.g., for contigs or assemblies; full-intersection only, without "
+                   "profiling). Disabled by default.");
     auto skip_opt = app.add_flag_callback(
         "--skipping", [&algo]() { algo = pseudoalignment_algorithm::SKIPPING; },
         "Enable the skipping heuristic in pseudoalignment.");
@@ -313,21 +504,56 @@ int pseudoalign(int argc, char** argv) {
 
     util::print_cmd(argc, argv);
 
+    if (is_sharded(index_filename)) {
+        auto shard_filename = first_shard_filename(index_filename);
+        if (is_meta_diff(shard_filename)) {
+            return pseudoalign<sharded_index<meta_differential_index_type>>(
+                index_filename, query_filename, output_filename, num_threads, threshold, algo,
+                profile_filename, long_sequence_length);
+        } else if (is_meta(shard_filename)) {
+            return pseudoalign<sharded_index<meta_index_type>>(
+                index_filename, query_filename, output_filename, num_threads, threshold, algo,
+                profile_filename, long_sequence_length);
+        } else if (is_diff(shard_filename)) {
+            return pseudoalign<sharded_index<differential_index_type>>(
+                index_filename, query_filename, output_filename, num_threads, threshold, algo,
+                profile_filename, long_sequence_length);
+        } else if (is_roaring(shard_filename)) {
+            return pseudoalign<sharded_index<roaring_index_type>>(
+                index_filename, query_filename, output_filename, num_threads, threshold, algo,
+                profile_filename, long_sequence_length);
+        } else if (is_hybrid(shard_filename)) {
+            return pseudoalign<sharded_index<index_type>>(
+                index_filename, query_filename, output_filename, num_threads, threshold, algo,
+                profile_filename, long_sequence_length);
+        }
+        std::cerr << "Wrong shard filename in manifest." << std::endl;
+        return 1;
+    }
+
     if (sshash::util::ends_with(index_filename,
                                 constants::meta_diff_colored_fulgor_filename_extension)) {
         return pseudoalign<meta_differential_index_type>(
-            index_filename, query_filename, output_filename, num_threads, threshold, algo);
+            index_filename, query_filename, output_filename, num_threads, threshold, algo,
+            profile_filename, long_sequence_length);
     } else if (sshash::util::ends_with(index_filename,
                                        constants::meta_colored_fulgor_filename_extension)) {
         return pseudoalign<meta_index_type>(index_filename, query_filename, output_filename,
-                                            num_threads, threshold, algo);
+                                            num_threads, threshold, algo, profile_filename,
+                                            long_sequence_length);
     } else if (sshash::util::ends_with(index_filename,
                                        constants::diff_colored_fulgor_filename_extension)) {
         return pseudoalign<differential_index_type>(index_filename, query_filename, output_filename,
-                                                    num_threads, threshold, algo);
+                                                    num_threads, threshold, algo, profile_filename,
+                                                    long_sequence_length);
+    } else if (sshash::util::ends_with(index_filename,
+                                       constants::roaring_colored_fulgor_filename_extension)) {
+        return pseudoalign<roaring_index_type>(index_filename, query_filename, output_filename,
+                                               num_threads, threshold, algo, profile_filename,
+                                               long_sequence_length);
     } else if (sshash::util::ends_with(index_filename, constants::fulgor_filename_extension)) {
         return pseudoalign<index_type>(index_filename, query_filename, output_filename, num_threads,
-                                       threshold, algo);
+                                       threshold, algo, profile_filename, long_sequence_length);
     }
 
     std::cerr << "Wrong filename supplied." << std::endl;
@@ -0,0 +1,88 @@
+using namespace fulgor;
+
+template <typename FulgorIndex>
+void reorder_unitigs(build_configuration const& build_config, std::string const& index_filename,
+                     std::string const& output_filename) {
+    essentials::timer<std::chrono::high_resolution_clock, std::chrono::seconds> timer;
+    timer.start();
+
+    FulgorIndex from;
+    essentials::logger("step 1. loading index to be reordered...");
+    load_index(from, index_filename);
+    essentials::logger("DONE");
+
+    FulgorIndex index;
+    typename FulgorIndex::reordered_unitigs_builder builder(build_config);
+    builder.build(from, index);
+    index.print_stats();
+
+    timer.stop();
+    essentials::logger("DONE");
+    std::cout << "** reordering the unitigs took " << timer.elapsed() << " seconds / "
+              << timer.elapsed() / 60 << " minutes" << std::endl;
+
+    essentials::logger("saving index to disk...");
+    essentials::save(index, output_filename.c_str());
+    essentials::logger("DONE");
+}
+
+int reorder_unitigs(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("index_filename", "The Fulgor index filename whose unitigs are reordered.", "-i",
+               true);
+    parser.add("output_filename",
+               "Output filename of the reordered index. It must have the same extension of the "
+               "input index.",
+               "-o", true);
+    parser.add(
+        "tmp_dirname",
+        "Temporary directory used for construction in external memory. Default is directory '" +
+            constants::default_tmp_dirname + "'.",
+        "-d", false);
+    parser.add("num_threads", "Number of threads (default is 1).", "-t", false);
+    parser.add("verbose", "Verbose output during construction.", "--verbose", false, true);
+    parser.add("check", "Check correctness after index construction (it might take some time).",
+               "--check", false, true);
+    if (!parser.parse()) return 1;
+    util::print_cmd(argc, argv);
+
+    auto index_filename = parser.get<std::string>("index_filename");
+    auto output_filename = parser.get<std::string>("output_filename");
+
+    const std::string extension = shard_extension(index_filename);
+    if (extension.empty() or extension == constants::sharded_fulgor_filename_extension) {
+        std::cerr << "Error: '" << index_filename << "' is not a Fulgor index." << std::endl;
+        return 1;
+    }
+    if (shard_extension(output_filename) != extension) {
+        std::cerr << "Error: the output filename must have extension \"." << extension << "\"."
+                  << std::endl;
+        return 1;
+    }
+
+    build_configuration build_config;
+    if (parser.parsed("tmp_dirname")) {
+        build_config.tmp_dirname = parser.get<std::string>("tmp_dirname");
+        essentials::create_directory(build_config.tmp_dirname);
+    }
+    if (parser.parsed("num_threads")) {
+        build_config.num_threads = parser.get<uint64_t>("num_threads");
+    }
+    build_config.verbose = parser.get<bool>("verbose");
+    build_config.check = parser.get<bool>("check");
+
+    if (extension == constants::meta_diff_colored_fulgor_filename_extension) {
+        reorder_unitigs<meta_differential_index_type>(build_config, index_filename,
+                                                      output_filename);
+    } else if (extension == constants::meta_colored_fulgor_filename_extension) {
+        reorder_unitigs<meta_index_type>(build_config, index_filename, output_filename);
+    } else if (extension == constants::diff_colored_fulgor_filename_extension) {
+        reorder_unitigs<differential_index_type>(build_config, index_filename, output_filename);
+    } else if (extension == constants::roaring_colored_fulgor_filename_extension) {
+        reorder_unitigs<roaring_index_type>(build_config, index_filename, output_filename);
+    } else {
+        reorder_unitigs<index_type>(build_config, index_filename, output_filename);
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+using namespace fulgor;
+
+template <typename FulgorIndex>
+void load_shard_info(std::string const& shard_filename, uint64_t& k, uint32_t& num_docs) {
+    FulgorIndex index;
+    load_index(index, shard_filename);
+    k = index.k();
+    num_docs = index.num_docs();
+}
+
+/* The extension of the shards, checking the most specific extensions first. */
+std::string shard_extension(std::string const& shard_filename) {
+    if (is_meta_diff(shard_filename)) return constants::meta_diff_colored_fulgor_filename_extension;
+    if (is_meta(shard_filename)) return constants::meta_colored_fulgor_filename_extension;
+    if (is_diff(shard_filename)) return constants::diff_colored_fulgor_filename_extension;
+    if (is_sharded(shard_filename)) return constants::sharded_fulgor_filename_extension;
+    if (is_roaring(shard_filename)) return constants::roaring_colored_fulgor_filename_extension;
+    if (is_hybrid(shard_filename)) return constants::fulgor_filename_extension;
+    return "";
+}
+
+int shard(int argc, char** argv) {
+    cmd_line_parser::parser parser(argc, argv);
+    parser.add("shards_list",
+               "List of Fulgor index filenames, one per line, built over disjoint sets of "
+               "references. All indexes must have the same type and the same k. The global doc ids "
+               "are assigned in the order of the list.",
+               "-l", true);
+    parser.add("file_base_name",
+               "File basename. The manifest of the sharded index is written to "
+               "'<file_base_name>." +
+                   constants::sharded_fulgor_filename_extension + "'.",
+               "-o", true);
+    if (!parser.parse()) return 1;
+    util::print_cmd(argc, argv);
+
+    std::ifstream in(parser.get<std::string>("shards_list").c_str());
+    if (!in.is_open()) {
+        std::cerr << "cannot open shards list" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> shard_filenames;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        /* store absolute paths: the manifest can be moved independently of the shards */
+        shard_filenames.push_back(std::filesystem::absolute(line).string());
+    }
+    in.close();
+    if (shard_filenames.empty()) {
+        std::cerr << "Error: the shards list is empty." << std::endl;
+        return 1;
+    }
+
+    const std::string extension = shard_extension(shard_filenames.front());
+    if (extension.empty() or extension == constants::sharded_fulgor_filename_extension) {
+        std::cerr << "Error: '" << shard_filenames.front() << "' is not a Fulgor index."
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<uint32_t> num_docs_in_shards;
+    num_docs_in_shards.reserve(shard_filenames.size());
+    uint64_t k = 0;
+    for (auto const& shard_filename : shard_filenames) {
+        if (shard_extension(shard_filename) != extension) {
+            std::cerr << "Error: all shards must have the same type, but '" << shard_filename
+                      << "' does not have extension \"." << extension << "\"." << std::endl;
+            return 1;
+        }
+        essentials::logger("reading shard '" + shard_filename + "'...");
+        uint64_t shard_k = 0;
+        uint32_t num_docs = 0;
+        if (extension == constants::meta_diff_colored_fulgor_filename_extension) {
+            load_shard_info<meta_differential_index_type>(shard_filename, shard_k, num_docs);
+        } else if (extension == constants::meta_colored_fulgor_filename_extension) {
+            load_shard_info<meta_index_type>(shard_filename, shard_k, num_docs);
+        } else if (extension == constants::diff_colored_fulgor_filename_extension) {
+            load_shard_info<differential_index_type>(shard_filename, shard_k, num_docs);
+        } else if (extension == constants::roaring_colored_fulgor_filename_extension) {
+            load_shard_info<roaring_index_type>(shard_filename, shard_k, num_docs);
+        } else {
+            load_shard_info<index_type>(shard_filename, shard_k, num_docs);
+        }
+        if (k == 0) k = shard_k;
+        if (shard_k != k) {
+            std::cerr << "Error: all shards must be built with the same k, but '"
+                      << shard_filename << "' has k = " << shard_k << " instead of " << k
+                      << std::endl;
+            return 1;
+        }
+        num_docs_in_shards.push_back(num_docs);
+    }
+
+    shards_manifest manifest;
+    manifest.build(shard_filenames, num_docs_in_shards);
+    std::cout << "num. shards: " << manifest.num_shards() << std::endl;
+    std::cout << "num. references: " << manifest.num_docs() << std::endl;
+
+    std::string output_filename = parser.get<std::string>("file_base_name") + "." +
+                                  constants::sharded_fulgor_filename_extension;
+    essentials::logger("saving manifest to disk...");
+    essentials::save(manifest, output_filename.c_str());
+    essentials::logger("DONE");
+
+    return 0;
+}
@@ -12,6 +12,14 @@ bool is_diff(std::string index_filename){
     return sshash::util::ends_with(index_filename,
                                    constants::diff_colored_fulgor_filename_extension);
 }
+bool is_sharded(std::string index_filename){
+    return sshash::util::ends_with(index_filename,
+                                   constants::sharded_fulgor_filename_extension);
+}
+bool is_roaring(std::string index_filename){
+    return sshash::util::ends_with(index_filename,
+                                   constants::roaring_colored_fulgor_filename_extension);
+}
 bool is_hybrid(std::string index_filename){
     return sshash::util::ends_with(index_filename, constants::fulgor_filename_extension);
 }
@@ -20,7 +28,7 @@ template <typename FulgorIndex>
 void print_stats(std::string const& index_filename) {
     FulgorIndex index;
     essentials::logger("loading index from disk...");
-    essentials::load(index, index_filename.c_str());
+    load_index(index, index_filename);
     essentials::logger("DONE");
     index.print_stats();
 }
@@ -29,13 +37,58 @@ template <typename FulgorIndex>
 void print_filenames(std::string const& index_filename) {
     FulgorIndex index;
     essentials::logger("loading index from disk...");
-    essentials::load(index, index_filename.c_str());
+    load_index(index, index_filename);
     essentials::logger("DONE");
     for (uint64_t i = 0; i != index.num_docs(); ++i) {
         std::cout << i << '\t' << index.filename(i) << '\n';
     }
 }
 
+/* All the shards of a sharded index have the same type: that of the first shard. */
+std::string first_shard_filename(std::string const& index_filename) {
+    shards_manifest manifest;
+    essentials::load(manifest, index_filename.c_str());
+    return std::string(manifest.shard_filename(0));
+}
+
+int sharded_print_stats(std::string const& index_filename) {
+    auto shard_filename = first_shard_filename(index_filename);
+    if (is_meta_diff(shard_filename)) {
+        print_stats<sharded_index<meta_differential_index_type>>(index_filename);
+    } else if (is_meta(shard_filename)) {
+        print_stats<sharded_index<meta_index_type>>(index_filename);
+    } else if (is_diff(shard_filename)) {
+        print_stats<sharded_index<differential_index_type>>(index_filename);
+    } else if (is_roaring(shard_filename)) {
+        print_stats<sharded_index<roaring_index_type>>(index_filename);
+    } else if (is_hybrid(shard_filename)) {
+        print_stats<sharded_index<index_type>>(index_filename);
+    } else {
+        std::cerr << "Wrong shard filename in manifest." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int sharded_print_filenames(std::string const& index_filename) {
+    auto shard_filename = first_shard_filename(index_filename);
+    if (is_meta_diff(shard_filename)) {
+        print_filenames<sharded_index<meta_differential_index_type>>(index_filename);
+    } else if (is_meta(shard_filename)) {
+        print_filenames<sharded_index<meta_index_type>>(index_filename);
+    } else if (is_diff(shard_filename)) {
+        print_filenames<sharded_index<differential_index_type>>(index_filename);
+    } else if (is_roaring(shard_filename)) {
+        print_filenames<sharded_index<roaring_index_type>>(index_filename);
+    } else if (is_hybrid(shard_filename)) {
+        print_filenames<sharded_index<index_type>>(index_filename);
+    } else {
+        std::cerr << "Wrong shard filename in manifest." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 // template <typename FulgorIndex>
 // void dump_colors(std::string const& index_filename, std::string const& output_filename) {
 //     FulgorIndex index;
@@ -52,7 +105,7 @@ template <typename FulgorIndex>
 void dump(std::string const& index_filename, std::string const& basename) {
     FulgorIndex index;
     essentials::logger("loading index from disk...");
-    essentials::load(index, index_filename.c_str());
+    load_index(index, index_filename);
     essentials::logger("DONE");
     index.dump(basename);
 }
@@ -63,12 +116,16 @@ int stats(int argc, char** argv) {
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
     auto index_filename = parser.get<std::string>("index_filename");
-    if (is_meta(index_filename)) {
+    if (is_sharded(index_filename)) {
+        return sharded_print_stats(index_filename);
+    } else if (is_meta(index_filename)) {
         print_stats<meta_index_type>(index_filename);
     } else if (is_meta_diff(index_filename)) {
         print_stats<meta_differential_index_type>(index_filename);
     } else if (is_diff(index_filename)) {
         print_stats<differential_index_type>(index_filename);
+    } else if (is_roaring(index_filename)) {
+        print_stats<roaring_index_type>(index_filename);
     } else if (is_hybrid(index_filename)) {
         print_stats<index_type>(index_filename);
     } else {
@@ -84,12 +141,16 @@ int print_filenames(int argc, char** argv) {
     if (!parser.parse()) return 1;
     util::print_cmd(argc, argv);
     auto index_filename = parser.get<std::string>("index_filename");
-    if (is_meta_diff(index_filename)) {
+    if (is_sharded(index_filename)) {
+        return sharded_print_filenames(index_filename);
+    } else if (is_meta_diff(index_filename)) {
         print_filenames<meta_differential_index_type>(index_filename);
     } else if (is_meta(index_filename)) {
         print_filenames<meta_index_type>(index_filename);
     }else if (is_diff(index_filename)) {
         print_filenames<differential_index_type>(index_filename);
+    } else if (is_roaring(index_filename)) {
+        print_filenames<roaring_index_type>(index_filename);
     } else if (is_hybrid(index_filename)) {
         print_filenames<index_type>(index_filename);
     } else {
@@ -140,6 +201,11 @@ int dump(int argc, char** argv) {
                              index_filename.length() -
                                  constants::diff_colored_fulgor_filename_extension.length() - 1};
         dump<differential_index_type>(index_filename, basename);
+    } else if (is_roaring(index_filename)) {
+        std::string basename{index_filename.data(),
+                             index_filename.length() -
+                                 constants::roaring_colored_fulgor_filename_extension.length() - 1};
+        dump<roaring_index_type>(index_filename, basename);
     } else if (is_hybrid(index_filename)) {
         std::string basename{
             index_filename.data(),